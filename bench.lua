@@ -47,6 +47,12 @@ local function bench(name, N, func, ...)
 end
 
 local lhp = require 'http.parser'
+local hm = require"http_message"
+
+-- parser buffers are allocated outside of the Lua GC's accounting.
+local function memory_used()
+    return (collectgarbage"count" * 1024) + hm.memory_used()
+end
 
 local function parse_path_query_fragment(uri)
     local path, query, fragment, off
@@ -141,7 +147,7 @@ for name, data in pairs(requests) do
     data_list[#data_list + 1] = data
 end
 
-local function init_parser(reqs)
+local function init_parser(reqs, opts)
     local cur          = nil
     local parser
 
@@ -178,11 +184,11 @@ local function init_parser(reqs)
         cur = nil
     end
 
-    parser = lhp.request(cb)
+    parser = lhp.request(cb, opts)
     return parser
 end
 
-local function init_fast_parser(reqs)
+local function init_fast_parser(reqs, opts)
     local cur          = nil
     local parser
 
@@ -218,7 +224,7 @@ local function init_fast_parser(reqs)
         cur = nil
     end
 
-    parser = lhp.request(cb)
+    parser = lhp.request(cb, opts)
     return parser
 end
 
@@ -291,13 +297,13 @@ local function apply_client_memtest(client)
     local N = client.mem_N
     
     local reqs = {}
-    local parser = init_parser(reqs)
+    local parser = init_parser(reqs, client.opts)
     full_gc()
-    start_mem = (collectgarbage"count" * 1024)
+    start_mem = memory_used()
     --print(client.name, 'start memory size: ', start_mem)
     if disable_gc then collectgarbage"stop" end
     apply_client(N, client.cb, parser, data_list)
-    end_mem = (collectgarbage"count" * 1024)
+    end_mem = memory_used()
     --print(client.name, 'end   memory size: ', end_mem)
     print(client.name, 'N=', N, 'total memory used: ', (end_mem - start_mem))
     print()
@@ -321,17 +327,24 @@ local function apply_client_speedtest(client)
     local start_mem, end_mem
     local N = client.speed_N
  
-    local parser = init_fast_parser()
+    local parser = init_fast_parser(nil, client.opts)
     full_gc()
-    start_mem = (collectgarbage"count" * 1024)
+    start_mem = memory_used()
     --print(client.name, 'start memory size: ', start_mem)
     if disable_gc then collectgarbage"stop" end
     local diff1, diff2 = bench(client.name, N, apply_client, client.cb, parser, data_list)
-    end_mem = (collectgarbage"count" * 1024)
+    end_mem = memory_used()
     local total = N * #data_list
     printf("units/sec: %10.6f (%10.6f) units/sec", total/diff1, total/diff2)
     --print(client.name, 'end   memory size: ', end_mem)
     print(client.name, 'N=', N, 'total memory used: ', (end_mem - start_mem))
+    -- per message parser work, when compiled with ENABLE_PARSER_STATS.
+    local stats = {}
+    if parser.hm_parser:stats(stats) then
+        printf("per message: %.1f bytes parsed, %.2f execute calls, %.2f pauses, %.2f bytes moved",
+            stats.bytes_parsed / total, stats.execute_calls / total, stats.pauses / total,
+            (stats.bytes_moved + stats.bytes_copied) / total)
+    end
     print()
    
     parser = nil
@@ -348,13 +361,13 @@ local function per_parser_overhead(N)
         parsers[i] = true -- add place-holder values.
     end
     full_gc()
-    start_mem = (collectgarbage"count" * 1024)
+    start_mem = memory_used()
     --print('overhead: start memory size: ', start_mem)
     for i=1,N do
         parsers[i] = init_null_parser()
     end
     full_gc()
-    end_mem = (collectgarbage"count" * 1024)
+    end_mem = memory_used()
     --print('overhead: end   memory size: ', end_mem)
     print('overhead: total memory used: ', (end_mem - start_mem) / N, ' bytes per parser')
    
@@ -362,9 +375,315 @@ local function per_parser_overhead(N)
     full_gc()
 end
 
+local function churn_new_loop(N, data)
+    for i=1,N do
+        local parser = hm.request()
+        parser:append(data)
+        parser:execute()
+    end
+end
+
+local function churn_set_loop(N, data, set)
+    for i=1,N do
+        local parser = set:add(1)
+        parser:append(data)
+        parser:execute()
+        set:remove(1)
+    end
+end
+
+-- short-lived connections: new parser for each request vs. re-used parsers from a pool.
+local function churn_test(N)
+    local data = tconcat(requests.firefox)
+    full_gc()
+    local diff1 = bench('new parser', N, churn_new_loop, data)
+    full_gc()
+    local diff2 = bench('pooled parser', N, churn_set_loop, data, hm.request_set())
+    printf("units/sec: new %10.3f, pooled %10.3f", N / diff1, N / diff2)
+    print()
+    full_gc()
+end
+
+local function get_header_loop(N, parser)
+    for i=1,N do
+        local count = parser:count_headers()
+        for x=0,count-1 do
+            local id, name, value = parser:get_header(x)
+        end
+    end
+end
+
+local function get_headers_batch(N, parser, headers)
+    for i=1,N do
+        local count = parser:get_headers(headers)
+    end
+end
+
+local function headers_test(N)
+    local parser = hm.request()
+    parser:append(tconcat(requests.firefox))
+    parser:execute()
+    local headers = {}
+    full_gc()
+    local diff1 = bench('get_header', N, get_header_loop, parser)
+    full_gc()
+    local diff2 = bench('get_headers', N, get_headers_batch, parser, headers)
+    printf("per request: get_header %10.3f us, get_headers %10.3f us",
+        (diff1 / N) * 1e6, (diff2 / N) * 1e6)
+    print()
+    parser = nil
+    full_gc()
+end
+
+-- a CDN request: large cookie jar, content-negotiation & cache headers.
+local cookie_request = tconcat({
+    "GET /app HTTP/1.1\r\n",
+    "Host: www.example.com\r\n",
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n",
+    "Accept-Encoding: gzip;q=0.8, deflate, br\r\n",
+    "Cache-Control: no-cache, max-age=0\r\n",
+    "Cookie: ", string.rep("_ga=GA1.2.1978343211.1697530000; _gid=GA1.2.873645123.1697530000; " ..
+        "_fbp=fb.1.1697530000123.1234567890; ", 8), "sid=Fe26.2**0cdd607945dd1dffb7da0b0bf5f1a7da\r\n",
+    "\r\n",
+})
+
+local function header_split_loop(N, parser, ids)
+    local COOKIE, ACCEPT_ENCODING, CACHE_CONTROL =
+        ids["Cookie"], ids["Accept-Encoding"], ids["Cache-Control"]
+    for i=1,N do
+        local cookies = {}
+        for k, v in parser:find_header(COOKIE):gmatch("([^=;%s]+)=([^;]*)") do
+            cookies[k] = v
+        end
+        local sid = cookies.sid
+        local gzip_q
+        for item in parser:find_header(ACCEPT_ENCODING):gmatch("[^,]+") do
+            local coding, params = item:match("^%s*([^;%s]+)%s*;?(.*)")
+            if coding == "gzip" then
+                gzip_q = tonumber(params:match("q=([%d.]+)")) or 1
+            end
+        end
+        local max_age = parser:find_header(CACHE_CONTROL):match("max%-age=(%d+)")
+    end
+end
+
+local function header_item_loop(N, parser, ids)
+    local COOKIE, ACCEPT_ENCODING, CACHE_CONTROL =
+        ids["Cookie"], ids["Accept-Encoding"], ids["Cache-Control"]
+    for i=1,N do
+        local sid = parser:find_header_item(COOKIE, "sid")
+        local _, gzip_q = parser:find_header_item(ACCEPT_ENCODING, "gzip")
+        local max_age = parser:find_header_item(CACHE_CONTROL, "max-age")
+    end
+end
+
+-- cookie/content-negotiation/cache lookups: splitting in Lua vs. find_header_item.
+local function header_items_test(N)
+    local parser = hm.request()
+    parser:append(cookie_request)
+    parser:execute()
+    full_gc()
+    local diff1 = bench('lua split', N, header_split_loop, parser, hm.header_ids)
+    full_gc()
+    local diff2 = bench('find_header_item', N, header_item_loop, parser, hm.header_ids)
+    printf("per request: lua split %10.3f us, find_header_item %10.3f us",
+        (diff1 / N) * 1e6, (diff2 / N) * 1e6)
+    print()
+    full_gc()
+end
+
+local function raw_parse_loop(N, parser, data)
+    for i=1,N do
+        parser:append(data)
+        parser:execute()
+        parser:next_message()
+    end
+end
+
+local function scan_test(N)
+    local data = tconcat(requests.firefox)
+    full_gc()
+    local diff1 = bench('http_parser', N, raw_parse_loop, hm.request(), data)
+    full_gc()
+    local diff2 = bench('fast scan (' .. hm.scan_impl() .. ')', N, raw_parse_loop,
+        hm.request(hm.options.FAST_SCAN), data)
+    printf("units/sec: http_parser %10.3f, fast scan %10.3f", N / diff1, N / diff2)
+    print()
+    full_gc()
+end
+
+local function pipeline_loop(N, parser, data, count)
+    for i=1,N do
+        parser:append(data)
+        for n=1,count do
+            parser:execute()
+            parser:next_message()
+        end
+    end
+end
+
+local function pipeline_test(N, count)
+    local data = string.rep(tconcat(requests.firefox), count)
+    local parser = hm.request()
+    full_gc()
+    local diff1 = bench('pipelined x' .. count, N, pipeline_loop, parser, data, count)
+    printf("units/sec: %10.3f, bytes moved: %d, buffer high water: %d",
+        (N * count) / diff1, parser:bytes_moved(), parser:buffer_high_water())
+    print()
+    full_gc()
+end
+
+local function url_pattern_loop(N, parser)
+    for i=1,N do
+        local path, query, fragment = parse_path_query_fragment(parser:get_url())
+    end
+end
+
+local function url_field_loop(N, parser, fields)
+    local PATH, QUERY = fields.PATH, fields.QUERY
+    for i=1,N do
+        local path, query = parser:get_url_field(PATH), parser:get_url_field(QUERY)
+    end
+end
+
+local function url_parts_loop(N, parser, fields)
+    local PATH, QUERY = fields.PATH * 2 + 1, fields.QUERY * 2 + 1
+    local parts = {}
+    for i=1,N do
+        local url = parser:get_url_parts(parts)
+        local off, query = parts[QUERY], nil
+        local path = url:sub(parts[PATH] + 1, parts[PATH] + parts[PATH + 1])
+        if off >= 0 then query = url:sub(off + 1, off + parts[QUERY + 1]) end
+    end
+end
+
+-- split the url with Lua patterns vs. only getting the needed fields from C.
+local function url_test(N)
+    local parser = hm.request()
+    parser:append(tconcat(requests.ab))
+    parser:execute()
+    full_gc()
+    local diff1 = bench('lua patterns', N, url_pattern_loop, parser)
+    full_gc()
+    local diff2 = bench('get_url_field', N, url_field_loop, parser, hm.url_fields)
+    full_gc()
+    local diff3 = bench('get_url_parts', N, url_parts_loop, parser, hm.url_fields)
+    printf("per request: lua patterns %10.3f us, get_url_field %10.3f us, get_url_parts %10.3f us",
+        (diff1 / N) * 1e6, (diff2 / N) * 1e6, (diff3 / N) * 1e6)
+    print()
+    full_gc()
+end
+
+-- parameter heavy form: 40 pairs, every 4th value has escapes.
+local form_body
+do
+    local params = {}
+    for i=1,40 do
+        if i % 4 == 0 then
+            params[i] = "param" .. i .. "=value+with%20escapes%2F" .. i
+        else
+            params[i] = "param" .. i .. "=value" .. i
+        end
+    end
+    form_body = tconcat(params, "&")
+end
+
+local function lua_url_decode(str)
+    str = str:gsub("%+", " ")
+    return (str:gsub("%%(%x%x)", function(hex) return string.char(tonumber(hex, 16)) end))
+end
+
+local function form_lua_loop(N, body)
+    for i=1,N do
+        local tbl = {}
+        for key, value in body:gmatch("([^&=]*)=?([^&]*)") do
+            if key ~= "" then
+                tbl[#tbl + 1] = lua_url_decode(key)
+                tbl[#tbl + 1] = lua_url_decode(value)
+            end
+        end
+    end
+end
+
+local function form_c_loop(N, body, form)
+    for i=1,N do
+        form:feed(body, true, {})
+    end
+end
+
+-- tokenize & decode a form body: Lua gmatch/gsub vs. HMForm.
+local function form_test(N)
+    local form = hm.form()
+    full_gc()
+    local diff1 = bench('lua gmatch', N, form_lua_loop, form_body)
+    full_gc()
+    local diff2 = bench('form:feed', N, form_c_loop, form_body, form)
+    printf("per form (40 params): lua gmatch %10.3f us, form:feed %10.3f us",
+        (diff1 / N) * 1e6, (diff2 / N) * 1e6)
+    print()
+    full_gc()
+end
+
+local response_body = string.rep("x", 512)
+
+local function concat_response()
+    return tconcat({
+        "HTTP/1.1 200 OK\r\n",
+        "Content-Type: text/html\r\n",
+        "Connection: keep-alive\r\n",
+        "Content-Length: ", #response_body, "\r\n",
+        "\r\n",
+        response_body,
+    })
+end
+
+local function writer_response(writer, ids)
+    writer:status_line(200)
+    writer:header(ids["Content-Type"], "text/html")
+    writer:header(ids["Connection"], "keep-alive")
+    writer:content_length(#response_body)
+    writer:end_headers()
+    writer:body(response_body)
+    return writer:data()
+end
+
+local function roundtrip_loop(N, parser, build, ...)
+    for i=1,N do
+        parser:append(build(...))
+        parser:execute()
+        parser:next_message()
+    end
+end
+
+-- build a response & parse it back: Lua string concat vs. HMWriter.
+local function roundtrip_test(N)
+    local parser = hm.response()
+    local writer = hm.writer()
+    full_gc()
+    collectgarbage"stop"
+    local start_mem = collectgarbage"count"
+    local diff1 = bench('concat', N, roundtrip_loop, parser, concat_response)
+    local concat_mem = collectgarbage"count" - start_mem
+    collectgarbage"restart"
+    full_gc()
+    collectgarbage"stop"
+    start_mem = collectgarbage"count"
+    local diff2 = bench('writer', N, roundtrip_loop, parser, writer_response,
+        writer, hm.header_ids)
+    local writer_mem = collectgarbage"count" - start_mem
+    collectgarbage"restart"
+    printf("units/sec: concat %10.3f, writer %10.3f", N / diff1, N / diff2)
+    printf("garbage per response: concat %.1f bytes, writer %.1f bytes",
+        (concat_mem * 1024) / N, (writer_mem * 1024) / N)
+    print()
+    full_gc()
+end
+
 local clients = {
     { name = 'good', cb = good_client, mem_N=1, speed_N=N*10},
     { name = 'bad', cb = bad_client, mem_N=1, speed_N=N},
+    { name = 'bad (wait headers)', cb = bad_client, mem_N=1, speed_N=N,
+        opts = hm.options.WAIT_HEADERS },
 }
 
 local function run_test(apply)
@@ -382,4 +701,26 @@ run_test(apply_client_speedtest)
 print('overhead test')
 per_parser_overhead(N)
 
+print('headers test (firefox)')
+headers_test(N*10)
+
+print('header items test (cookies)')
+header_items_test(N)
+
+print('url test (ab)')
+url_test(N*10)
+
+print('form test (40 params)')
+form_test(N)
+
+print('parse test (firefox)')
+scan_test(N*10)
+
+print('pipeline test (firefox)')
+pipeline_test(N, 16)
+
+print('connection churn test (firefox)')
+churn_test(N)
 
+print('response round-trip test')
+roundtrip_test(N)
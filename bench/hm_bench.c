@@ -0,0 +1,316 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Parser benchmark without Lua.
+ *
+ * usage: hm_bench [scale] [scenario]
+ *
+ *   scale     multiply the number of iterations (default 1.0, ~32MB per scenario).
+ *   scenario  only run scenarios with this substring in their name.
+ *
+ * For each scenario & parser option set it reports throughput, messages/sec,
+ * cycles/byte (TSC reference cycles on x86) and allocations per message.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HM_BENCH_HAVE_TSC 1
+#endif
+
+#include "hm_parser.h"
+#include "hm_alloc.h"
+#include "hm_scan.h"
+
+#include "hm_bench_corpus.h"
+
+#define BENCH_BYTES (32 * 1024 * 1024)
+
+typedef struct Scenario {
+	const char  *name;
+	int         is_request;
+	size_t      frag;       /**< append the data in pieces of this size (0 = all at once). */
+	uint32_t    msgs;       /**< messages in `data`. */
+	char        *data;
+	size_t      len;
+} Scenario;
+
+/* counts allocation calls, forwards to the default allocator. */
+static uint64_t bench_allocs = 0;
+
+static void *bench_alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+	HMAllocator *def = hm_allocator_default();
+	(void)ud;
+	if(nsize > 0) {
+		bench_allocs++;
+	}
+	return def->alloc(def->ud, ptr, osize, nsize);
+}
+
+static uint64_t bench_now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t bench_cycles() {
+#ifdef HM_BENCH_HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* simple growable string for building the larger messages. */
+typedef struct Builder {
+	char    *data;
+	size_t  len;
+	size_t  cap;
+} Builder;
+
+static void builder_add(Builder *b, const char *data, size_t len) {
+	if(b->len + len > b->cap) {
+		b->cap = (b->len + len) * 2;
+		b->data = (char *)realloc(b->data, b->cap);
+		if(b->data == NULL) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+#define builder_str(b, str) builder_add(b, str, strlen(str))
+
+static void builder_printf(Builder *b, const char *fmt, size_t val) {
+	char tmp[64];
+	int len = snprintf(tmp, sizeof(tmp), fmt, val);
+	builder_add(b, tmp, len);
+}
+
+static void builder_fill(Builder *b, char c, size_t len) {
+	char tmp[256];
+
+	memset(tmp, c, sizeof(tmp));
+	while(len > 0) {
+		size_t n = (len < sizeof(tmp)) ? len : sizeof(tmp);
+		builder_add(b, tmp, n);
+		len -= n;
+	}
+}
+
+static Scenario *scenario_add(Scenario *list, uint32_t *count, const char *name, int is_request,
+		size_t frag, uint32_t msgs, Builder *b) {
+	Scenario *s = &(list[(*count)++]);
+	s->name = name;
+	s->is_request = is_request;
+	s->frag = frag;
+	s->msgs = msgs;
+	s->data = b->data;
+	s->len = b->len;
+	memset(b, 0, sizeof(Builder));
+	return s;
+}
+
+static uint32_t build_scenarios(Scenario *list) {
+	Builder b = { NULL, 0, 0 };
+	uint32_t count = 0;
+	size_t idx;
+
+	/* small requests from bench.lua. */
+	builder_str(&b, hm_corpus_ab);
+	builder_str(&b, hm_corpus_httperf);
+	builder_str(&b, hm_corpus_firefox);
+	scenario_add(list, &count, "small_requests", 1, 0, 3, &b);
+
+	builder_str(&b, hm_corpus_chrome);
+	scenario_add(list, &count, "browser", 1, 0, 1, &b);
+
+	builder_str(&b, hm_corpus_curl_post);
+	scenario_add(list, &count, "api_post", 1, 0, 1, &b);
+
+	/* ~4KB of cookies. */
+	builder_str(&b, "GET /account HTTP/1.1\r\nHost: www.example.com\r\nCookie: ");
+	for(idx = 0; idx < 12; idx++) {
+		builder_str(&b, hm_corpus_cookies);
+	}
+	builder_str(&b, "last=1\r\nAccept: text/html\r\n\r\n");
+	scenario_add(list, &count, "large_cookies", 1, 0, 1, &b);
+
+	/* 8KB url. */
+	builder_str(&b, "GET /search?q=");
+	builder_fill(&b, 'q', 4096);
+	builder_str(&b, "&filter=");
+	builder_fill(&b, 'f', 4096);
+	builder_str(&b, " HTTP/1.1\r\nHost: www.example.com\r\n\r\n");
+	scenario_add(list, &count, "long_url", 1, 0, 1, &b);
+
+	/* chunked upload, 64 x 1KB chunks. */
+	builder_str(&b, "POST /upload HTTP/1.1\r\nHost: files.example.com\r\nTransfer-Encoding: chunked\r\n\r\n");
+	for(idx = 0; idx < 64; idx++) {
+		builder_str(&b, "400\r\n");
+		builder_fill(&b, 'u', 1024);
+		builder_str(&b, "\r\n");
+	}
+	builder_str(&b, "0\r\n\r\n");
+	scenario_add(list, &count, "chunked_upload", 1, 0, 1, &b);
+
+	/* 32 pipelined requests in one read. */
+	for(idx = 0; idx < 32; idx++) {
+		builder_str(&b, (idx & 1) ? hm_corpus_chrome : hm_corpus_firefox);
+	}
+	scenario_add(list, &count, "pipelined_32", 1, 0, 32, &b);
+
+	/* byte-fragmented input, a slow client or tiny TCP segments. */
+	builder_str(&b, hm_corpus_firefox);
+	scenario_add(list, &count, "fragmented_1", 1, 1, 1, &b);
+
+	builder_str(&b, hm_corpus_chrome);
+	scenario_add(list, &count, "fragmented_7", 1, 7, 1, &b);
+
+	/* responses. */
+	builder_str(&b, hm_corpus_nginx_response);
+	builder_fill(&b, 'h', 512);
+	scenario_add(list, &count, "response", 0, 0, 1, &b);
+
+	builder_str(&b, hm_corpus_chunked_response);
+	for(idx = 0; idx < 16; idx++) {
+		builder_printf(&b, "%zx\r\n", 256 + idx);
+		builder_fill(&b, 'j', 256 + idx);
+		builder_str(&b, "\r\n");
+	}
+	builder_str(&b, "0\r\n\r\n");
+	scenario_add(list, &count, "chunked_response", 0, 0, 1, &b);
+
+	builder_str(&b, hm_corpus_nginx_response);
+	builder_fill(&b, 'h', 512);
+	scenario_add(list, &count, "response_frag_16", 0, 16, 1, &b);
+
+	return count;
+}
+
+/* parse all of the scenario's data, returns the number of completed messages or -1. */
+static int bench_parse(HMParser *parser, Scenario *s) {
+	const char *data = s->data;
+	size_t len = s->len;
+	size_t off = 0;
+	int msgs = 0;
+	int state;
+
+	while(off < len) {
+		size_t n = len - off;
+		if(s->frag > 0 && n > s->frag) {
+			n = s->frag;
+		}
+		n = hm_parser_append_data(parser, data + off, n);
+		if(n == 0) {
+			return -1;
+		}
+		off += n;
+		for(;;) {
+			state = hm_parser_execute(parser);
+			if(state & HM_PARSER_STATE_ERROR) {
+				return -1;
+			}
+			if((state & ~HM_PARSER_STATE_NEEDS_INPUT) == HM_PARSER_STATE_MESSAGE_COMPLETE) {
+				size_t body_len;
+				while(hm_parser_next_body(parser, &body_len) != NULL);
+				hm_parser_next_message(parser);
+				msgs++;
+				continue;
+			}
+			if(state & HM_PARSER_STATE_NEEDS_INPUT) {
+				break;
+			}
+		}
+	}
+	return msgs;
+}
+
+static void bench_run(Scenario *s, uint32_t opts, const char *opts_name, double scale) {
+	HMAllocator allocator;
+	HMParser *parser;
+	uint64_t iters = (uint64_t)((BENCH_BYTES / s->len) * scale);
+	uint64_t idx;
+	uint64_t start_ns, ns;
+	uint64_t start_cycles, cycles;
+	uint64_t allocs;
+	double bytes, msgs;
+
+	if(iters == 0) iters = 1;
+	hm_allocator_init(&allocator, bench_alloc, NULL);
+	if(s->is_request) {
+		parser = hm_parser_new_request_alloc(opts, &allocator);
+	} else {
+		parser = hm_parser_new_response_alloc(opts, &allocator);
+	}
+	/* warm up & check the scenario. */
+	if(bench_parse(parser, s) != (int)s->msgs) {
+		fprintf(stderr, "%s/%s: failed to parse: %s\n", s->name, opts_name,
+			hm_parser_error_description(parser));
+		hm_parser_free(parser);
+		return;
+	}
+	allocs = bench_allocs;
+	start_ns = bench_now_ns();
+	start_cycles = bench_cycles();
+	for(idx = 0; idx < iters; idx++) {
+		bench_parse(parser, s);
+	}
+	cycles = bench_cycles() - start_cycles;
+	ns = bench_now_ns() - start_ns;
+	allocs = bench_allocs - allocs;
+	hm_parser_free(parser);
+
+	bytes = (double)s->len * iters;
+	msgs = (double)s->msgs * iters;
+	printf("%-18s %-10s %9.1f MB/s %11.0f msg/s", s->name, opts_name,
+		(bytes / (1024.0 * 1024.0)) / (ns / 1e9), msgs / (ns / 1e9));
+#ifdef HM_BENCH_HAVE_TSC
+	printf(" %7.2f cycles/byte", (double)cycles / bytes);
+#else
+	(void)cycles;
+	printf(" %7.2f ns/byte", (double)ns / bytes);
+#endif
+	printf(" %7.3f allocs/msg\n", (double)allocs / msgs);
+}
+
+int main(int argc, char *argv[]) {
+	Scenario list[32];
+	double scale = 1.0;
+	const char *filter = NULL;
+	uint32_t count;
+	uint32_t idx;
+
+	if(argc > 1) {
+		scale = atof(argv[1]);
+		if(scale <= 0.0) scale = 1.0;
+	}
+	if(argc > 2) {
+		filter = argv[2];
+	}
+	count = build_scenarios(list);
+	printf("scanner: %s\n", hm_scan_impl());
+	for(idx = 0; idx < count; idx++) {
+		Scenario *s = &(list[idx]);
+		if(filter != NULL && strstr(s->name, filter) == NULL) {
+			continue;
+		}
+		bench_run(s, HM_PARSER_OPT_NONE, "default", scale);
+		if(s->is_request) {
+			bench_run(s, HM_PARSER_OPT_FAST_SCAN, "fast_scan", scale);
+		}
+		bench_run(s, HM_PARSER_OPT_SINGLE_ALLOC | HM_PARSER_OPT_DISCARD_BODY, "discard", scale);
+		free(s->data);
+	}
+	return 0;
+}
+
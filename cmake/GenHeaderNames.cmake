@@ -0,0 +1,53 @@
+# - Generate hm_header_names.h from hm_header_ids.gperf
+# Run with cmake -P, the following variables must be set:
+#  GPERF_SRC: the gperf keyword file.
+#  OUTPUT: the header to generate.
+#
+# The header has HM_MAX_HEADER_IDS, a HM_HEADER_<NAME> define for each header id
+# and the HM_HEADER_NAMES(_) list of `_(id, "Canonical-Name")` entries.
+
+file(STRINGS ${GPERF_SRC} _lines)
+
+set(_keywords FALSE)
+set(_max_id 0)
+set(_defines "")
+set(_names "")
+foreach(_line IN LISTS _lines)
+	if(_line STREQUAL "%%")
+		set(_keywords TRUE)
+	elseif(_keywords AND _line MATCHES "^([^#: \t][^: \t]*):[ \t]*([0-9]+)")
+		set(_name ${CMAKE_MATCH_1})
+		set(_id ${CMAKE_MATCH_2})
+		string(TOUPPER "HM_HEADER_${_name}" _define)
+		string(REPLACE "-" "_" _define ${_define})
+		string(LENGTH ${_define} _len)
+		while(_len LESS 38)
+			set(_define "${_define} ")
+			math(EXPR _len "${_len} + 1")
+		endwhile()
+		set(_defines "${_defines}#define ${_define}${_id}\n")
+		set(_names "${_names} \\\n\t_(${_id}, \"${_name}\")")
+		if(_id GREATER _max_id)
+			set(_max_id ${_id})
+		endif()
+	endif()
+endforeach()
+math(EXPR _max_ids "${_max_id} + 1")
+
+# only touch the header when it changes.
+file(WRITE ${OUTPUT}.tmp "/* generated from hm_header_ids.gperf by GenHeaderNames.cmake, don't edit. */
+#ifndef __HM_HEADER_NAMES_H__
+#define __HM_HEADER_NAMES_H__
+
+/* header ids from hm_header_ids.gperf are less then this. */
+#define HM_MAX_HEADER_IDS ${_max_ids}
+
+/* header ids. */
+${_defines}
+/* canonical header names, `_(id, name)` for each header id. */
+#define HM_HEADER_NAMES(_)${_names}
+
+#endif /* __HM_HEADER_NAMES_H__ */
+")
+configure_file(${OUTPUT}.tmp ${OUTPUT} COPYONLY)
+file(REMOVE ${OUTPUT}.tmp)
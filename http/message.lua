@@ -19,6 +19,8 @@
 -- THE SOFTWARE.
 
 local setmetatable = setmetatable
+local type = type
+local pairs = pairs
 
 local hm = require"http_message"
 
@@ -27,25 +29,26 @@ local meths = {}
 parser_mt.__index = meths
 
 
+-- in batch mode the callbacks are called for a detached message.
 function meths:is_upgrade()
-	return self.hm_parser:is_upgrade()
+	return (self.message or self.hm_parser):is_upgrade()
 end
 
 function meths:should_keep_alive()
-	return self.hm_parser:should_keep_alive()
+	return (self.message or self.hm_parser):should_keep_alive()
 end
 
 function meths:method()
-	return self.hm_parser:method_str()
+	return (self.message or self.hm_parser):method_str()
 end
 
 function meths:version()
-	local version = self.hm_parser:version()
+	local version = (self.message or self.hm_parser):version()
 	return (version / 65536), (version % 65536)
 end
 
 function meths:status_code()
-	return self.hm_parser:status_code()
+	return (self.message or self.hm_parser):status_code()
 end
 
 function meths:is_error()
@@ -98,13 +101,24 @@ local ERROR = states.ERROR
 local function hm_MESSAGE_COMPLETE(self)
 	-- Send on_body(nil) message to comply with LTN12
 	self:on_body()
-	self:on_message_complete()
-	-- Prepare parser for next message.
-	self.hm_parser:next_message()
+	if self.detach then
+		-- hand the message off to the request, fields are decoded on access.
+		self.req.message = self.hm_parser:detach_message()
+		self:on_message_complete()
+	else
+		self:on_message_complete()
+		-- Prepare parser for next message.
+		self.hm_parser:next_message()
+	end
 	self.last_state = NONE
 end
 
 local function hm_BODY(self)
+	if self.keep_body then
+		-- the body stays in the parser, it is read from the detached message.
+		self.last_state = HEADERS_COMPLETE
+		return
+	end
 	local on_body = self.on_body
 	local hm_parser = self.hm_parser
 	repeat
@@ -121,14 +135,15 @@ local function hm_HEADERS_COMPLETE(self)
 	local hm_parser = self.hm_parser
 	local req = self.req
 	req.url = hm_parser:get_url()
-	local count = hm_parser:count_headers()
+	local tmp = self.headers_tmp
+	local count = hm_parser:get_headers(tmp)
 	local headers = req.headers
-	for i=0,count-1 do
-		local id, name, value = hm_parser:get_header(i)
-		if id > 0 then
-			name = header_ids[id]
+	for i=1,count*2,2 do
+		local name = tmp[i]
+		if type(name) == 'number' then
+			name = header_ids[name]
 		end
-		headers[name] = value
+		headers[name] = tmp[i + 1]
 	end
 	self:on_headers_complete()
 end
@@ -151,10 +166,64 @@ local parser_states = {
 	[MESSAGE_COMPLETE] = hm_MESSAGE_COMPLETE,
 }
 
+-- call the callbacks for each message from a HM_PARSER_OPT_BATCH parser.
+local function hm_BATCH(self)
+	local msgs = self.batch_tmp
+	local count = self.hm_parser:batch_messages(msgs)
+	for i=1,count do
+		local msg = msgs[i]
+		msgs[i] = nil
+		self.message = msg
+		local req = self:on_message_begin()
+		self.req = req
+		if self.detach then
+			req.message = msg
+		end
+		req.url = msg:get_url()
+		local headers = req.headers
+		for idx=0,msg:count_headers()-1 do
+			local id, name, value = msg:get_header(idx)
+			if id > 0 then
+				name = header_ids[id]
+			end
+			headers[name] = value
+		end
+		self:on_headers_complete()
+		local on_body = self.on_body
+		while not self.keep_body do
+			local data = msg:next_body()
+			if not data then break end
+			on_body(self, data)
+		end
+		on_body(self)
+		self:on_message_complete()
+	end
+	self.message = nil
+end
+
+local function batch_execute(self)
+	local hm_parser = self.hm_parser
+	repeat
+		local rc = hm_parser:execute()
+		if (rc % NEEDS_INPUT) == MESSAGE_COMPLETE then
+			hm_BATCH(self)
+		end
+		if rc >= ERROR then
+			-- parser error
+			return self:on_error()
+		end
+	until rc >= NEEDS_INPUT
+	return true
+end
+
 local function parser_execute(self)
 	local hm_parser = self.hm_parser
 	local needs_input = false
 
+	if self.batch then
+		return batch_execute(self)
+	end
+
 	local rc = hm_parser:execute()
 	if rc >= NEEDS_INPUT then
 		if rc >= ERROR then
@@ -181,13 +250,60 @@ local function parser_execute(self)
 	return parser_execute(self)
 end
 
+-- returns nil, "max. buffer size reached" and the number of bytes parsed when the
+-- rest of `data` doesn't fit in the buffer.
 function meths:execute(data)
 	if data then
-		self.hm_parser:append(data)
+		local hm_parser = self.hm_parser
+		local len = #data
+		local off = hm_parser:append(data)
+		-- the buffer is at it's max. size, parse what is in the buffer to make room.
+		while off < len do
+			local rc = parser_execute(self)
+			if hm_parser:is_error() then return rc end
+			local n = hm_parser:append(data, off)
+			if n == 0 then return nil, "max. buffer size reached", off end
+			off = off + n
+		end
 	end
 	return parser_execute(self)
 end
 
+local errors = {}
+for name, errno in pairs(hm.errors) do
+	errors[-errno] = name
+end
+
+-- parse `n` bytes read into the parser's buffer.
+local function parse_read(self, n)
+	if n < 0 then
+		return nil, errors[n] or ("errno " .. -n)
+	end
+	parser_execute(self)
+	if n == 0 then
+		return nil, "EOF"
+	end
+	return n
+end
+
+-- read from file descriptor `fd` (at most `max` bytes) directly into the parser's
+-- buffer and parse it.  Returns the number of bytes read or nil and "EOF", "EAGAIN"
+-- (no data on a non-blocking fd) or another errno name.  Parse errors are passed
+-- to on_error().
+function meths:read_fd(fd, max)
+	return parse_read(self, self.hm_parser:read_fd(fd, max))
+end
+
+-- same as read_fd(), with recv() `flags` from http_message.recv_flags.
+function meths:recv(fd, max, flags)
+	return parse_read(self, self.hm_parser:recv(fd, max, flags))
+end
+
+-- same as read_fd(), but only grows the buffer when the data doesn't fit.
+function meths:readv_fd(fd, max)
+	return parse_read(self, self.hm_parser:readv_fd(fd, max))
+end
+
 function meths:execute_buffer(buf)
 	if buf then
 		self.hm_parser:append_buffer(buf)
@@ -201,21 +317,47 @@ function meths:reset()
 	return self:on_reset()
 end
 
-local function create_parser(hm_parser)
+local options = hm.options
+local BATCH = options.BATCH
+local STREAM_BODY = options.STREAM_BODY
+local DISCARD_BODY = options.DISCARD_BODY
+
+-- test for option `opt` in `opts`.
+local function has_opt(opts, opt)
+	return opts ~= nil and (opts % (opt * 2)) >= opt
+end
+
+local function create_parser(hm_parser, detach, opts)
+	if not hm_parser then
+		-- BATCH can't be combined with STREAM_BODY/DISCARD_BODY.
+		return nil, "invalid parser options"
+	end
 	local self = {
 		hm_parser = hm_parser,
 		last_state = NONE,
+		detach = detach,
+		-- streamed bodies are dropped from the parser, so they are always passed to on_body.
+		keep_body = detach and not (has_opt(opts, STREAM_BODY) or has_opt(opts, DISCARD_BODY)),
+		headers_tmp = {},
 	}
+	if has_opt(opts, BATCH) then
+		self.batch = true
+		self.batch_tmp = {}
+	end
 	return setmetatable(self, parser_mt)
 end
 
 module(...)
 
-function request()
-	return create_parser(hm.request())
+-- When `detach` is true the completed message is also stored in `req.message` (a
+-- detached HMMessage).  Unless the body is streamed it isn't passed to `on_body`,
+-- it is read with `req.message:next_body()`; `on_body()` is still called at the end.
+-- `opts` are parser options from `http_message.options`.
+function request(detach, opts)
+	return create_parser(hm.request(opts), detach, opts)
 end
 
-function response()
-	return create_parser(hm.response())
+function response(detach, opts)
+	return create_parser(hm.response(opts), detach, opts)
 end
 
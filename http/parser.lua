@@ -19,6 +19,8 @@
 -- THE SOFTWARE.
 
 local setmetatable = setmetatable
+local type = type
+local pairs = pairs
 
 local hm = require"http_message"
 
@@ -39,25 +41,26 @@ end,
 }
 parser_mt.__index = meths
 
+-- in batch mode the callbacks are called for a detached message.
 function meths:is_upgrade()
-	return self.hm_parser:is_upgrade()
+	return (self.message or self.hm_parser):is_upgrade()
 end
 
 function meths:should_keep_alive()
-	return self.hm_parser:should_keep_alive()
+	return (self.message or self.hm_parser):should_keep_alive()
 end
 
 function meths:method()
-	return self.hm_parser:method_str()
+	return (self.message or self.hm_parser):method_str()
 end
 
 function meths:version()
-	local version = self.hm_parser:version()
+	local version = (self.message or self.hm_parser):version()
 	return (version / 65536), (version % 65536)
 end
 
 function meths:status_code()
-	return self.hm_parser:status_code()
+	return (self.message or self.hm_parser):status_code()
 end
 
 function meths:is_error()
@@ -68,6 +71,10 @@ function meths:error()
 	return self.hm_parser:error(), self.hm_parser:error_name(), self.hm_parser:error_description()
 end
 
+function meths:limit()
+	return self.hm_parser:limit()
+end
+
 local states = hm.states
 local NONE = states.NONE
 local MESSAGE_BEGIN = states.MESSAGE_BEGIN
@@ -113,14 +120,15 @@ local header_ids = hm.header_ids
 local function hm_HEADERS_COMPLETE(self)
 	local hm_parser = self.hm_parser
 	flush_url(self)
-	local count = hm_parser:count_headers()
+	local headers = self.headers_tmp
+	local count = hm_parser:get_headers(headers)
 	local on_header = self.on_header
-	for i=0,count-1 do
-		local id, name, value = hm_parser:get_header(i)
-		if id > 0 then
-			name = header_ids[id]
+	for i=1,count*2,2 do
+		local name = headers[i]
+		if type(name) == 'number' then
+			name = header_ids[name]
 		end
-		on_header(name, value)
+		on_header(name, headers[i + 1])
 	end
 	self.on_headers_complete()
 end
@@ -148,10 +156,60 @@ local parser_states = {
 	[MESSAGE_COMPLETE] = hm_MESSAGE_COMPLETE,
 }
 
+-- call the callbacks for each message from a HM_PARSER_OPT_BATCH parser.
+local function hm_BATCH(self)
+	local msgs = self.batch_tmp
+	local count = self.hm_parser:batch_messages(msgs)
+	for i=1,count do
+		local msg = msgs[i]
+		msgs[i] = nil
+		self.message = msg
+		self.on_message_begin()
+		self.on_url(msg:get_url())
+		local on_header = self.on_header
+		for idx=0,msg:count_headers()-1 do
+			local id, name, value = msg:get_header(idx)
+			if id > 0 then
+				name = header_ids[id]
+			end
+			on_header(name, value)
+		end
+		self.on_headers_complete()
+		local on_body = self.on_body
+		repeat
+			local data = msg:next_body()
+			if not data then break end
+			on_body(data)
+		until false
+		on_body()
+		self.on_message_complete()
+	end
+	self.message = nil
+end
+
+local function batch_execute(self, len)
+	local hm_parser = self.hm_parser
+	repeat
+		local rc = hm_parser:execute()
+		if (rc % NEEDS_INPUT) == MESSAGE_COMPLETE then
+			hm_BATCH(self)
+		end
+		if rc >= ERROR then
+			-- parser error
+			return 0
+		end
+	until rc >= NEEDS_INPUT
+	return len
+end
+
 local function parser_execute(self, len)
 	local hm_parser = self.hm_parser
 	local needs_input = false
 
+	if self.batch then
+		return batch_execute(self, len)
+	end
+
 	local rc = hm_parser:execute()
 	if rc >= NEEDS_INPUT then
 		if rc >= ERROR then
@@ -178,12 +236,33 @@ local function parser_execute(self, len)
 	return parser_execute(self, len)
 end
 
+-- append `data` to the parser's buffer.  When the buffer is at it's max. size
+-- parse what is in the buffer to make room for more data.
+local function append_data(self, data, len)
+	local hm_parser = self.hm_parser
+	local off = hm_parser:append(data)
+	while off < len do
+		parser_execute(self, off)
+		if hm_parser:is_error() then break end
+		local n = hm_parser:append(data, off)
+		if n == 0 then break end
+		off = off + n
+	end
+	return off
+end
+
+-- returns the number of bytes parsed, or nil, "max. buffer size reached" and the
+-- number of bytes parsed when the rest of `data` doesn't fit in the buffer.
 function meths:execute(data)
 	local len = 0
 	if data then
 		len = #data
 		if len > 0 then
-			self.hm_parser:append(data)
+			local off = append_data(self, data, len)
+			if off < len and not self.hm_parser:is_error() then
+				return nil, "max. buffer size reached", parser_execute(self, off)
+			end
+			len = off
 		else
 			self.hm_parser:eof()
 		end
@@ -191,6 +270,40 @@ function meths:execute(data)
 	return parser_execute(self, len)
 end
 
+local errors = {}
+for name, errno in pairs(hm.errors) do
+	errors[-errno] = name
+end
+
+-- parse `n` bytes read into the parser's buffer.
+local function parse_read(self, n)
+	if n < 0 then
+		return nil, errors[n] or ("errno " .. -n)
+	end
+	parser_execute(self, n)
+	if n == 0 then
+		return nil, "EOF"
+	end
+	return n
+end
+
+-- read from file descriptor `fd` (at most `max` bytes) directly into the parser's
+-- buffer and parse it.  Returns the number of bytes read or nil and "EOF", "EAGAIN"
+-- (no data on a non-blocking fd) or another errno name.
+function meths:read_fd(fd, max)
+	return parse_read(self, self.hm_parser:read_fd(fd, max))
+end
+
+-- same as read_fd(), with recv() `flags` from http_message.recv_flags.
+function meths:recv(fd, max, flags)
+	return parse_read(self, self.hm_parser:recv(fd, max, flags))
+end
+
+-- same as read_fd(), but only grows the buffer when the data doesn't fit.
+function meths:readv_fd(fd, max)
+	return parse_read(self, self.hm_parser:readv_fd(fd, max))
+end
+
 function meths:execute_buffer(buf)
 	local len = 0
 	if buf ~= nil then
@@ -209,19 +322,31 @@ function meths:reset()
 	self.hm_parser:reset()
 end
 
-local function create_parser(hm_parser, self)
+local BATCH = hm.options.BATCH
+
+local function create_parser(hm_parser, self, opts)
+	if not hm_parser then
+		-- BATCH can't be combined with STREAM_BODY/DISCARD_BODY.
+		return nil, "invalid parser options"
+	end
 	self.last_state = NONE
 	self.hm_parser = hm_parser
+	self.headers_tmp = {}
+	if opts and (opts % (BATCH * 2)) >= BATCH then
+		self.batch = true
+		self.batch_tmp = {}
+	end
 	return setmetatable(self, parser_mt)
 end
 
 module(...)
 
-function request(cbs)
-	return create_parser(hm.request(), cbs)
+-- `opts` are parser options from `http_message.options`.
+function request(cbs, opts)
+	return create_parser(hm.request(opts), cbs, opts)
 end
 
-function response(cbs)
-	return create_parser(hm.response(), cbs)
+function response(cbs, opts)
+	return create_parser(hm.response(opts), cbs, opts)
 end
 
@@ -19,18 +19,443 @@ BODY             = "HM_PARSER_STATE_BODY",
 MESSAGE_COMPLETE = "HM_PARSER_STATE_MESSAGE_COMPLETE",
 NEEDS_INPUT      = "HM_PARSER_STATE_NEEDS_INPUT",
 ERROR            = "HM_PARSER_STATE_ERROR",
+LIMIT            = "HM_PARSER_STATE_LIMIT",
 },
 
+export_definitions "limits" {
+NONE             = "HM_PARSER_LIMIT_NONE",
+URL              = "HM_PARSER_LIMIT_URL",
+HEADER_SIZE      = "HM_PARSER_LIMIT_HEADER_SIZE",
+HEADERS          = "HM_PARSER_LIMIT_HEADERS",
+BUFFER           = "HM_PARSER_LIMIT_BUFFER",
+BODY             = "HM_PARSER_LIMIT_BODY",
+},
+
+export_definitions "options" {
+NONE             = "HM_PARSER_OPT_NONE",
+FAST_SCAN        = "HM_PARSER_OPT_FAST_SCAN",
+WAIT_HEADERS     = "HM_PARSER_OPT_WAIT_HEADERS",
+STREAM_BODY      = "HM_PARSER_OPT_STREAM_BODY",
+DISCARD_BODY     = "HM_PARSER_OPT_DISCARD_BODY",
+BATCH            = "HM_PARSER_OPT_BATCH",
+SINGLE_ALLOC     = "HM_PARSER_OPT_SINGLE_ALLOC",
+TIMING           = "HM_PARSER_OPT_TIMING",
+},
+
+export_definitions "phases" {
+BEGIN            = "HM_PARSER_PHASE_BEGIN",
+HEADERS          = "HM_PARSER_PHASE_HEADERS",
+COMPLETE         = "HM_PARSER_PHASE_COMPLETE",
+},
+
+export_definitions "url_fields" {
+SCHEME           = "HM_URL_SCHEME",
+HOST             = "HM_URL_HOST",
+PORT             = "HM_URL_PORT",
+PATH             = "HM_URL_PATH",
+QUERY            = "HM_URL_QUERY",
+FRAGMENT         = "HM_URL_FRAGMENT",
+USERINFO         = "HM_URL_USERINFO",
+},
+
+-- flags returned by find_header_item()/get_header_items().
+export_definitions "header_item_flags" {
+QUOTED           = "HM_HEADER_ITEM_QUOTED",
+PARAMS           = "HM_HEADER_ITEM_PARAMS",
+ESCAPED          = "HM_HEADER_ITEM_ESCAPED",
+},
+
+export_definitions "events" {
+MESSAGE          = "HM_PARSER_EVENT_MESSAGE",
+EOF              = "HM_PARSER_EVENT_EOF",
+ERROR            = "HM_PARSER_EVENT_ERROR",
+UPGRADE          = "HM_PARSER_EVENT_UPGRADE",
+},
+
+-- negative errno values returned by read_fd/write_fd.
+export_definitions "errors" {
+EAGAIN           = "EAGAIN",
+ENOBUFS          = "ENOBUFS",
+ECONNRESET       = "ECONNRESET",
+},
+
+-- flags for HMParser:recv().
+export_definitions "recv_flags" {
+DONTWAIT         = "MSG_DONTWAIT",
+},
+
+-- parser memory is allocated with the Lua state's allocator.
+c_source "src" [[
+#include <sys/socket.h>
+
+#include "hm_alloc.h"
+#include "hm_date.h"
+#include "hm_url.h"
+#include "hm_form.h"
+#include "hm_header_value.h"
+
+typedef struct HMLuaAllocator {
+	HMAllocator base;
+	size_t      stepped;  /**< bytes allocated at the last GC step. */
+} HMLuaAllocator;
+
+/* when this many bytes have been allocated, do a GC step for them. */
+#define HM_LUA_GC_STEP (64 * 1024)
+
+static char hm_lua_allocator_key;
+
+/*
+ * Get the allocator for this Lua state.  Parser memory isn't counted by Lua's GC,
+ * so a GC step is done for the memory allocated since the last step when new objects
+ * are created and by hm_lua_gc_check().
+ */
+static HMAllocator *hm_lua_allocator(lua_State *L) {
+	HMLuaAllocator *allocator;
+	lua_Alloc alloc;
+	void *ud;
+
+	lua_pushlightuserdata(L, &hm_lua_allocator_key);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	allocator = (HMLuaAllocator *)lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	if(allocator == NULL) {
+		/* the allocator lives in the registry until the Lua state is closed. */
+		lua_pushlightuserdata(L, &hm_lua_allocator_key);
+		allocator = (HMLuaAllocator *)lua_newuserdata(L, sizeof(HMLuaAllocator));
+		alloc = lua_getallocf(L, &ud);
+		hm_allocator_init(&(allocator->base), (hm_alloc_f)alloc, ud);
+		allocator->stepped = 0;
+		lua_rawset(L, LUA_REGISTRYINDEX);
+	} else if(allocator->base.bytes > allocator->stepped + HM_LUA_GC_STEP) {
+		lua_gc(L, LUA_GCSTEP, (allocator->base.bytes - allocator->stepped) / 1024);
+		allocator->stepped = allocator->base.bytes;
+	} else if(allocator->base.bytes < allocator->stepped) {
+		allocator->stepped = allocator->base.bytes;
+	}
+	return &(allocator->base);
+}
+
+/*
+ * Called after methods that can grow buffers.  The allocator can't run the GC itself,
+ * it is also used from FFI calls which can't re-enter Lua.
+ */
+#define hm_lua_gc_check(L) ((void)hm_lua_allocator(L))
+
+/* fill the table at `idx` with the counters from `stats`. */
+static void hm_lua_stats_table(lua_State *L, int idx, HMParserStats *stats) {
+#define HM_LUA_STAT(name) \
+	lua_pushnumber(L, (lua_Number)stats->name); \
+	lua_setfield(L, idx, #name)
+	HM_LUA_STAT(bytes_parsed);
+	HM_LUA_STAT(execute_calls);
+	HM_LUA_STAT(fast_scans);
+	HM_LUA_STAT(pauses);
+	HM_LUA_STAT(array_grows);
+	HM_LUA_STAT(buffer_grows);
+	HM_LUA_STAT(bytes_copied);
+	HM_LUA_STAT(bytes_moved);
+	HM_LUA_STAT(header_id_hits);
+	HM_LUA_STAT(header_id_misses);
+#undef HM_LUA_STAT
+}
+
+/* headers decoded on the C stack by get_headers(), more use a tmp. userdata. */
+#define HM_LUA_HEADERS_MAX 32
+
+/* clear the array entries of the table at `idx`, starting at `n`. */
+static void hm_lua_clear_table(lua_State *L, int idx, int n) {
+	for(;; n++) {
+		lua_rawgeti(L, idx, n);
+		if(lua_isnil(L, -1)) break;
+		lua_pop(L, 1);
+		lua_pushnil(L);
+		lua_rawseti(L, idx, n);
+	}
+	lua_pop(L, 1);
+}
+
+static char hm_lua_anchors_key;
+
+/*
+ * Push the anchor table of the object at `idx`: values stored in it are kept alive
+ * until the object is collected.
+ */
+static void hm_lua_anchors(lua_State *L, int idx) {
+	if(idx < 0) idx = lua_gettop(L) + idx + 1;
+	lua_pushlightuserdata(L, &hm_lua_anchors_key);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	if(lua_isnil(L, -1)) {
+		/* weak keys, so the objects can be collected. */
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_newtable(L);
+		lua_pushliteral(L, "k");
+		lua_setfield(L, -2, "__mode");
+		lua_setmetatable(L, -2);
+		lua_pushlightuserdata(L, &hm_lua_anchors_key);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, LUA_REGISTRYINDEX);
+	}
+	lua_pushvalue(L, idx);
+	lua_rawget(L, -2);
+	if(lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_pushvalue(L, idx);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, -4);
+	}
+	lua_remove(L, -2);
+}
+
+/* header items decoded on the C stack, more use a tmp. userdata. */
+#define HM_LUA_ITEMS_MAX 32
+
+/* push the value of a header item, quoted values are unescaped. */
+static void hm_lua_item_value(lua_State *L, const char *value, HMHeaderItem *item) {
+	char tmp[256];
+	char *buf = tmp;
+	size_t len = item->value_len;
+
+	if(!(item->flags & HM_HEADER_ITEM_ESCAPED)) {
+		lua_pushlstring(L, value + item->value_off, len);
+		return;
+	}
+	if(len > sizeof(tmp)) {
+		buf = (char *)lua_newuserdata(L, len);
+	}
+	len = hm_header_value_unescape(value + item->value_off, len, buf);
+	lua_pushlstring(L, buf, len);
+	if(buf != tmp) {
+		lua_remove(L, -2);
+	}
+}
+
+/* push the value, q, params & flags of a header item. */
+static int hm_lua_push_item(lua_State *L, const char *value, HMHeaderItem *item) {
+	hm_lua_item_value(L, value, item);
+	lua_pushnumber(L, item->q / 1000.0);
+	lua_pushlstring(L, value + item->params_off, item->params_len);
+	lua_pushinteger(L, item->flags);
+	return 4;
+}
+
+/*
+ * fill the table at `idx` with the items of one header:
+ * { key1, value1, q1, params1, flags1, ... }, after `off` items.
+ * Returns the number of items.
+ */
+static uint32_t hm_lua_header_items(lua_State *L, int idx, uint32_t off, int id,
+		HMHeader *header) {
+	HMHeaderItem items[HM_LUA_ITEMS_MAX];
+	HMHeaderItem *list = items;
+	int count;
+	int n;
+
+	count = hm_header_value_parse(id, header->value, header->value_len, items,
+		HM_LUA_ITEMS_MAX);
+	if(count <= 0) return 0;
+	if(count > HM_LUA_ITEMS_MAX) {
+		/* large Cookie header. */
+		list = (HMHeaderItem *)lua_newuserdata(L, count * sizeof(HMHeaderItem));
+		hm_header_value_parse(id, header->value, header->value_len, list, count);
+	}
+	for(n = 0; n < count; n++) {
+		uint32_t i = (off + n) * 5;
+		HMHeaderItem *item = &(list[n]);
+		lua_pushlstring(L, header->value + item->key_off, item->key_len);
+		lua_rawseti(L, idx, i + 1);
+		hm_lua_push_item(L, header->value, item);
+		lua_rawseti(L, idx, i + 5);
+		lua_rawseti(L, idx, i + 4);
+		lua_rawseti(L, idx, i + 3);
+		lua_rawseti(L, idx, i + 2);
+	}
+	if(list != items) {
+		lua_pop(L, 1);
+	}
+	return count;
+}
+
+/* fill the table at `idx` with { offset, length } pairs of the url fields in HM_URL_*
+ * order, the offset is -1 for missing fields. */
+static void hm_lua_url_parts(lua_State *L, int idx, const HMUrl *u) {
+	int f;
+
+	for(f = 0; f < HM_URL_FIELDS; f++) {
+		if(hm_url_has_field(u, f)) {
+			lua_pushinteger(L, u->field[f].off);
+			lua_rawseti(L, idx, (f * 2) + 1);
+			lua_pushinteger(L, u->field[f].len);
+		} else {
+			lua_pushinteger(L, -1);
+			lua_rawseti(L, idx, (f * 2) + 1);
+			lua_pushinteger(L, 0);
+		}
+		lua_rawseti(L, idx, (f * 2) + 2);
+	}
+}
+
+/* push the decoded string of a form key/value. */
+static void hm_lua_form_string(lua_State *L, const char *str, size_t len, bool escaped) {
+	char tmp[256];
+	char *buf = tmp;
+
+	if(!escaped) {
+		lua_pushlstring(L, str, len);
+		return;
+	}
+	if(len > sizeof(tmp)) {
+		buf = (char *)lua_newuserdata(L, len);
+	}
+	len = hm_url_decode(str, len, buf, true);
+	lua_pushlstring(L, buf, len);
+	if(buf != tmp) {
+		lua_remove(L, -2);
+	}
+}
+
+/* fill the table at `idx` with the form's pairs: { key1, value1, ... }, then clear them. */
+static int hm_lua_form_pairs(lua_State *L, int idx, HMForm *form) {
+	HMFormPair pair;
+	uint32_t count = hm_form_count_pairs(form);
+	uint32_t n;
+
+	for(n = 0; n < count; n++) {
+		hm_form_get_pair(form, n, &pair);
+		hm_lua_form_string(L, pair.key, pair.key_len, (pair.flags & HM_FORM_KEY_ESCAPED));
+		lua_rawseti(L, idx, (n * 2) + 1);
+		hm_lua_form_string(L, pair.value, pair.value_len, (pair.flags & HM_FORM_VALUE_ESCAPED));
+		lua_rawseti(L, idx, (n * 2) + 2);
+	}
+	hm_form_clear_pairs(form);
+	return count;
+}
+]],
+
 subfiles {
 "hm_header_ids.nobj.lua",
+"src/hm_buffer.nobj.lua",
 "src/hm_parser.nobj.lua",
+"src/hm_message.nobj.lua",
+"src/hm_parser_set.nobj.lua",
+"src/hm_writer.nobj.lua",
+"src/hm_form.nobj.lua",
 },
 
 c_function "request" {
-	c_call "!HMParser *" "hm_parser_new_request" {},
+	var_in{ "uint32_t", "opts?" },
+	var_out{ "!HMParser *", "parser" },
+	c_source[[
+	${parser} = hm_parser_new_request_alloc(${opts}, hm_lua_allocator(L));
+]],
 },
 c_function "response" {
-	c_call "!HMParser *" "hm_parser_new_response" {},
+	var_in{ "uint32_t", "opts?" },
+	var_out{ "!HMParser *", "parser" },
+	c_source[[
+	${parser} = hm_parser_new_response_alloc(${opts}, hm_lua_allocator(L));
+]],
+},
+c_function "request_set" {
+	var_in{ "uint32_t", "opts?" },
+	var_out{ "!HMParserSet *", "set" },
+	c_source[[
+	${set} = hm_parser_set_new_request_alloc(${opts}, hm_lua_allocator(L));
+]],
+},
+c_function "response_set" {
+	var_in{ "uint32_t", "opts?" },
+	var_out{ "!HMParserSet *", "set" },
+	c_source[[
+	${set} = hm_parser_set_new_response_alloc(${opts}, hm_lua_allocator(L));
+]],
+},
+-- HTTP-dates (RFC 7231).
+c_function "date_now" {
+	var_out{ "const char *", "date", has_length = 1 },
+	c_source[[
+	${date} = hm_date_now(&(${date_len}));
+]],
+},
+c_function "date_format" {
+	var_in{ "double", "time" },
+	c_source[[
+	char buf[HM_DATE_LEN];
+	size_t len = hm_date_format((int64_t)${time}, buf);
+
+	if(len == 0) {
+		lua_pushnil(L);
+	} else {
+		lua_pushlstring(L, buf, len);
+	}
+	return 1;
+]],
+},
+-- returns seconds since the epoch or nil for invalid dates.
+c_function "date_parse" {
+	var_in{ "const char *", "date" },
+	c_source[[
+	int64_t t = hm_date_parse(${date}, ${date_len});
+
+	if(t < 0) {
+		lua_pushnil(L);
+	} else {
+		lua_pushnumber(L, (lua_Number)t);
+	}
+	return 1;
+]],
+},
+-- percent-decode a url component.
+c_function "url_decode" {
+	var_in{ "const char *", "str" },
+	var_in{ "bool", "plus_as_space?" },
+	c_source[[
+	char tmp[256];
+	char *buf = tmp;
+	size_t len;
+
+	if(${str_len} > sizeof(tmp)) {
+		buf = (char *)lua_newuserdata(L, ${str_len});
+	}
+	len = hm_url_decode(${str}, ${str_len}, buf, ${plus_as_space});
+	lua_pushlstring(L, buf, len);
+	return 1;
+]],
+},
+c_function "form" {
+	var_out{ "!HMForm *", "form" },
+	c_source[[
+	${form} = hm_form_new(hm_lua_allocator(L));
+]],
+},
+c_function "writer" {
+	var_out{ "!HMWriter *", "writer" },
+	c_source[[
+	${writer} = hm_writer_new(hm_lua_allocator(L));
+]],
+},
+-- bytes allocated for parsers, buffers & messages in this Lua state.
+c_function "memory_used" {
+	var_out{ "size_t", "bytes" },
+	c_source[[
+	${bytes} = hm_lua_allocator(L)->bytes;
+]],
+},
+-- fill `tbl` with the counters of all parsers, returns false if they are compiled out.
+c_function "stats" {
+	var_in{ "<any>", "tbl" },
+	var_out{ "bool", "enabled" },
+	c_source[[
+	HMParserStats stats;
+
+	luaL_checktype(L, ${tbl::idx}, LUA_TTABLE);
+	${enabled} = hm_parser_get_global_stats(&stats);
+	hm_lua_stats_table(L, ${tbl::idx}, &stats);
+]],
+},
+c_function "scan_impl" {
+	c_call "const char *" "hm_scan_impl" {},
 },
 }
 
@@ -0,0 +1,80 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdlib.h>
+
+#include "hm_alloc.h"
+
+static void *hm_default_alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+	(void)ud;
+	(void)osize;
+	if(nsize == 0) {
+		free(ptr);
+		return NULL;
+	}
+	return realloc(ptr, nsize);
+}
+
+static HMAllocator hm_default_allocator = { hm_default_alloc, NULL, 0 };
+
+/* add to a counter that is shared between threads. */
+#if defined(__GNUC__)
+#define hm_atomic_add(ptr, n) ((void)__sync_fetch_and_add(ptr, n))
+#elif defined(_MSC_VER)
+#include <windows.h>
+#ifdef _WIN64
+#define hm_atomic_add(ptr, n) ((void)InterlockedExchangeAdd64((LONG64 volatile *)(ptr), (LONG64)(n)))
+#else
+#define hm_atomic_add(ptr, n) ((void)InterlockedExchangeAdd((LONG volatile *)(ptr), (LONG)(n)))
+#endif
+#else
+/* no atomics, the counters are only exact when parsers are used from one thread. */
+#define hm_atomic_add(ptr, n) ((void)(*(ptr) += (n)))
+#endif
+
+/*
+ * bytes allocated by allocators other then the default one.  The default allocator is
+ * shared between threads, other allocators (one for each Lua state) are only used from
+ * one thread at a time.  So each allocation only needs one atomic update.
+ */
+static size_t hm_other_bytes = 0;
+
+void hm_allocator_init(HMAllocator *allocator, hm_alloc_f alloc, void *ud) {
+	allocator->alloc = alloc;
+	allocator->ud = ud;
+	allocator->bytes = 0;
+}
+
+HMAllocator *hm_allocator_default() {
+	return &hm_default_allocator;
+}
+
+void *hm_alloc_realloc(HMAllocator *allocator, void *ptr, size_t osize, size_t nsize) {
+	void *new_ptr;
+
+	if(allocator == NULL) {
+		allocator = &hm_default_allocator;
+	}
+	if(ptr == NULL) {
+		osize = 0;
+	}
+	new_ptr = allocator->alloc(allocator->ud, ptr, osize, nsize);
+	if(new_ptr == NULL && nsize > 0) {
+		/* failed, the old block is unchanged. */
+		return NULL;
+	}
+	if(allocator == &hm_default_allocator) {
+		hm_atomic_add(&(allocator->bytes), nsize - osize);
+	} else {
+		allocator->bytes += nsize - osize;
+		hm_atomic_add(&hm_other_bytes, nsize - osize);
+	}
+	return new_ptr;
+}
+
+size_t hm_alloc_total_bytes() {
+	return hm_default_allocator.bytes + hm_other_bytes;
+}
+
@@ -0,0 +1,62 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+#if !defined(__HM_ALLOC_H__)
+#define __HM_ALLOC_H__
+
+#include "lcommon.h"
+
+#include <stddef.h>
+
+/**
+ * Allocation function, same semantics as lua_Alloc:
+ * `nsize == 0` frees `ptr` (returns NULL), otherwise `ptr` (NULL or a block of `osize`
+ * bytes) is resized to `nsize` bytes.
+ */
+typedef void *(*hm_alloc_f)(void *ud, void *ptr, size_t osize, size_t nsize);
+
+typedef struct HMAllocator HMAllocator;
+
+/**
+ * Allocator used for the memory of parsers, buffers, slices and messages.
+ *
+ * Objects keep a pointer to the allocator they where created with, so the
+ * allocator must outlive all of them.  Only the default allocator can be used from
+ * more then one thread at a time, the byte counter of other allocators isn't atomic.
+ */
+struct HMAllocator {
+	hm_alloc_f  alloc;
+	void        *ud;
+	size_t      bytes;    /**< bytes currently allocated with this allocator. */
+};
+
+/**
+ * Initialize an allocator with a lua_Alloc style function.
+ */
+L_LIB_API void hm_allocator_init(HMAllocator *allocator, hm_alloc_f alloc, void *ud);
+
+/**
+ * The default allocator, uses realloc()/free().
+ */
+L_LIB_API HMAllocator *hm_allocator_default();
+
+/**
+ * Allocate/resize/free a block of memory, a NULL `allocator` uses the default allocator.
+ *
+ * @return the new block, or NULL when freeing or on allocation failure (`ptr` is
+ * still valid if resizing failed).
+ */
+L_LIB_API void *hm_alloc_realloc(HMAllocator *allocator, void *ptr, size_t osize, size_t nsize);
+
+#define hm_alloc_malloc(allocator, size) hm_alloc_realloc(allocator, NULL, 0, size)
+
+#define hm_alloc_free(allocator, ptr, size) hm_alloc_realloc(allocator, ptr, size, 0)
+
+/**
+ * Total bytes currently allocated with all allocators.
+ */
+L_LIB_API size_t hm_alloc_total_bytes();
+
+#endif /* __HM_ALLOC_H__ */
+
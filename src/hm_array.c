@@ -7,20 +7,24 @@
 #include <stdlib.h>
 #include <string.h>
 
-void *hm_array_resize_internal(void *ary_p, size_t elem_size, size_t capacity) {
+void *hm_array_resize_internal(HMAllocator *allocator, void *ary_p, size_t elem_size,
+		size_t capacity) {
 	HMArray *ary = NULL;
+	size_t old_size = 0;
 
 	/* if new capacity is zero just free the array. */
 	if(capacity == 0) {
-		hm_array_free_internal(ary_p);
+		hm_array_free_internal(allocator, ary_p, elem_size);
 		return NULL;
 	}
 	if(ary_p) {
 		ary = hm_array_from_void(ary_p);
+		old_size = sizeof(HMArray) + (elem_size * ary->capacity);
 	}
 
 	/* resize old array or allocate new array. */
-	ary = (HMArray *)realloc(ary, (sizeof(HMArray) + (elem_size * capacity)));
+	ary = (HMArray *)hm_alloc_realloc(allocator, ary, old_size,
+		(sizeof(HMArray) + (elem_size * capacity)));
 	if(ary != NULL) {
 		if(ary_p == NULL) {
 			/* new array. */
@@ -33,13 +37,14 @@ void *hm_array_resize_internal(void *ary_p, size_t elem_size, size_t capacity) {
 	return NULL;
 }
 
-void hm_array_free_internal(void *ary_p) {
+void hm_array_free_internal(HMAllocator *allocator, void *ary_p, size_t elem_size) {
 	HMArray *ary;
+	size_t size;
 	if(ary_p) {
 		ary = hm_array_from_void(ary_p);
+		size = sizeof(HMArray) + (elem_size * ary->capacity);
 		ary->capacity = 0xDEAD;
 		ary->count = 0;
-		free(ary);
+		hm_alloc_free(allocator, ary, size);
 	}
 }
-
@@ -7,6 +7,8 @@
 
 #include "lcommon.h"
 
+#include "hm_alloc.h"
+
 typedef struct HMArray HMArray;
 
 struct HMArray {
@@ -18,9 +20,10 @@ struct HMArray {
 
 #define hm_array_to_void(ary) ((void *)((ary) + 1))
 
-L_LIB_API void *hm_array_resize_internal(void *ary_p, size_t elem_size, size_t capacity);
+L_LIB_API void *hm_array_resize_internal(HMAllocator *allocator, void *ary_p, size_t elem_size,
+	size_t capacity);
 
-L_LIB_API void hm_array_free_internal(void *ary_p);
+L_LIB_API void hm_array_free_internal(HMAllocator *allocator, void *ary_p, size_t elem_size);
 
 #define hm_array_capacity(ary_p) \
 	(hm_array_from_void(ary_p)->capacity)
@@ -31,14 +34,18 @@ L_LIB_API void hm_array_free_internal(void *ary_p);
 #define hm_array_set_count(ary_p, _count) \
 	(hm_array_from_void(ary_p)->count) = (_count)
 
-#define hm_array_resize(ary_p, capacity) \
-	(ary_p) = (typeof(ary_p)) hm_array_resize_internal(ary_p, sizeof(ary_p[0]), capacity)
+#define hm_array_resize(allocator, ary_p, capacity) \
+	(ary_p) = (typeof(ary_p)) hm_array_resize_internal(allocator, ary_p, sizeof(ary_p[0]), capacity)
 
-#define hm_array_new(ary_p, capacity) \
-	(ary_p) = (typeof(ary_p)) hm_array_resize_internal(NULL, sizeof(ary_p[0]), capacity)
+#define hm_array_new(allocator, ary_p, capacity) \
+	(ary_p) = (typeof(ary_p)) hm_array_resize_internal(allocator, NULL, sizeof(ary_p[0]), capacity)
 
-#define hm_array_free(ary_p) do { \
-	hm_array_free_internal(ary_p); (ary_p) = NULL; \
+#define hm_array_free(allocator, ary_p) do { \
+	hm_array_free_internal(allocator, ary_p, sizeof(ary_p[0])); (ary_p) = NULL; \
 } while(0)
 
+/* bytes allocated for an array. */
+#define hm_array_size(ary_p) \
+	(sizeof(HMArray) + (sizeof(ary_p[0]) * hm_array_capacity(ary_p)))
+
 #endif /* __HM_ARRAY_H__ */
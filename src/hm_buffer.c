@@ -6,29 +6,121 @@
 #include "hm_buffer.h"
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#ifdef __WINDOWS__
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#define hm_buffer_size(capacity) (sizeof(HMBuffer) + (sizeof(uint8_t) * (capacity)))
+
+HMBuffer *hm_buffer_new_alloc(HMAllocator *allocator, size_t capacity) {
+	HMBuffer *buf;
+
+	if(allocator == NULL) {
+		allocator = hm_allocator_default();
+	}
+	buf = (HMBuffer *)hm_alloc_malloc(allocator, hm_buffer_size(capacity));
+	if(buf != NULL) {
+		buf->refcount = 1;
+		buf->capacity = capacity;
+		buf->allocator = allocator;
+	}
+	return buf;
+}
 
 HMBuffer *hm_buffer_resize(HMBuffer *buf, size_t capacity) {
-	size_t new_cap;
+	HMBuffer *new_buf;
 
+	if(buf == NULL) {
+		return (capacity > 0) ? hm_buffer_new_alloc(NULL, capacity) : NULL;
+	}
 	/* if new capacity is zero just free the buffer. */
 	if(capacity == 0) {
-		free(buf);
+		hm_buffer_free(buf);
 		return NULL;
 	}
+	/* shared buffers can't be moved. */
+	assert(!hm_buffer_is_shared(buf));
 
-	new_cap = (sizeof(HMBuffer) + (sizeof(uint8_t) * capacity));
-	/* resize old buffer or allocate new buffer. */
-	buf = (HMBuffer *)realloc(buf, new_cap);
-	if(buf != NULL) {
-		buf->capacity = capacity;
+	/* resize old buffer. */
+	new_buf = (HMBuffer *)hm_alloc_realloc(buf->allocator, buf,
+		hm_buffer_size(buf->capacity), hm_buffer_size(capacity));
+	if(new_buf != NULL) {
+		new_buf->capacity = capacity;
 	}
-	return buf;
+	return new_buf;
 }
 
 void hm_buffer_free(HMBuffer *buf) {
 	if(buf) {
+		size_t size = hm_buffer_size(buf->capacity);
 		buf->capacity = 0xDEADBEEF;
-		free(buf);
+		hm_alloc_free(buf->allocator, buf, size);
+	}
+}
+
+HMBuffer *hm_buffer_ref(HMBuffer *buf) {
+	buf->refcount++;
+	return buf;
+}
+
+void hm_buffer_unref(HMBuffer *buf) {
+	if(buf) {
+		assert(buf->refcount > 0);
+		if(--buf->refcount == 0) {
+			hm_buffer_free(buf);
+		}
+	}
+}
+
+HMSlice *hm_slice_new(HMBuffer *buf, size_t off, size_t len) {
+	HMSlice *slice;
+
+	assert((off + len) <= hm_buffer_capacity(buf));
+	slice = (HMSlice *)hm_alloc_malloc(buf->allocator, sizeof(HMSlice));
+	if(slice != NULL) {
+		slice->buf = hm_buffer_ref(buf);
+		slice->off = off;
+		slice->len = len;
+	}
+	return slice;
+}
+
+void hm_slice_free(HMSlice *slice) {
+	if(slice) {
+		HMAllocator *allocator = slice->buf->allocator;
+		hm_buffer_unref(slice->buf);
+		slice->buf = NULL;
+		hm_alloc_free(allocator, slice, sizeof(HMSlice));
+	}
+}
+
+const char *hm_slice_data(HMSlice *slice, size_t *len) {
+	assert(len != NULL);
+	*len = slice->len;
+	return (const char *)hm_buffer_data(slice->buf) + slice->off;
+}
+
+size_t hm_slice_len(HMSlice *slice) {
+	return slice->len;
+}
+
+ssize_t hm_slice_write_fd(HMSlice *slice, int fd, size_t off) {
+	const char *data;
+	ssize_t rc;
+
+	if(off >= slice->len) {
+		return 0;
+	}
+	data = (const char *)hm_buffer_data(slice->buf) + slice->off + off;
+	do {
+		rc = write(fd, data, slice->len - off);
+	} while(rc < 0 && errno == EINTR);
+	if(rc < 0) {
+		return -errno;
 	}
+	return rc;
 }
 
@@ -7,10 +7,16 @@
 
 #include "lcommon.h"
 
+#include "hm_alloc.h"
+
+#include <sys/types.h>
+
 typedef struct HMBuffer HMBuffer;
 
 struct HMBuffer {
+	uint32_t refcount; /**< number of owners (parser, slices, messages). */
 	size_t  capacity; /**< how many byte the `data` buffer can hold. */
+	HMAllocator *allocator; /**< allocator for the buffer and it's slices. */
 	uint8_t data[];   /**< Memory for the buffer is allocated after the 'HMBuffer' structure. */
 };
 
@@ -18,10 +24,51 @@ struct HMBuffer {
 
 #define hm_buffer_capacity(buf) ((buf)->capacity)
 
+/* A shared buffer must not be resized or have it's data moved. */
+#define hm_buffer_is_shared(buf) ((buf)->refcount > 1)
+
 L_LIB_API HMBuffer *hm_buffer_resize(HMBuffer *buf, size_t capacity);
 
-#define hm_buffer_new(capacity) hm_buffer_resize(NULL, capacity)
+#define hm_buffer_new(capacity) hm_buffer_new_alloc(NULL, capacity)
+
+/**
+ * Allocate a new buffer with `allocator` (NULL for the default allocator).
+ */
+L_LIB_API HMBuffer *hm_buffer_new_alloc(HMAllocator *allocator, size_t capacity);
 
 L_LIB_API void hm_buffer_free(HMBuffer *buf);
 
+L_LIB_API HMBuffer *hm_buffer_ref(HMBuffer *buf);
+
+L_LIB_API void hm_buffer_unref(HMBuffer *buf);
+
+typedef struct HMSlice HMSlice;
+
+/**
+ * Read-only view of some bytes in a shared buffer.
+ *
+ * The slice holds a reference to the buffer, so the bytes stay valid after
+ * the parser has moved on to the next message.
+ */
+struct HMSlice {
+	HMBuffer *buf;   /**< referenced buffer. */
+	size_t   off;    /**< offset of the slice in the buffer. */
+	size_t   len;    /**< length of the slice. */
+};
+
+L_LIB_API HMSlice *hm_slice_new(HMBuffer *buf, size_t off, size_t len);
+
+L_LIB_API void hm_slice_free(HMSlice *slice);
+
+L_LIB_API const char *hm_slice_data(HMSlice *slice, size_t *len);
+
+L_LIB_API size_t hm_slice_len(HMSlice *slice);
+
+/**
+ * Write the slice to a file descriptor, starting at offset `off`.
+ *
+ * @return bytes written or negative errno.
+ */
+L_LIB_API ssize_t hm_slice_write_fd(HMSlice *slice, int fd, size_t off);
+
 #endif /* __HM_BUFFER_H__ */
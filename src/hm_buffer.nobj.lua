@@ -0,0 +1,58 @@
+-- Copyright (c) 2011 by Robert G. Jakabosky <bobby@sharedrealm.com>
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+
+object "HMSlice" {
+	include"hm_buffer.h",
+	ffi_cdef[[
+typedef struct HMBuffer HMBuffer;
+struct HMBuffer {
+	uint32_t refcount;
+	size_t   capacity;
+	void     *allocator;
+	uint8_t  data[?];
+};
+
+struct HMSlice {
+	HMBuffer *buf;
+	size_t   off;
+	size_t   len;
+};
+
+]],
+	destructor {
+		c_method_call "void" "hm_slice_free" {},
+	},
+
+	method "len" {
+		c_method_call "size_t" "hm_slice_len" {},
+	},
+
+	method "data" {
+		c_method_call { "const char *", "data", has_length = 1 } "hm_slice_data"
+			{ "size_t", "&#data" },
+	},
+
+	-- returns bytes written or negative errno.
+	method "write_fd" {
+		c_method_call "ssize_t" "hm_slice_write_fd" { "int", "fd", "size_t", "off?" },
+	},
+}
+
@@ -0,0 +1,256 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <string.h>
+#include <time.h>
+
+#include "hm_date.h"
+
+#ifdef __WINDOWS__
+#define HM_THREAD_LOCAL __declspec(thread)
+#else
+#define HM_THREAD_LOCAL __thread
+#endif
+
+static const char hm_wday_names[7][4] = {
+	"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+};
+
+static const char hm_month_names[12][4] = {
+	"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+/* lower-case 3 letter name packed into an int. */
+#define HM_NAME3(a, b, c) \
+	((((uint32_t)(a) | 0x20) << 16) | (((uint32_t)(b) | 0x20) << 8) | ((uint32_t)(c) | 0x20))
+
+/* days since 1970-01-01 (from Howard Hinnant's days_from_civil). */
+static int64_t hm_days_from_civil(int64_t y, uint32_t m, uint32_t d) {
+	int64_t era;
+	uint32_t yoe, doy, doe;
+
+	y -= (m <= 2);
+	era = ((y >= 0) ? y : y - 399) / 400;
+	yoe = (uint32_t)(y - (era * 400));
+	doy = ((153 * (m + ((m > 2) ? -3 : 9))) + 2) / 5 + d - 1;
+	doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+	return (era * 146097) + doe - 719468;
+}
+
+static void hm_civil_from_days(int64_t z, int64_t *year, uint32_t *month, uint32_t *day) {
+	int64_t era;
+	uint32_t doe, yoe, doy, mp;
+
+	z += 719468;
+	era = ((z >= 0) ? z : z - 146096) / 146097;
+	doe = (uint32_t)(z - (era * 146097));
+	yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;
+	doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));
+	mp = ((5 * doy) + 2) / 153;
+	*day = doy - (((153 * mp) + 2) / 5) + 1;
+	*month = (mp < 10) ? mp + 3 : mp - 9;
+	*year = yoe + (era * 400) + (*month <= 2);
+}
+
+static inline void hm_put2(char *p, uint32_t val) {
+	p[0] = '0' + (val / 10);
+	p[1] = '0' + (val % 10);
+}
+
+size_t hm_date_format(int64_t t, char *buf) {
+	int64_t days;
+	int64_t year;
+	uint32_t month, day;
+	uint32_t secs;
+
+	if(t < 0) {
+		return 0;
+	}
+	days = t / 86400;
+	secs = (uint32_t)(t % 86400);
+	hm_civil_from_days(days, &year, &month, &day);
+	if(year > 9999) {
+		return 0;
+	}
+	/* "Sun, 06 Nov 1994 08:49:37 GMT" */
+	memcpy(buf, hm_wday_names[(days + 4) % 7], 3);
+	buf[3] = ',';
+	buf[4] = ' ';
+	hm_put2(buf + 5, day);
+	buf[7] = ' ';
+	memcpy(buf + 8, hm_month_names[month - 1], 3);
+	buf[11] = ' ';
+	hm_put2(buf + 12, (uint32_t)(year / 100));
+	hm_put2(buf + 14, (uint32_t)(year % 100));
+	buf[16] = ' ';
+	hm_put2(buf + 17, secs / 3600);
+	buf[19] = ':';
+	hm_put2(buf + 20, (secs / 60) % 60);
+	buf[22] = ':';
+	hm_put2(buf + 23, secs % 60);
+	memcpy(buf + 25, " GMT", 4);
+	return HM_DATE_LEN;
+}
+
+typedef struct HMDateCache {
+	int64_t   sec;
+	char      date[HM_DATE_LEN + 1];
+} HMDateCache;
+
+static HM_THREAD_LOCAL HMDateCache hm_date_cache = { -1, "" };
+
+const char *hm_date_now(size_t *len) {
+	int64_t now = (int64_t)time(NULL);
+
+	if(now != hm_date_cache.sec) {
+		hm_date_format(now, hm_date_cache.date);
+		hm_date_cache.date[HM_DATE_LEN] = '\0';
+		hm_date_cache.sec = now;
+	}
+	*len = HM_DATE_LEN;
+	return hm_date_cache.date;
+}
+
+/* parse exactly `n` digits, returns -1 if there are less. */
+static int hm_date_digits(const char **pp, const char *end, int n) {
+	const char *p = *pp;
+	int val = 0;
+
+	if(end - p < n) {
+		return -1;
+	}
+	for(; n > 0; n--, p++) {
+		if(*p < '0' || *p > '9') {
+			return -1;
+		}
+		val = (val * 10) + (*p - '0');
+	}
+	*pp = p;
+	return val;
+}
+
+static bool hm_date_char(const char **pp, const char *end, char c) {
+	if(*pp < end && **pp == c) {
+		(*pp)++;
+		return true;
+	}
+	return false;
+}
+
+/* 3 letter month name, returns 1-12 or -1. */
+static int hm_date_month(const char **pp, const char *end) {
+	const char *p = *pp;
+	int month;
+
+	if(end - p < 3) {
+		return -1;
+	}
+	switch(HM_NAME3(p[0], p[1], p[2])) {
+	case HM_NAME3('j','a','n'): month = 1; break;
+	case HM_NAME3('f','e','b'): month = 2; break;
+	case HM_NAME3('m','a','r'): month = 3; break;
+	case HM_NAME3('a','p','r'): month = 4; break;
+	case HM_NAME3('m','a','y'): month = 5; break;
+	case HM_NAME3('j','u','n'): month = 6; break;
+	case HM_NAME3('j','u','l'): month = 7; break;
+	case HM_NAME3('a','u','g'): month = 8; break;
+	case HM_NAME3('s','e','p'): month = 9; break;
+	case HM_NAME3('o','c','t'): month = 10; break;
+	case HM_NAME3('n','o','v'): month = 11; break;
+	case HM_NAME3('d','e','c'): month = 12; break;
+	default:
+		return -1;
+	}
+	*pp = p + 3;
+	return month;
+}
+
+/* "HH:MM:SS" */
+static int hm_date_time(const char **pp, const char *end) {
+	int hour, min, sec;
+
+	hour = hm_date_digits(pp, end, 2);
+	if(hour < 0 || hour > 23 || !hm_date_char(pp, end, ':')) return -1;
+	min = hm_date_digits(pp, end, 2);
+	if(min < 0 || min > 59 || !hm_date_char(pp, end, ':')) return -1;
+	sec = hm_date_digits(pp, end, 2);
+	/* allow leap seconds. */
+	if(sec < 0 || sec > 60) return -1;
+	return (hour * 3600) + (min * 60) + sec;
+}
+
+static bool hm_date_gmt(const char **pp, const char *end) {
+	const char *p = *pp;
+
+	if(end - p < 4 || p[0] != ' ' || HM_NAME3(p[1], p[2], p[3]) != HM_NAME3('g','m','t')) {
+		return false;
+	}
+	*pp = p + 4;
+	return true;
+}
+
+int64_t hm_date_parse(const char *str, size_t len) {
+	static const uint8_t mdays[12] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	const char *p = str;
+	const char *end = str + len;
+	const char *name;
+	int year, month, day, secs;
+
+	/* trim whitespace. */
+	while(p < end && (*p == ' ' || *p == '\t')) p++;
+	while(end > p && (end[-1] == ' ' || end[-1] == '\t')) end--;
+	/* day name. */
+	name = p;
+	while(p < end && ((*p | 0x20) >= 'a' && (*p | 0x20) <= 'z')) p++;
+	if(p - name < 3) {
+		return -1;
+	}
+	if(hm_date_char(&p, end, ',')) {
+		if(!hm_date_char(&p, end, ' ')) return -1;
+		day = hm_date_digits(&p, end, 2);
+		if((p - name) == 7) {
+			/* IMF-fixdate: "Sun, 06 Nov 1994 08:49:37 GMT" */
+			if(!hm_date_char(&p, end, ' ')) return -1;
+			month = hm_date_month(&p, end);
+			if(!hm_date_char(&p, end, ' ')) return -1;
+			year = hm_date_digits(&p, end, 4);
+		} else {
+			/* RFC 850: "Sunday, 06-Nov-94 08:49:37 GMT" */
+			if(!hm_date_char(&p, end, '-')) return -1;
+			month = hm_date_month(&p, end);
+			if(!hm_date_char(&p, end, '-')) return -1;
+			year = hm_date_digits(&p, end, 2);
+			if(year >= 0) {
+				year += (year < 70) ? 2000 : 1900;
+			}
+		}
+		if(!hm_date_char(&p, end, ' ')) return -1;
+		secs = hm_date_time(&p, end);
+		if(!hm_date_gmt(&p, end)) return -1;
+	} else if((p - name) == 3 && hm_date_char(&p, end, ' ')) {
+		/* asctime: "Sun Nov  6 08:49:37 1994" */
+		month = hm_date_month(&p, end);
+		if(!hm_date_char(&p, end, ' ')) return -1;
+		if(hm_date_char(&p, end, ' ')) {
+			day = hm_date_digits(&p, end, 1);
+		} else {
+			day = hm_date_digits(&p, end, 2);
+		}
+		if(!hm_date_char(&p, end, ' ')) return -1;
+		secs = hm_date_time(&p, end);
+		if(!hm_date_char(&p, end, ' ')) return -1;
+		year = hm_date_digits(&p, end, 4);
+	} else {
+		return -1;
+	}
+	if(p != end || year < 1970 || month < 0 || day < 1 || day > mdays[month - 1] || secs < 0) {
+		return -1;
+	}
+	if(month == 2 && day == 29 && ((year % 4) != 0 || ((year % 100) == 0 && (year % 400) != 0))) {
+		return -1;
+	}
+	return (hm_days_from_civil(year, month, day) * 86400) + secs;
+}
+
@@ -0,0 +1,53 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+#if !defined(__HM_DATE_H__)
+#define __HM_DATE_H__
+
+#include "lcommon.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* length of a formatted HTTP-date: "Sun, 06 Nov 1994 08:49:37 GMT" */
+#define HM_DATE_LEN                       29
+
+/**
+ * Format a Unix timestamp as an IMF-fixdate (RFC 7231).
+ *
+ * @param t seconds since 1970-01-01 00:00:00 UTC.
+ * @param buf output buffer of at least HM_DATE_LEN bytes (not nul terminated).
+ * @return HM_DATE_LEN, or 0 if the year is outside 1970-9999.
+ */
+L_LIB_API size_t hm_date_format(int64_t t, char *buf);
+
+/**
+ * Current time as an IMF-fixdate, for the Date header.
+ *
+ * The date is only formatted once a second, the returned buffer is shared by all
+ * parsers & writers in the thread and is overwritten when the second changes.
+ *
+ * @param len returns HM_DATE_LEN.
+ * @return nul terminated date.
+ */
+L_LIB_API const char *hm_date_now(size_t *len);
+
+/**
+ * Parse a HTTP-date in any of the three formats from RFC 7231:
+ *
+ *   IMF-fixdate: "Sun, 06 Nov 1994 08:49:37 GMT"
+ *   RFC 850:     "Sunday, 06-Nov-94 08:49:37 GMT"
+ *   asctime:     "Sun Nov  6 08:49:37 1994"
+ *
+ * The day name is not checked against the date.  Two digit RFC 850 years below 70
+ * are in 20xx.
+ *
+ * @param str date, like a header value from hm_parser_get_header().
+ * @param len length of `str`.
+ * @return seconds since 1970-01-01 00:00:00 UTC, or -1 for invalid dates.
+ */
+L_LIB_API int64_t hm_date_parse(const char *str, size_t len);
+
+#endif /* __HM_DATE_H__ */
+
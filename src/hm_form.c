@@ -0,0 +1,267 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hm_form.h"
+#include "hm_scan.h"
+
+/* initial sizes, both grow by doubling. */
+#define HM_FORM_PAIRS           16
+#define HM_FORM_CARRY_SIZE      256
+
+typedef struct HMFormPiece HMFormPiece;
+
+struct HMFormPiece {
+	const char  *data;      /**< fed data, NULL for pairs in the carry buffer. */
+	hm_len_t    key_off;
+	hm_len_t    key_len;
+	hm_len_t    value_off;
+	hm_len_t    value_len;
+	uint32_t    flags;
+};
+
+struct HMForm {
+	HMAllocator *allocator;
+	HMFormPiece *pairs;
+	uint32_t    count;
+	uint32_t    capacity;
+	char        *carry;     /**< pairs split between pieces & the incomplete pair. */
+	size_t      carry_len;
+	size_t      carry_cap;
+	size_t      tail_off;   /**< start of the incomplete pair in `carry`. */
+};
+
+HMForm *hm_form_new(HMAllocator *allocator) {
+	HMForm *form;
+
+	if(allocator == NULL) {
+		allocator = hm_allocator_default();
+	}
+	form = (HMForm *)hm_alloc_malloc(allocator, sizeof(HMForm));
+	if(form == NULL) {
+		return NULL;
+	}
+	memset(form, 0, sizeof(HMForm));
+	form->allocator = allocator;
+	return form;
+}
+
+void hm_form_free(HMForm *form) {
+	hm_alloc_free(form->allocator, form->pairs, sizeof(HMFormPiece) * form->capacity);
+	hm_alloc_free(form->allocator, form->carry, form->carry_cap);
+	hm_alloc_free(form->allocator, form, sizeof(HMForm));
+}
+
+void hm_form_reset(HMForm *form) {
+	form->count = 0;
+	form->carry_len = 0;
+	form->tail_off = 0;
+}
+
+void hm_form_clear_pairs(HMForm *form) {
+	size_t tail_len = form->carry_len - form->tail_off;
+
+	/* only the incomplete pair is still needed. */
+	if(form->tail_off > 0) {
+		memmove(form->carry, form->carry + form->tail_off, tail_len);
+		form->carry_len = tail_len;
+		form->tail_off = 0;
+	}
+	form->count = 0;
+}
+
+static bool hm_form_reserve_carry(HMForm *form, size_t len) {
+	size_t need = form->carry_len + len;
+
+	if(need > form->carry_cap) {
+		size_t cap = (form->carry_cap > 0) ? form->carry_cap : HM_FORM_CARRY_SIZE;
+		char *carry;
+		while(cap < need) {
+			cap *= 2;
+		}
+		carry = (char *)hm_alloc_realloc(form->allocator, form->carry, form->carry_cap, cap);
+		if(carry == NULL) {
+			return false;
+		}
+		form->carry = carry;
+		form->carry_cap = cap;
+	}
+	return true;
+}
+
+static void hm_form_append_carry(HMForm *form, const char *data, size_t len) {
+	if(len > 0) {
+		memcpy(form->carry + form->carry_len, data, len);
+		form->carry_len += len;
+	}
+}
+
+/* add the pair in [p, end), `base` is NULL for pairs in the carry buffer. */
+static int hm_form_add_pair(HMForm *form, const char *base, const char *p, const char *end) {
+	const char *eq;
+	HMFormPiece *pair;
+
+	if(form->count >= form->capacity) {
+		uint32_t capacity = (form->capacity > 0) ? form->capacity * 2 : HM_FORM_PAIRS;
+		HMFormPiece *pairs;
+		pairs = (HMFormPiece *)hm_alloc_realloc(form->allocator, form->pairs,
+			sizeof(HMFormPiece) * form->capacity, sizeof(HMFormPiece) * capacity);
+		if(pairs == NULL) {
+			return -1;
+		}
+		form->pairs = pairs;
+		form->capacity = capacity;
+	}
+	pair = &(form->pairs[form->count++]);
+	pair->data = base;
+	if(base == NULL) {
+		base = form->carry;
+	}
+	pair->flags = 0;
+	eq = (const char *)memchr(p, '=', end - p);
+	if(eq == NULL) {
+		eq = end;
+		pair->value_off = end - base;
+		pair->value_len = 0;
+	} else {
+		pair->value_off = (eq + 1) - base;
+		pair->value_len = end - (eq + 1);
+		if(hm_scan_escape(eq + 1, end, 1) != end) {
+			pair->flags |= HM_FORM_VALUE_ESCAPED;
+		}
+	}
+	pair->key_off = p - base;
+	pair->key_len = eq - p;
+	if(hm_scan_escape(p, eq, 1) != eq) {
+		pair->flags |= HM_FORM_KEY_ESCAPED;
+	}
+	return 0;
+}
+
+/* add all '&' separated pairs in [p, end), empty pairs are skipped. */
+static int hm_form_add_pairs(HMForm *form, const char *base, const char *p, const char *end) {
+	const char *amp;
+
+	while(p < end) {
+		amp = (const char *)memchr(p, '&', end - p);
+		if(amp == NULL) {
+			amp = end;
+		}
+		if(amp > p && hm_form_add_pair(form, base, p, amp) != 0) {
+			return -1;
+		}
+		p = amp + 1;
+	}
+	return 0;
+}
+
+int hm_form_feed(HMForm *form, const char *data, size_t len, bool last) {
+	const char *p = data;
+	const char *end = data + len;
+	const char *tail = end;
+	const char *first_end;
+	uint32_t count = form->count;
+
+	if(!last) {
+		/* the pair after the last '&' might continue in the next piece. */
+		while(tail > p && tail[-1] != '&') tail--;
+	}
+	if(form->tail_off < form->carry_len) {
+		/* complete the pair from the last piece. */
+		first_end = (tail > p) ? (const char *)memchr(p, '&', tail - p) : NULL;
+		if(first_end == NULL) {
+			first_end = tail;
+			if(!last) {
+				/* still not complete. */
+				if(!hm_form_reserve_carry(form, len)) return -1;
+				hm_form_append_carry(form, data, len);
+				return 0;
+			}
+		}
+		if(!hm_form_reserve_carry(form, (first_end - p) + (end - tail))) return -1;
+		hm_form_append_carry(form, p, first_end - p);
+		if(hm_form_add_pair(form, NULL, form->carry + form->tail_off,
+				form->carry + form->carry_len) != 0) {
+			return -1;
+		}
+		form->tail_off = form->carry_len;
+		p = first_end;
+	} else if(tail < end && !hm_form_reserve_carry(form, end - tail)) {
+		return -1;
+	}
+	if(hm_form_add_pairs(form, data, p, tail) != 0) {
+		return -1;
+	}
+	/* keep the incomplete pair. */
+	hm_form_append_carry(form, tail, end - tail);
+	return form->count - count;
+}
+
+int hm_form_feed_query(HMForm *form, HMParser *hm_parser) {
+	const char *url;
+	size_t len;
+	HMUrl u;
+
+	url = hm_parser_get_url(hm_parser, &len);
+	if(url == NULL || hm_parser_get_url_parts(hm_parser, &u) != 0 ||
+			!hm_url_has_field(&u, HM_URL_QUERY)) {
+		return 0;
+	}
+	return hm_form_feed(form, url + u.field[HM_URL_QUERY].off, u.field[HM_URL_QUERY].len, true);
+}
+
+int hm_form_feed_body(HMForm *form, HMParser *hm_parser, bool last) {
+	const char *data;
+	size_t len;
+	uint32_t count = form->count;
+
+	while((data = hm_parser_next_body(hm_parser, &len)) != NULL) {
+		if(hm_form_feed(form, data, len, false) < 0) {
+			return -1;
+		}
+	}
+	if(last && hm_form_feed(form, NULL, 0, true) < 0) {
+		return -1;
+	}
+	return form->count - count;
+}
+
+uint32_t hm_form_count_pairs(HMForm *form) {
+	return form->count;
+}
+
+static inline void hm_form_decode_pair(HMForm *form, HMFormPiece *piece, HMFormPair *pair) {
+	const char *base = (piece->data != NULL) ? piece->data : form->carry;
+
+	pair->key = base + piece->key_off;
+	pair->key_len = piece->key_len;
+	pair->value = base + piece->value_off;
+	pair->value_len = piece->value_len;
+	pair->flags = piece->flags;
+}
+
+bool hm_form_get_pair(HMForm *form, uint32_t idx, HMFormPair *pair) {
+	if(idx >= form->count) {
+		return false;
+	}
+	hm_form_decode_pair(form, form->pairs + idx, pair);
+	return true;
+}
+
+uint32_t hm_form_get_pairs(HMForm *form, HMFormPair *pairs, uint32_t max) {
+	uint32_t count = form->count;
+	uint32_t idx;
+
+	if(count > max) {
+		count = max;
+	}
+	for(idx = 0; idx < count; idx++) {
+		hm_form_decode_pair(form, form->pairs + idx, pairs + idx);
+	}
+	return count;
+}
+
@@ -0,0 +1,126 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+#if !defined(__HM_FORM_H__)
+#define __HM_FORM_H__
+
+#include "lcommon.h"
+
+#include "hm_parser.h"
+
+/* HMFormPair flags: the key/value has escapes and needs hm_url_decode(). */
+#define HM_FORM_KEY_ESCAPED               (1<<0)
+#define HM_FORM_VALUE_ESCAPED             (1<<1)
+
+typedef struct HMFormPair HMFormPair;
+
+/**
+ * One key/value pair, not decoded.  A key without '=' has an empty value.
+ */
+struct HMFormPair {
+	const char  *key;
+	const char  *value;
+	hm_len_t    key_len;
+	hm_len_t    value_len;
+	uint32_t    flags;    /**< HM_FORM_*_ESCAPED */
+};
+
+/**
+ * Streaming tokenizer for query strings and application/x-www-form-urlencoded bodies.
+ *
+ * Input can be fed in any number of pieces, a pair that is split between two pieces
+ * is copied into the form's carry buffer, all other pairs point into the fed data.
+ * Pairs are collected until hm_form_clear_pairs(), the fed data must stay valid
+ * until then.  Decoding is left to the caller, so only the keys & values that are
+ * used need to be decoded.
+ *
+ * @ingroup Objects
+ */
+typedef struct HMForm HMForm;
+
+/**
+ * Create a new HMForm.
+ *
+ * @param allocator allocator for the tokenizer (NULL for the default allocator).
+ * @return pointer to new HMForm.
+ * @public @memberof HMForm
+ */
+L_LIB_API HMForm *hm_form_new(HMAllocator *allocator);
+
+/**
+ * Free instance of HMForm.
+ *
+ * @param form pointer to HMForm instance to free
+ * @public @memberof HMForm
+ */
+L_LIB_API void hm_form_free(HMForm *form);
+
+/**
+ * Drop all pairs and the incomplete pair, for the next query string or body.
+ *
+ * @public @memberof HMForm
+ */
+L_LIB_API void hm_form_reset(HMForm *form);
+
+/**
+ * Drop the collected pairs, an incomplete pair is kept for the next piece.
+ *
+ * @public @memberof HMForm
+ */
+L_LIB_API void hm_form_clear_pairs(HMForm *form);
+
+/**
+ * Tokenize the next piece of input.
+ *
+ * @param form pointer to HMForm structure.
+ * @param data next piece, must stay valid until hm_form_clear_pairs()/hm_form_reset().
+ * @param len length of `data`.
+ * @param last this is the last piece, the pair at the end of `data` is complete.
+ * @return number of pairs added or -1 on allocation failure.
+ * @public @memberof HMForm
+ */
+L_LIB_API int hm_form_feed(HMForm *form, const char *data, size_t len, bool last);
+
+/**
+ * Tokenize the query string of the parser's url.
+ *
+ * @return number of pairs added or -1 on allocation failure.
+ * @public @memberof HMForm
+ */
+L_LIB_API int hm_form_feed_query(HMForm *form, HMParser *hm_parser);
+
+/**
+ * Tokenize all body chunks that are available with hm_parser_next_body().
+ *
+ * @param form pointer to HMForm structure.
+ * @param hm_parser parser with a form body.
+ * @param last the message is complete, no more body chunks will follow.
+ * @return number of pairs added or -1 on allocation failure.
+ * @public @memberof HMForm
+ */
+L_LIB_API int hm_form_feed_body(HMForm *form, HMParser *hm_parser, bool last);
+
+L_LIB_API uint32_t hm_form_count_pairs(HMForm *form);
+
+/**
+ * Get one pair.
+ *
+ * @return false if `idx` is out of range.
+ * @public @memberof HMForm
+ */
+L_LIB_API bool hm_form_get_pair(HMForm *form, uint32_t idx, HMFormPair *pair);
+
+/**
+ * Get all pairs with one call.
+ *
+ * @param form pointer to HMForm structure.
+ * @param pairs caller-provided array to fill.
+ * @param max size of the `pairs` array.
+ * @return number of pairs written to `pairs`.
+ * @public @memberof HMForm
+ */
+L_LIB_API uint32_t hm_form_get_pairs(HMForm *form, HMFormPair *pairs, uint32_t max);
+
+#endif /* __HM_FORM_H__ */
+
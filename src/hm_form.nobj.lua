@@ -0,0 +1,127 @@
+-- Copyright (c) 2011 by Robert G. Jakabosky <bobby@sharedrealm.com>
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+
+object "HMForm" {
+	include"hm_form.h",
+	ffi_cdef[[
+typedef struct HMFormPair {
+	const char *key;
+	const char *value;
+	hm_len_t   key_len;
+	hm_len_t   value_len;
+	uint32_t   flags;
+} HMFormPair;
+
+int hm_form_feed(HMForm *form, const char *data, size_t len, bool last);
+uint32_t hm_form_get_pairs(HMForm *form, HMFormPair *pairs, uint32_t max);
+void hm_form_clear_pairs(HMForm *form);
+size_t hm_url_decode(const char *src, size_t len, char *dst, bool plus_as_space);
+
+]],
+	ffi_source "ffi_src" [[
+local band = require"bit".band
+
+-- tmp. arrays for feed().
+local hm_pairs_max = 32
+local hm_pairs_tmp = ffi.new("HMFormPair[?]", hm_pairs_max)
+local hm_decode_max = 256
+local hm_decode_tmp = ffi.new("char[?]", hm_decode_max)
+
+local function hm_form_string(str, len, escaped)
+	if not escaped then return ffi_string(str, len) end
+	if len > hm_decode_max then
+		hm_decode_max = len
+		hm_decode_tmp = ffi.new("char[?]", hm_decode_max)
+	end
+	return ffi_string(hm_decode_tmp, C.hm_url_decode(str, len, hm_decode_tmp, true))
+end
+]],
+	destructor {
+		c_method_call "void" "hm_form_free" {},
+	},
+
+	method "reset" {
+		c_method_call "void" "hm_form_reset" {},
+	},
+
+	-- tokenize the next piece of a form, fill `tbl` with the decoded key/value pairs
+	-- that are complete: { key1, value1, key2, value2, ... }
+	method "feed" {
+		var_in { "const char *", "data" },
+		var_in { "bool", "last" },
+		var_in { "<any>", "tbl" },
+		var_out { "int", "count" },
+		c_source [[
+	luaL_checktype(L, ${tbl::idx}, LUA_TTABLE);
+	${count} = hm_form_feed(${this}, ${data}, ${data_len}, ${last});
+	if(${count} >= 0) {
+		${count} = hm_lua_form_pairs(L, ${tbl::idx}, ${this});
+	}
+]],
+		ffi_source [[
+	${count} = C.hm_form_feed(${this}, ${data}, ${data_len}, ${last})
+	if ${count} > hm_pairs_max then
+		hm_pairs_max = ${count}
+		hm_pairs_tmp = ffi.new("HMFormPair[?]", hm_pairs_max)
+	end
+	if ${count} > 0 then
+		${count} = C.hm_form_get_pairs(${this}, hm_pairs_tmp, ${count})
+		for i=0,${count}-1 do
+			local pair = hm_pairs_tmp[i]
+			${tbl}[(i * 2) + 1] = hm_form_string(pair.key, pair.key_len, band(pair.flags, 1) ~= 0)
+			${tbl}[(i * 2) + 2] = hm_form_string(pair.value, pair.value_len, band(pair.flags, 2) ~= 0)
+		end
+	end
+	C.hm_form_clear_pairs(${this})
+]],
+	},
+
+	-- same as feed() for the query string of the parser's url.
+	method "feed_query" {
+		var_in { "HMParser *", "parser" },
+		var_in { "<any>", "tbl" },
+		var_out { "int", "count" },
+		c_source [[
+	luaL_checktype(L, ${tbl::idx}, LUA_TTABLE);
+	hm_form_reset(${this});
+	${count} = hm_form_feed_query(${this}, ${parser});
+	if(${count} >= 0) {
+		${count} = hm_lua_form_pairs(L, ${tbl::idx}, ${this});
+	}
+]],
+	},
+
+	-- same as feed() for the body chunks available from the parser.
+	method "feed_body" {
+		var_in { "HMParser *", "parser" },
+		var_in { "bool", "last" },
+		var_in { "<any>", "tbl" },
+		var_out { "int", "count" },
+		c_source [[
+	luaL_checktype(L, ${tbl::idx}, LUA_TTABLE);
+	${count} = hm_form_feed_body(${this}, ${parser}, ${last});
+	if(${count} >= 0) {
+		${count} = hm_lua_form_pairs(L, ${tbl::idx}, ${this});
+	}
+]],
+	},
+}
+
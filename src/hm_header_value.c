@@ -0,0 +1,274 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "hm_header_value.h"
+
+#define hm_is_ows(c) ((c) == ' ' || (c) == '\t')
+
+static inline const char *hm_skip_ows(const char *p, const char *end) {
+	while(p < end && hm_is_ows(*p)) p++;
+	return p;
+}
+
+static inline const char *hm_trim_ows(const char *start, const char *p) {
+	while(p > start && hm_is_ows(p[-1])) p--;
+	return p;
+}
+
+/* `p` is after the opening quote, returns the closing quote (or `end`). */
+static const char *hm_skip_quoted(const char *p, const char *end) {
+	for(; p < end; p++) {
+		if(*p == '"') break;
+		if(*p == '\\' && (p + 1) < end) p++;
+	}
+	return p;
+}
+
+/* find `c` outside of quoted-strings. */
+static const char *hm_find_unquoted(const char *p, const char *end, char c) {
+	for(; p < end; p++) {
+		if(*p == c) break;
+		if(*p == '"') {
+			p = hm_skip_quoted(p + 1, end);
+			if(p == end) break;
+		}
+	}
+	return p;
+}
+
+/* find ',' or ';' outside of quoted-strings. */
+static const char *hm_find_item_end(const char *p, const char *end) {
+	for(; p < end; p++) {
+		if(*p == ',' || *p == ';') break;
+		if(*p == '"') {
+			p = hm_skip_quoted(p + 1, end);
+			if(p == end) break;
+		}
+	}
+	return p;
+}
+
+/* qvalue = ( "0" [ "." 0*3DIGIT ] ) / ( "1" [ "." 0*3("0") ] ), `def` if invalid. */
+static uint16_t hm_parse_qvalue(const char *p, const char *end, uint16_t def) {
+	uint32_t q;
+	uint32_t scale = 100;
+
+	if(p == end || (*p != '0' && *p != '1')) return def;
+	q = (*p++ - '0') * 1000;
+	if(p < end && *p == '.') {
+		for(p++; p < end && scale > 0; p++, scale /= 10) {
+			if(*p < '0' || *p > '9') break;
+			q += (*p - '0') * scale;
+		}
+	}
+	if(p != end || q > 1000) return def;
+	return (uint16_t)q;
+}
+
+/* find the "q" parameter in ";" parameters. */
+static uint16_t hm_params_q(const char *p, const char *end) {
+	const char *param_end;
+
+	while(p < end) {
+		p = hm_skip_ows(p, end);
+		param_end = hm_find_unquoted(p, end, ';');
+		if((param_end - p) >= 2 && (p[0] == 'q' || p[0] == 'Q')) {
+			const char *v = hm_skip_ows(p + 1, param_end);
+			if(v < param_end && *v == '=') {
+				v = hm_skip_ows(v + 1, param_end);
+				return hm_parse_qvalue(v, hm_trim_ows(v, param_end), 1000);
+			}
+		}
+		if(param_end == end) break;
+		p = param_end + 1;
+	}
+	return 1000;
+}
+
+static inline void hm_item_set_value(HMHeaderItem *item, const char *value,
+		const char *start, const char *end, bool escapes) {
+	if(end > start && *start == '"') {
+		/* remove the quotes. */
+		start++;
+		if(end > start && end[-1] == '"') end--;
+		item->flags |= HM_HEADER_ITEM_QUOTED;
+		if(escapes && memchr(start, '\\', end - start) != NULL) {
+			item->flags |= HM_HEADER_ITEM_ESCAPED;
+		}
+	}
+	item->value_off = (uint32_t)(start - value);
+	item->value_len = (uint32_t)(end - start);
+}
+
+/* next list item: "key[=value][;params]", returns NULL at the end. */
+static const char *hm_next_list_item(const char *value, const char *p, const char *end,
+		HMHeaderItem *item) {
+	const char *key;
+	const char *val;
+
+	for(;;) {
+		/* skip empty elements: ", ,a" */
+		while(p < end && (hm_is_ows(*p) || *p == ',')) p++;
+		if(p == end) return NULL;
+		key = p;
+		while(p < end && *p != ',' && *p != ';' && *p != '=') p++;
+		item->key_off = (uint32_t)(key - value);
+		item->key_len = (uint32_t)(hm_trim_ows(key, p) - key);
+		item->value_off = (uint32_t)(p - value);
+		item->value_len = 0;
+		item->params_off = item->value_off;
+		item->params_len = 0;
+		item->q = 1000;
+		item->flags = 0;
+		if(p < end && *p == '=') {
+			val = hm_skip_ows(p + 1, end);
+			p = hm_find_item_end(val, end);
+			hm_item_set_value(item, value, val, hm_trim_ows(val, p), true);
+		}
+		if(p < end && *p == ';') {
+			item->flags |= HM_HEADER_ITEM_PARAMS;
+			val = hm_skip_ows(p + 1, end);
+			p = hm_find_unquoted(val, end, ',');
+			item->params_off = (uint32_t)(val - value);
+			item->params_len = (uint32_t)(hm_trim_ows(val, p) - val);
+			item->q = hm_params_q(val, p);
+		}
+		if(item->key_len > 0) return p;
+	}
+}
+
+/* next cookie: "name=value", returns NULL at the end. */
+static const char *hm_next_cookie(const char *value, const char *p, const char *end,
+		HMHeaderItem *item) {
+	const char *name;
+	const char *next;
+	const char *eq;
+
+	for(;;) {
+		p = hm_skip_ows(p, end);
+		if(p == end) return NULL;
+		name = p;
+		next = (const char *)memchr(p, ';', end - p);
+		if(next == NULL) next = end;
+		eq = (const char *)memchr(p, '=', next - p);
+		item->key_off = (uint32_t)(name - value);
+		item->params_off = (uint32_t)(next - value);
+		item->params_len = 0;
+		item->q = 1000;
+		item->flags = 0;
+		if(eq != NULL) {
+			item->key_len = (uint32_t)(hm_trim_ows(name, eq) - name);
+			eq = hm_skip_ows(eq + 1, next);
+			hm_item_set_value(item, value, eq, hm_trim_ows(eq, next), false);
+		} else {
+			item->key_len = (uint32_t)(hm_trim_ows(name, next) - name);
+			item->value_off = (uint32_t)(next - value);
+			item->value_len = 0;
+		}
+		p = (next < end) ? next + 1 : end;
+		if(item->key_len > 0 || item->value_len > 0) return p;
+	}
+}
+
+static inline const char *hm_next_item(int kind, const char *value, const char *p,
+		const char *end, HMHeaderItem *item) {
+	if(kind == HM_HEADER_VALUE_COOKIE) {
+		return hm_next_cookie(value, p, end, item);
+	}
+	return hm_next_list_item(value, p, end, item);
+}
+
+int hm_header_value_kind(int id) {
+	switch(id) {
+	case HM_HEADER_COOKIE:
+		return HM_HEADER_VALUE_COOKIE;
+	case HM_HEADER_ACCEPT:
+	case HM_HEADER_ACCEPT_CHARSET:
+	case HM_HEADER_ACCEPT_ENCODING:
+	case HM_HEADER_ACCEPT_LANGUAGE:
+	case HM_HEADER_ALLOW:
+	case HM_HEADER_CACHE_CONTROL:
+	case HM_HEADER_CONNECTION:
+	case HM_HEADER_CONTENT_ENCODING:
+	case HM_HEADER_CONTENT_LANGUAGE:
+	case HM_HEADER_PRAGMA:
+	case HM_HEADER_PROXY_CONNECTION:
+	case HM_HEADER_TE:
+	case HM_HEADER_TRAILER:
+	case HM_HEADER_TRANSFER_ENCODING:
+	case HM_HEADER_UPGRADE:
+	case HM_HEADER_VARY:
+		return HM_HEADER_VALUE_LIST;
+	default:
+		break;
+	}
+	return HM_HEADER_VALUE_NONE;
+}
+
+int hm_header_value_parse(int id, const char *value, size_t len,
+		HMHeaderItem *items, uint32_t max) {
+	int kind = hm_header_value_kind(id);
+	const char *p = value;
+	const char *end;
+	HMHeaderItem tmp;
+	int count = 0;
+
+	if(kind == HM_HEADER_VALUE_NONE) return -1;
+	if(value == NULL) return 0;
+	end = value + len;
+	for(;;) {
+		HMHeaderItem *item = ((uint32_t)count < max) ? &(items[count]) : &tmp;
+		p = hm_next_item(kind, value, p, end, item);
+		if(p == NULL) break;
+		count++;
+	}
+	return count;
+}
+
+static inline bool hm_key_equal(int kind, const char *a, const char *b, size_t len) {
+	size_t n;
+
+	if(kind == HM_HEADER_VALUE_COOKIE) {
+		return memcmp(a, b, len) == 0;
+	}
+	for(n = 0; n < len; n++) {
+		char ca = a[n], cb = b[n];
+		if(ca >= 'A' && ca <= 'Z') ca += 'a' - 'A';
+		if(cb >= 'A' && cb <= 'Z') cb += 'a' - 'A';
+		if(ca != cb) return false;
+	}
+	return true;
+}
+
+int hm_header_value_find(int id, const char *value, size_t len,
+		const char *key, size_t key_len, HMHeaderItem *item) {
+	int kind = hm_header_value_kind(id);
+	const char *p = value;
+	const char *end;
+
+	if(kind == HM_HEADER_VALUE_NONE || value == NULL) return -1;
+	end = value + len;
+	while((p = hm_next_item(kind, value, p, end, item)) != NULL) {
+		if(item->key_len == key_len && hm_key_equal(kind, value + item->key_off, key, key_len)) {
+			return 0;
+		}
+	}
+	return -1;
+}
+
+size_t hm_header_value_unescape(const char *src, size_t len, char *dst) {
+	const char *end = src + len;
+	char *out = dst;
+
+	while(src < end) {
+		if(*src == '\\' && (src + 1) < end) {
+			src++;
+		}
+		*out++ = *src++;
+	}
+	return out - dst;
+}
@@ -0,0 +1,97 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+#if !defined(__HM_HEADER_VALUE_H__)
+#define __HM_HEADER_VALUE_H__
+
+#include "lcommon.h"
+
+#include "hm_parser.h"
+
+/* how a header value is split, see hm_header_value_kind(). */
+#define HM_HEADER_VALUE_NONE              0
+/* comma-separated list: "gzip;q=0.8, br", "no-cache, max-age=0" */
+#define HM_HEADER_VALUE_LIST              1
+/* Cookie pairs: "a=1; b=2" */
+#define HM_HEADER_VALUE_COOKIE            2
+
+/* HMHeaderItem flags. */
+/* the value was a quoted-string (quotes removed). */
+#define HM_HEADER_ITEM_QUOTED             (1<<0)
+/* the item has ";" parameters. */
+#define HM_HEADER_ITEM_PARAMS             (1<<1)
+/* the quoted value contains '\' escapes, see hm_header_value_unescape(). */
+#define HM_HEADER_ITEM_ESCAPED            (1<<2)
+
+typedef struct HMHeaderItem HMHeaderItem;
+
+/**
+ * One list item or cookie, the offsets are relative to the header value.
+ *
+ * List items: "key[=value][;params]", like Cache-Control directives ("max-age=0") or
+ * Accept items ("text/html;level=1;q=0.5", the key is the item token and the "q"
+ * parameter is also parsed into `q`).
+ * Cookies: "name=value".
+ */
+struct HMHeaderItem {
+	uint32_t    key_off;
+	uint32_t    key_len;
+	uint32_t    value_off;
+	uint32_t    value_len;  /**< 0 if there is no value. */
+	uint32_t    params_off; /**< ";" parameters, without the first ";". */
+	uint32_t    params_len; /**< 0 if there are no parameters. */
+	uint16_t    q;          /**< q-value * 1000, 1000 if there is no valid "q" parameter. */
+	uint16_t    flags;      /**< HM_HEADER_ITEM_* */
+};
+
+/**
+ * How the value of a header is split.
+ *
+ * @param id header id (see hm_header_ids.gperf).
+ * @return HM_HEADER_VALUE_LIST, HM_HEADER_VALUE_COOKIE or HM_HEADER_VALUE_NONE for
+ * headers without a known structure.
+ */
+L_LIB_API int hm_header_value_kind(int id);
+
+/**
+ * Split a header value into items, nothing is copied.
+ *
+ * @param id header id, see hm_header_value_kind().
+ * @param value header value, like from hm_parser_find_header().
+ * @param len length of `value`.
+ * @param items array to fill.
+ * @param max size of the `items` array.
+ * @return number of items in the value (can be more then `max`, only `max` items are
+ * filled) or -1 if the header has no known structure.
+ */
+L_LIB_API int hm_header_value_parse(int id, const char *value, size_t len,
+	HMHeaderItem *items, uint32_t max);
+
+/**
+ * Find one item by key.  List keys are compared case-insensitive, cookie names
+ * case-sensitive.
+ *
+ * @param id header id, see hm_header_value_kind().
+ * @param value header value.
+ * @param len length of `value`.
+ * @param key key to find ("gzip", "max-age", cookie name).
+ * @param key_len length of `key`.
+ * @param item set to the first item with that key.
+ * @return 0 or -1 if the key wasn't found.
+ */
+L_LIB_API int hm_header_value_find(int id, const char *value, size_t len,
+	const char *key, size_t key_len, HMHeaderItem *item);
+
+/**
+ * Remove the '\' escapes of a quoted value (HM_HEADER_ITEM_ESCAPED items).
+ *
+ * @param src quoted value without the quotes.
+ * @param len length of `src`.
+ * @param dst output buffer of at least `len` bytes, can be `src` to unescape in place.
+ * @return length of the unescaped value.
+ */
+L_LIB_API size_t hm_header_value_unescape(const char *src, size_t len, char *dst);
+
+#endif /* __HM_HEADER_VALUE_H__ */
+
@@ -0,0 +1,112 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <string.h>
+#ifdef __WINDOWS__
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "hm_histogram.h"
+
+#define SUB_MASK (HM_HISTOGRAM_SUB_BUCKETS - 1)
+
+static inline uint32_t hm_histogram_index(uint64_t value) {
+	uint32_t shift;
+
+	if(value < HM_HISTOGRAM_SUB_BUCKETS) {
+		return (uint32_t)value;
+	}
+	/* highest set bit picks the power of two, the next bits the linear bucket. */
+	shift = (63 - __builtin_clzll(value)) - HM_HISTOGRAM_SUB_BITS;
+	return ((shift + 1) << HM_HISTOGRAM_SUB_BITS) + ((value >> shift) & SUB_MASK);
+}
+
+/* largest value that is counted in bucket `idx`. */
+static inline uint64_t hm_histogram_bucket_max(uint32_t idx) {
+	uint32_t shift;
+
+	if(idx < HM_HISTOGRAM_SUB_BUCKETS) {
+		return idx;
+	}
+	shift = (idx >> HM_HISTOGRAM_SUB_BITS) - 1;
+	return ((((uint64_t)HM_HISTOGRAM_SUB_BUCKETS + (idx & SUB_MASK)) + 1) << shift) - 1;
+}
+
+void hm_histogram_init(HMHistogram *hist) {
+	memset(hist, 0, sizeof(HMHistogram));
+	hist->min = UINT64_MAX;
+}
+
+void hm_histogram_record(HMHistogram *hist, uint64_t value) {
+	hist->buckets[hm_histogram_index(value)]++;
+	hist->count++;
+	hist->sum += value;
+	if(value < hist->min) hist->min = value;
+	if(value > hist->max) hist->max = value;
+}
+
+void hm_histogram_merge(HMHistogram *hist, const HMHistogram *src) {
+	uint32_t idx;
+
+	for(idx = 0; idx < HM_HISTOGRAM_BUCKETS; idx++) {
+		hist->buckets[idx] += src->buckets[idx];
+	}
+	hist->count += src->count;
+	hist->sum += src->sum;
+	if(src->min < hist->min) hist->min = src->min;
+	if(src->max > hist->max) hist->max = src->max;
+}
+
+uint64_t hm_histogram_percentile(HMHistogram *hist, double percentile) {
+	uint64_t target;
+	uint64_t seen = 0;
+	uint32_t idx;
+
+	if(hist->count == 0) {
+		return 0;
+	}
+	if(percentile >= 100.0) {
+		return hist->max;
+	}
+	target = (uint64_t)((percentile / 100.0) * hist->count + 0.5);
+	if(target == 0) target = 1;
+	for(idx = 0; idx < HM_HISTOGRAM_BUCKETS; idx++) {
+		seen += hist->buckets[idx];
+		if(seen >= target) {
+			uint64_t value = hm_histogram_bucket_max(idx);
+			/* don't report more then what was recorded. */
+			return (value < hist->max) ? value : hist->max;
+		}
+	}
+	return hist->max;
+}
+
+double hm_histogram_mean(HMHistogram *hist) {
+	if(hist->count == 0) {
+		return 0.0;
+	}
+	return (double)hist->sum / (double)hist->count;
+}
+
+uint64_t hm_histogram_now() {
+#ifdef __WINDOWS__
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	if(freq.QuadPart == 0) {
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&now);
+	return (uint64_t)((double)now.QuadPart * (1000000000.0 / (double)freq.QuadPart));
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+#endif
+}
+
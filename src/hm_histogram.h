@@ -0,0 +1,64 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+#if !defined(__HM_HISTOGRAM_H__)
+#define __HM_HISTOGRAM_H__
+
+#include "lcommon.h"
+
+#include <stdint.h>
+
+/*
+ * Log-linear histogram (like HdrHistogram): values are grouped by their highest set
+ * bit, each power of two is split into HM_HISTOGRAM_SUB_BUCKETS linear buckets.
+ * Values below HM_HISTOGRAM_SUB_BUCKETS are exact, larger values are within 1/16
+ * (6.25%) of the recorded value.  Recording is a few instructions and never allocates.
+ */
+#define HM_HISTOGRAM_SUB_BITS      4
+#define HM_HISTOGRAM_SUB_BUCKETS   (1 << HM_HISTOGRAM_SUB_BITS)
+#define HM_HISTOGRAM_BUCKETS       ((64 - HM_HISTOGRAM_SUB_BITS + 1) * HM_HISTOGRAM_SUB_BUCKETS)
+
+typedef struct HMHistogram HMHistogram;
+
+struct HMHistogram {
+	uint64_t    count;    /**< number of recorded values. */
+	uint64_t    sum;      /**< sum of recorded values, for the mean. */
+	uint64_t    min;
+	uint64_t    max;
+	uint64_t    buckets[HM_HISTOGRAM_BUCKETS];
+};
+
+/**
+ * Clear all recorded values.
+ */
+L_LIB_API void hm_histogram_init(HMHistogram *hist);
+
+/**
+ * Record one value.
+ */
+L_LIB_API void hm_histogram_record(HMHistogram *hist, uint64_t value);
+
+/**
+ * Add all values recorded in `src` to `hist`.
+ */
+L_LIB_API void hm_histogram_merge(HMHistogram *hist, const HMHistogram *src);
+
+/**
+ * Returns the value at `percentile` (0-100), the largest value that falls into the
+ * same bucket as the real value.  0 if nothing has been recorded.
+ */
+L_LIB_API uint64_t hm_histogram_percentile(HMHistogram *hist, double percentile);
+
+/**
+ * Returns the mean of the recorded values.
+ */
+L_LIB_API double hm_histogram_mean(HMHistogram *hist);
+
+/**
+ * Monotonic clock in nanoseconds, used for message phase timestamps.
+ */
+L_LIB_API uint64_t hm_histogram_now();
+
+#endif /* __HM_HISTOGRAM_H__ */
+
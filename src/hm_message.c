@@ -0,0 +1,190 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hm_message.h"
+
+#include "hm_array.h"
+
+#include "http-parser/http_parser.h"
+
+#define hm_message_data(msg) ((char *)hm_buffer_data((msg)->buf))
+
+void hm_message_free(HMMessage *msg) {
+	HMAllocator *allocator = msg->allocator;
+
+	hm_buffer_unref(msg->buf);
+	msg->buf = NULL;
+	hm_array_free(allocator, msg->pieces);
+	msg->pieces = NULL;
+	hm_array_free(allocator, msg->headers);
+	msg->headers = NULL;
+	hm_alloc_free(allocator, msg, sizeof(HMMessage));
+}
+
+void hm_message_decode_header(HMHeader *head, char *data, HMHeaderPiece *header) {
+	/* header ids are resolved and unknown names lower-cased during parsing. */
+	head->name_id = header->name_id;
+	if(header->name_id > 0) {
+		head->name = NULL;
+		head->name_len = 0;
+	} else {
+		head->name = data + header->name.start;
+		head->name_len = header->name.end - header->name.start;
+	}
+	head->value = data + header->value.start;
+	head->value_len = header->value.end - header->value.start;
+}
+
+static HMSlice *hm_message_piece_slice(HMMessage *msg, HMPiece *piece) {
+	return hm_slice_new(msg->buf, piece->start, piece->end - piece->start);
+}
+
+const char *hm_message_get_url(HMMessage *msg, size_t *len) {
+	const char *str = NULL;
+	hm_idx_t idx = msg->url_idx;
+	assert(len != NULL);
+	if(idx != HM_PIECE_INVALID) {
+		HMPiece *piece = msg->pieces + idx;
+		str = hm_message_data(msg) + piece->start;
+		*len = piece->end - piece->start;
+	}
+	return str;
+}
+
+int hm_message_get_url_parts(HMMessage *msg, HMUrl *u) {
+	const char *url;
+	size_t len;
+
+	url = hm_message_get_url(msg, &len);
+	if(url == NULL) {
+		return -1;
+	}
+	return hm_url_parse(url, len, (msg->method == HTTP_CONNECT), u);
+}
+
+HMSlice *hm_message_get_url_slice(HMMessage *msg) {
+	hm_idx_t idx = msg->url_idx;
+	if(idx != HM_PIECE_INVALID) {
+		return hm_message_piece_slice(msg, msg->pieces + idx);
+	}
+	return NULL;
+}
+
+uint32_t hm_message_count_headers(HMMessage *msg) {
+	return hm_array_count(msg->headers);
+}
+
+HMHeader *hm_message_get_header(HMMessage *msg, uint32_t idx) {
+	if(idx >= hm_message_count_headers(msg)) {
+		/* idx out of bounds. */
+		return NULL;
+	}
+	hm_message_decode_header(&(msg->tmp_header), hm_message_data(msg), msg->headers + idx);
+	return &(msg->tmp_header);
+}
+
+int hm_message_find_header_idx(HMMessage *msg, int id) {
+	uint32_t count = hm_message_count_headers(msg);
+	uint32_t idx;
+
+	if(id <= 0) {
+		return -1;
+	}
+	/* messages don't keep the parser's `header_first` index, the rest is chained. */
+	for(idx = 0; idx < count; idx++) {
+		if(msg->headers[idx].name_id == id) {
+			return idx;
+		}
+	}
+	return -1;
+}
+
+int hm_message_next_header_idx(HMMessage *msg, uint32_t idx) {
+	hm_idx_t next;
+	if(idx >= hm_message_count_headers(msg)) {
+		return -1;
+	}
+	/* headers with unknown names (id 0) aren't chained. */
+	next = msg->headers[idx].next;
+	if(next == HM_PIECE_INVALID) {
+		return -1;
+	}
+	return next;
+}
+
+HMSlice *hm_message_get_header_slice(HMMessage *msg, uint32_t idx) {
+	if(idx >= hm_message_count_headers(msg)) {
+		/* idx out of bounds. */
+		return NULL;
+	}
+	/* slice of the header value. */
+	return hm_message_piece_slice(msg, &(msg->headers[idx].value));
+}
+
+/* consume next body piece. */
+static hm_idx_t hm_message_next_body_idx(HMMessage *msg) {
+	hm_idx_t idx = msg->body_start;
+	if(idx != HM_PIECE_INVALID) {
+		hm_idx_t next = idx + 1;
+		if(next >= msg->body_end) {
+			next = HM_PIECE_INVALID; /* no more pieces. */
+			msg->body_end = HM_PIECE_INVALID;
+		}
+		msg->body_start = next;
+	}
+	return idx;
+}
+
+const char *hm_message_next_body(HMMessage *msg, size_t *len) {
+	const char *str = NULL;
+	hm_idx_t idx = hm_message_next_body_idx(msg);
+	assert(len != NULL);
+	if(idx != HM_PIECE_INVALID) {
+		HMPiece *piece = msg->pieces + idx;
+		str = hm_message_data(msg) + piece->start;
+		*len = piece->end - piece->start;
+	}
+	return str;
+}
+
+HMSlice *hm_message_next_body_slice(HMMessage *msg) {
+	hm_idx_t idx = hm_message_next_body_idx(msg);
+	if(idx != HM_PIECE_INVALID) {
+		return hm_message_piece_slice(msg, msg->pieces + idx);
+	}
+	return NULL;
+}
+
+int hm_message_should_keep_alive(HMMessage *msg) {
+	return msg->keep_alive;
+}
+
+int hm_message_is_upgrade(HMMessage *msg) {
+	return msg->upgrade;
+}
+
+int hm_message_method(HMMessage *msg) {
+	return msg->method;
+}
+
+const char *hm_message_method_str(HMMessage *msg) {
+	return http_method_str(msg->method);
+}
+
+int hm_message_version(HMMessage *msg) {
+	return ((msg->http_major) << 16) + (msg->http_minor);
+}
+
+int hm_message_status_code(HMMessage *msg) {
+	return msg->status_code;
+}
+
+void hm_message_get_timing(HMMessage *msg, HMTiming *timing) {
+	*timing = msg->timing;
+}
+
@@ -0,0 +1,119 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+#if !defined(__HM_MESSAGE_H__)
+#define __HM_MESSAGE_H__
+
+#include "hm_parser.h"
+
+#define HM_PIECE_INVALID (UINT16_MAX)
+
+typedef struct HMPiece HMPiece;
+
+struct HMPiece {
+	hm_len_t    start;  /**< offset to start of piece in the buffer. */
+	hm_len_t    end;    /**< offset to end of piece in the buffer. */
+};
+
+typedef struct HMHeaderPiece HMHeaderPiece;
+
+struct HMHeaderPiece {
+	HMPiece     name;     /**< header name. */
+	HMPiece     value;    /**< header value. */
+	uint16_t    name_id;  /**< header id, resolved when the name is complete (0 for unknown headers). */
+	hm_idx_t    next;     /**< index of the next header with the same id. */
+};
+
+/**
+ * HTTP message detached from the parser.
+ *
+ * Holds a reference to the parser's buffer and owns the pieces array of the
+ * message, fields are only decoded when they are accessed.
+ *
+ * @ingroup Objects
+ */
+struct HMMessage {
+	HMAllocator   *allocator;   /**< allocator of the parser that created the message. */
+	HMBuffer      *buf;         /**< shared buffer holding the raw http message. */
+	HMPiece       *pieces;      /**< url & body pieces. */
+	HMHeaderPiece *headers;     /**< header name/value pieces. */
+	/* HTTP Message fields. */
+	hm_idx_t      url_idx;
+	hm_idx_t      body_start;
+	hm_idx_t      body_end;
+	/* info from http_parser. */
+	uint16_t      http_major;
+	uint16_t      http_minor;
+	uint16_t      status_code;
+	uint8_t       method;
+	uint8_t       keep_alive: 1;
+	uint8_t       upgrade: 1;
+	HMTiming      timing;       /**< timestamps from HM_PARSER_OPT_TIMING parsers. */
+	/* tmp data */
+	HMHeader tmp_header;
+};
+
+/**
+ * Free instance of HMMessage.
+ *
+ * @param msg pointer to HMMessage instance to free
+ * @public @memberof HMMessage
+ */
+L_LIB_API void hm_message_free(HMMessage *msg);
+
+/**
+ * methods to access HTTP headers.
+ */
+L_LIB_API const char *hm_message_get_url(HMMessage *msg, size_t *len);
+
+/**
+ * Split the url into it's components, see hm_parser_get_url_parts().
+ */
+L_LIB_API int hm_message_get_url_parts(HMMessage *msg, HMUrl *u);
+
+L_LIB_API uint32_t hm_message_count_headers(HMMessage *msg);
+
+L_LIB_API HMHeader *hm_message_get_header(HMMessage *msg, uint32_t idx);
+
+/**
+ * Iterate over repeated headers with the same id, see hm_parser_find_header_idx().
+ *
+ * @public @memberof HMMessage
+ */
+L_LIB_API int hm_message_find_header_idx(HMMessage *msg, int id);
+
+L_LIB_API int hm_message_next_header_idx(HMMessage *msg, uint32_t idx);
+
+L_LIB_API const char *hm_message_next_body(HMMessage *msg, size_t *len);
+
+L_LIB_API HMSlice *hm_message_get_url_slice(HMMessage *msg);
+
+L_LIB_API HMSlice *hm_message_get_header_slice(HMMessage *msg, uint32_t idx);
+
+L_LIB_API HMSlice *hm_message_next_body_slice(HMMessage *msg);
+
+/**
+ * methods to access info copied from http_parser.
+ */
+
+L_LIB_API int hm_message_should_keep_alive(HMMessage *msg);
+
+L_LIB_API int hm_message_is_upgrade(HMMessage *msg);
+
+L_LIB_API int hm_message_method(HMMessage *msg);
+
+L_LIB_API const char *hm_message_method_str(HMMessage *msg);
+
+L_LIB_API int hm_message_version(HMMessage *msg);
+
+L_LIB_API int hm_message_status_code(HMMessage *msg);
+
+L_LIB_API void hm_message_get_timing(HMMessage *msg, HMTiming *timing);
+
+/**
+ * Fill `head` from the header name/value pieces (internal, shared with HMParser).
+ */
+L_LIB_API void hm_message_decode_header(HMHeader *head, char *data, HMHeaderPiece *header);
+
+#endif /* __HM_MESSAGE_H__ */
@@ -0,0 +1,224 @@
+-- Copyright (c) 2011 by Robert G. Jakabosky <bobby@sharedrealm.com>
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+
+object "HMMessage" {
+	include"hm_message.h",
+	include"hm_header_value.h",
+	ffi_cdef[[
+int hm_message_get_url_parts(HMMessage *msg, HMUrl *u);
+]],
+	destructor {
+		c_method_call "void" "hm_message_free" {},
+	},
+
+	-- get url/headers/body chunks
+
+	method "count_headers" {
+		c_method_call "uint32_t" "hm_message_count_headers" {},
+	},
+
+	method "get_url" {
+		c_method_call { "const char *", "url", has_length = 1 } "hm_message_get_url"
+			{ "size_t", "&#url" },
+	},
+
+	-- one url component (see hm.url_fields), use get_url_parts() for more then one field.
+	method "get_url_field" {
+		var_in { "uint32_t", "field" },
+		var_out { "const char *", "value", has_length = 1 },
+		c_source [[
+	HMUrl u;
+	const char *url;
+	size_t len;
+
+	url = hm_message_get_url(${this}, &len);
+	if(${field} < HM_URL_FIELDS && hm_message_get_url_parts(${this}, &u) == 0 &&
+			hm_url_has_field(&u, ${field})) {
+		${value} = url + u.field[${field}].off;
+		${value_len} = u.field[${field}].len;
+	}
+]],
+	},
+
+	-- same as HMParser:get_url_parts().
+	method "get_url_parts" {
+		var_in { "<any>", "tbl" },
+		var_out { "const char *", "url", has_length = 1 },
+		var_out { "uint32_t", "port" },
+		c_source [[
+	HMUrl u;
+
+	luaL_checktype(L, ${tbl::idx}, LUA_TTABLE);
+	if(hm_message_get_url_parts(${this}, &u) == 0) {
+		${url} = hm_message_get_url(${this}, &(${url_len}));
+		${port} = u.port;
+		hm_lua_url_parts(L, ${tbl::idx}, &u);
+	}
+]],
+		ffi_source [[
+	if C.hm_message_get_url_parts(${this}, hm_url_tmp) ~= 0 then return nil end
+	local url = C.hm_message_get_url(${this}, hm_url_len_tmp)
+	hm_url_parts(${tbl})
+	return ffi_string(url, hm_url_len_tmp[0]), hm_url_tmp.port
+]],
+	},
+
+	method "get_header" {
+		var_out { "uint32_t", "name_id" },
+		var_out { "const char *", "name", has_length = 1 },
+		var_out { "const char *", "value", has_length = 1 },
+		c_method_call { "HMHeader *", "(header)" } "hm_message_get_header" { "uint32_t", "idx" },
+		c_source [[
+	if(${header}) {
+		${name_id} = ${header}->name_id;
+		if(${name_id} <= 0) {
+			${name} = ${header}->name;
+			${name_len} = ${header}->name_len;
+		}
+		${value} = ${header}->value;
+		${value_len} = ${header}->value_len;
+	}
+]],
+		ffi_source [[
+	if ${header} ~= nil then
+		local name
+		local id = ${header}.name_id
+		if id <= 0 then
+			name = ffi_string(${header}.name, ${header}.name_len)
+		end
+		return id, name,
+			ffi_string(${header}.value, ${header}.value_len)
+	end
+]],
+	},
+
+	-- same as HMParser:find_header_item().
+	method "find_header_item" {
+		var_in { "int", "id" },
+		var_in { "const char *", "key" },
+		c_source [[
+	HMHeaderItem item;
+	HMHeader *header;
+	int idx;
+
+	idx = hm_message_find_header_idx(${this}, ${id});
+	for(; idx >= 0; idx = hm_message_next_header_idx(${this}, idx)) {
+		header = hm_message_get_header(${this}, idx);
+		if(hm_header_value_find(${id}, header->value, header->value_len,
+				${key}, ${key_len}, &item) == 0) {
+			return hm_lua_push_item(L, header->value, &item);
+		}
+	}
+	lua_pushnil(L);
+	return 1;
+]],
+	},
+
+	-- same as HMParser:get_header_items().
+	method "get_header_items" {
+		var_in { "int", "id" },
+		var_in { "<any>", "tbl" },
+		var_out { "uint32_t", "count" },
+		c_source [[
+	HMHeader *header;
+	int idx;
+
+	luaL_checktype(L, ${tbl::idx}, LUA_TTABLE);
+	${count} = 0;
+	idx = hm_message_find_header_idx(${this}, ${id});
+	for(; idx >= 0; idx = hm_message_next_header_idx(${this}, idx)) {
+		header = hm_message_get_header(${this}, idx);
+		${count} += hm_lua_header_items(L, ${tbl::idx}, ${count}, ${id}, header);
+	}
+	hm_lua_clear_table(L, ${tbl::idx}, (${count} * 5) + 1);
+]],
+	},
+
+	method "find_header_idx" {
+		c_method_call "int" "hm_message_find_header_idx" { "int", "id" },
+	},
+
+	method "next_header_idx" {
+		c_method_call "int" "hm_message_next_header_idx" { "uint32_t", "idx" },
+	},
+
+	method "next_body" {
+		c_method_call { "const char *", "body", has_length = 1 } "hm_message_next_body"
+			{ "size_t", "&#body" },
+	},
+
+	-- zero-copy slices of url/header values/body chunks.
+
+	method "get_url_slice" {
+		c_method_call "!HMSlice *" "hm_message_get_url_slice" {},
+	},
+
+	method "get_header_slice" {
+		c_method_call "!HMSlice *" "hm_message_get_header_slice" { "uint32_t", "idx" },
+	},
+
+	method "next_body_slice" {
+		c_method_call "!HMSlice *" "hm_message_next_body_slice" {},
+	},
+
+	-- info copied from http-parser
+	method "should_keep_alive" {
+		c_method_call "bool" "hm_message_should_keep_alive" {},
+	},
+
+	method "is_upgrade" {
+		c_method_call "bool" "hm_message_is_upgrade" {},
+	},
+
+	method "method" {
+		c_method_call "int" "hm_message_method" {},
+	},
+
+	method "method_str" {
+		c_method_call "const char *" "hm_message_method_str" {},
+	},
+
+	method "version" {
+		c_method_call "int" "hm_message_version" {},
+	},
+
+	method "status_code" {
+		c_method_call "int" "hm_message_status_code" {},
+	},
+
+	-- monotonic timestamps in nanoseconds, from a HM_PARSER_OPT_TIMING parser.
+	method "timing" {
+		var_out { "uint64_t", "first_byte" },
+		var_out { "uint64_t", "message_begin" },
+		var_out { "uint64_t", "headers_complete" },
+		var_out { "uint64_t", "message_complete" },
+		c_source [[
+	HMTiming timing;
+
+	hm_message_get_timing(${this}, &timing);
+	${first_byte} = timing.first_byte;
+	${message_begin} = timing.message_begin;
+	${headers_complete} = timing.headers_complete;
+	${message_complete} = timing.message_complete;
+]],
+	},
+}
+
@@ -1,17 +1,44 @@
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#ifdef __WINDOWS__
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#endif
 
 #include "hm_parser.h"
 
+#include "hm_message.h"
+
+#include "hm_alloc.h"
+
 #include "hm_buffer.h"
 
 #include "hm_array.h"
 
+#include "hm_scan.h"
+
 #include "http-parser/http_parser.h"
 
+#include "hm_header_ids.h"
+
 #define MIN_BUFFER_SPACE 1024
+/* buffers double in size up to this size, then grow in steps of this size. */
+#define MAX_BUFFER_GROW (1024 * 1024)
+/* largest body that the buffer will be presized for. */
+#define MAX_BUFFER_PRESIZE (4 * 1024 * 1024)
+/* idle buffers larger then this are shrunk. */
+#define MAX_IDLE_BUFFER (64 * 1024)
+
+#define MAX_BATCH 1024
+#define INIT_BATCH 16
+#define INIT_BATCH_PIECES (INIT_BATCH * 2)
+#define INIT_BATCH_HEADERS (INIT_BATCH * INIT_HEADERS)
 
 #define MAX_HEADERS 512
 #define INIT_HEADERS 8
@@ -22,9 +49,20 @@
 #define GROW_CHUNKS 16
 
 #define MAX_PIECES  4096
-#define INIT_PIECES ((INIT_HEADERS * 2) + INIT_CHUNKS)
+#define INIT_PIECES (1 + INIT_CHUNKS)
 #define GROW_PIECES 128
 
+/* parts of a HM_PARSER_OPT_SINGLE_ALLOC parser start on their own cache line. */
+#define CACHE_LINE 64
+#define CACHE_ALIGN(size) (((size) + (CACHE_LINE - 1)) & ~((size_t)CACHE_LINE - 1))
+
+/* performance counters are only kept when compiled with HM_PARSER_STATS. */
+#ifdef HM_PARSER_STATS
+#define HM_STAT_ADD(hm_parser, name, n) ((hm_parser)->stats.name += (n))
+#else
+#define HM_STAT_ADD(hm_parser, name, n) ((void)0)
+#endif
+
 typedef enum {
 	hm_piece_url = 0,
 	hm_piece_header_field,
@@ -33,15 +71,6 @@ typedef enum {
 	hm_piece_none,
 } hm_piece_t;
 
-#define HM_PIECE_INVALID (UINT16_MAX)
-
-typedef struct HMPiece HMPiece;
-
-struct HMPiece {
-	hm_len_t    start;  /**< offset to start of piece in the buffer. */
-	hm_len_t    end;    /**< offset to end of piece in the buffer. */
-};
-
 /**
  * HTTP message object.
  *
@@ -49,17 +78,59 @@ struct HMPiece {
  */
 struct HMParser {
 	http_parser parser;   /**< embedded http_parser. */
-	HMPiece       *pieces;
+	HMAllocator   *allocator;   /**< allocator for the parser, it's buffers and messages. */
+	void          *alloc_base;  /**< start of the parser's allocation. */
+	size_t        alloc_size;   /**< size of the parser's allocation. */
+	HMPiece       *pieces;      /**< url & body pieces. */
+	HMHeaderPiece *headers;     /**< header name/value pieces. */
+	/* HM_PARSER_OPT_BATCH, completed messages and their pieces. */
+	HMBatchMessage *batch;
+	uint32_t      batch_len;
+	uint32_t      batch_cap;
+	HMPiece       *batch_pieces;
+	HMHeaderPiece *batch_headers;
+	const char    *batch_data;  /**< buffer or caller's data of the batched messages. */
 	uint32_t      state: 10;
 	uint32_t      last_id: 3;
 	uint32_t      is_eof: 1;
+	uint32_t      is_closed: 1;   /**< last message closed the connection. */
+	uint32_t      scan_msg: 1;    /**< current message was parsed by the fast scanner. */
+	uint32_t      scan_body: 1;   /**< fast scanner is reading the body. */
+	uint32_t      keep_alive: 1;  /**< keep-alive for messages from the fast scanner. */
+	uint32_t      is_external: 1; /**< parsing directly from the caller's memory. */
+	uint32_t      pieces_inline: 1;  /**< `pieces` is part of the parser's allocation. */
+	uint32_t      headers_inline: 1; /**< `headers` is part of the parser's allocation. */
+	uint32_t      limit: 3;     /**< HM_PARSER_LIMIT_* that stopped the parser. */
+	uint32_t      opts;         /**< HM_PARSER_OPT_* flags. */
+	hm_len_t      body_left;    /**< body bytes left for the fast scanner. */
+	hm_len_t      wait_off;     /**< bytes after `parsed_off` already scanned for the end of headers. */
+	hm_len_t      max_header_size; /**< stop waiting for the end of headers after this many bytes. */
+	HMParserLimits limits;
+	uint64_t      body_len;     /**< body bytes of the current message, for `limits.max_body`. */
+	hm_len_t      body_off;     /**< offset of the first body byte, for streaming/discarding the body. */
+	size_t        buf_high;     /**< largest buffer capacity used. */
+	uint64_t      bytes_moved;  /**< bytes moved/copied inside or between buffers. */
+	/* HM_PARSER_OPT_TIMING */
+	HMTiming      timing;       /**< timestamps of the current message. */
+	uint64_t      input_time;   /**< when unparsed input was first added (0 = none). */
+	HMHistogram   *phase_hist;  /**< HM_PARSER_PHASES histograms, from a pool. */
+#ifdef HM_PARSER_STATS
+	HMParserStats stats;
+	HMParserStats stats_flushed; /**< part of `stats` already added to the global counters. */
+#endif
+	/* caller owned data from hm_parser_execute_external(). */
+	const char    *ext_data;
+	size_t        ext_len;
+	size_t        ext_off;      /**< bytes of `ext_data` that have been borrowed/copied. */
 	/* HTTP Message fields. */
 	hm_idx_t      url_idx;
-	hm_idx_t      headers_start;
-	hm_idx_t      headers_end;
 	hm_idx_t      body_start;
 	hm_idx_t      body_end;
+	/* first/last header index for each header id. */
+	hm_idx_t      header_first[HM_MAX_HEADER_IDS];
+	hm_idx_t      header_last[HM_MAX_HEADER_IDS];
 
+	hm_len_t      msg_off;      /**< offset of current message, when buffer is shared. */
 	hm_len_t      parsed_off;   /**< http parser offset. */
 	hm_len_t      buf_len;      /**< number of bytes in buffer. */
 	HMBuffer      *buf;         /**< buffer to hold raw http message. */
@@ -67,35 +138,168 @@ struct HMParser {
 	HMHeader tmp_header;
 };
 
+#ifdef HM_PARSER_STATS
+/* HMParserStats is only uint64_t counters. */
+#define HM_PARSER_STATS_COUNT (sizeof(HMParserStats) / sizeof(uint64_t))
+
+/* counters of all parsers, parsers can be used from different threads. */
+static HMParserStats hm_parser_global_stats;
+#endif
+
+/* add the counters since the last flush to the global counters. */
+static void hm_parser_flush_stats(HMParser *hm_parser) {
+#ifdef HM_PARSER_STATS
+	uint64_t *total = (uint64_t *)&hm_parser_global_stats;
+	uint64_t *stats = (uint64_t *)&(hm_parser->stats);
+	uint64_t *flushed = (uint64_t *)&(hm_parser->stats_flushed);
+	size_t idx;
+
+	for(idx = 0; idx < HM_PARSER_STATS_COUNT; idx++) {
+		if(stats[idx] != flushed[idx]) {
+			__sync_fetch_and_add(&(total[idx]), stats[idx] - flushed[idx]);
+			flushed[idx] = stats[idx];
+		}
+	}
+#else
+	(void)hm_parser;
+#endif
+}
+
+/* only reset the index entries that are in use, instead of clearing the whole index. */
+static void hm_parser_clear_header_index(HMParser *hm_parser) {
+	HMHeaderPiece *header = hm_parser->headers;
+	HMHeaderPiece *end = header + hm_array_count(hm_parser->headers);
+
+	for(; header < end; header++) {
+		hm_parser->header_first[header->name_id] = HM_PIECE_INVALID;
+	}
+}
+
 static void hm_parser_clear_message(HMParser *hm_parser) {
 	/* clear parser state. */
 	hm_parser->state = HM_PARSER_STATE_NONE;
 	hm_parser->last_id = hm_piece_none;
 	/* clear HTTP Message fields */
 	hm_array_set_count(hm_parser->pieces, 0);
+	hm_parser_clear_header_index(hm_parser);
+	hm_array_set_count(hm_parser->headers, 0);
 	hm_parser->url_idx = HM_PIECE_INVALID;
-	hm_parser->headers_start = HM_PIECE_INVALID;
-	hm_parser->headers_end = HM_PIECE_INVALID;
 	hm_parser->body_start = HM_PIECE_INVALID;
 	hm_parser->body_end = HM_PIECE_INVALID;
+	hm_parser->scan_msg = false;
+	hm_parser->scan_body = false;
+	hm_parser->body_off = 0;
+	hm_parser->body_len = 0;
+	hm_parser->limit = HM_PARSER_LIMIT_NONE;
+}
+
+/* place an empty array of `capacity` elements at `mem`. */
+static void *hm_parser_inline_array(uint8_t *mem, size_t capacity) {
+	HMArray *ary = (HMArray *)mem;
+	ary->count = 0;
+	ary->capacity = capacity;
+	return hm_array_to_void(ary);
+}
+
+/* allocate the parser and it's initial piece arrays as one cache aligned block. */
+static HMParser *hm_parser_alloc_single(HMAllocator *allocator) {
+	size_t pieces_off = CACHE_ALIGN(sizeof(HMParser));
+	size_t headers_off = pieces_off + CACHE_ALIGN(sizeof(HMArray) + sizeof(HMPiece) * INIT_PIECES);
+	size_t size = headers_off + CACHE_ALIGN(sizeof(HMArray) + sizeof(HMHeaderPiece) * INIT_HEADERS);
+	HMParser *hm_parser;
+	uint8_t *base;
+	uint8_t *mem;
+
+	/* the allocator doesn't know about alignment, over-allocate and align the block. */
+	base = (uint8_t *)hm_alloc_malloc(allocator, size + CACHE_LINE - 1);
+	if(base == NULL) {
+		return NULL;
+	}
+	mem = (uint8_t *)CACHE_ALIGN((uintptr_t)base);
+	hm_parser = (HMParser *)mem;
+	hm_parser->alloc_base = base;
+	hm_parser->alloc_size = size + CACHE_LINE - 1;
+	hm_parser->pieces = (HMPiece *)hm_parser_inline_array(mem + pieces_off, INIT_PIECES);
+	hm_parser->pieces_inline = true;
+	hm_parser->headers = (HMHeaderPiece *)hm_parser_inline_array(mem + headers_off, INIT_HEADERS);
+	hm_parser->headers_inline = true;
+	return hm_parser;
 }
 
-static HMParser *hm_parser_new(int is_request) {
+static HMParser *hm_parser_new(int is_request, uint32_t opts, HMAllocator *allocator) {
 	HMParser* hm_parser;
 	http_parser* parser;
 
-	hm_parser = (HMParser *)malloc(sizeof(HMParser));
+	if(!HM_PARSER_OPTS_VALID(opts)) {
+		return NULL;
+	}
+	if(allocator == NULL) {
+		allocator = hm_allocator_default();
+	}
+	if(opts & HM_PARSER_OPT_SINGLE_ALLOC) {
+		hm_parser = hm_parser_alloc_single(allocator);
+		if(hm_parser == NULL) {
+			return NULL;
+		}
+	} else {
+		hm_parser = (HMParser *)hm_alloc_malloc(allocator, sizeof(HMParser));
+		if(hm_parser == NULL) {
+			return NULL;
+		}
+		hm_parser->alloc_base = hm_parser;
+		hm_parser->alloc_size = sizeof(HMParser);
+		/* allocate piece arrays. */
+		hm_array_new(allocator, hm_parser->pieces, INIT_PIECES);
+		hm_parser->pieces_inline = false;
+		hm_array_new(allocator, hm_parser->headers, INIT_HEADERS);
+		hm_parser->headers_inline = false;
+		if(hm_parser->pieces == NULL || hm_parser->headers == NULL) {
+			hm_array_free(allocator, hm_parser->pieces);
+			hm_array_free(allocator, hm_parser->headers);
+			hm_alloc_free(allocator, hm_parser, sizeof(HMParser));
+			return NULL;
+		}
+	}
+	hm_parser->allocator = allocator;
 	/* init. http parser. */
 	parser = &(hm_parser->parser);
 	if(is_request) {
 		parser->type = HTTP_REQUEST;
 	} else {
 		parser->type = HTTP_RESPONSE;
+		/* the fast scanner only handles requests. */
+		opts &= ~HM_PARSER_OPT_FAST_SCAN;
 	}
-	/* allocate piece array. */
-	hm_array_new(hm_parser->pieces, INIT_PIECES);
+	hm_parser->opts = opts;
+	hm_parser->max_header_size = HM_PARSER_MAX_HEADER_SIZE;
+	memset(&(hm_parser->limits), 0, sizeof(HMParserLimits));
+	/* the batch arrays are allocated by the first batch. */
+	hm_parser->batch = NULL;
+	hm_parser->batch_len = 0;
+	hm_parser->batch_cap = 0;
+	hm_parser->batch_pieces = NULL;
+	hm_parser->batch_headers = NULL;
+	hm_parser->batch_data = NULL;
+	memset(hm_parser->header_first, 0xFF, sizeof(hm_parser->header_first));
 	/* allocate buffer. */
-	hm_parser->buf = hm_buffer_new(MIN_BUFFER_SPACE);
+	hm_parser->buf = hm_buffer_new_alloc(allocator, MIN_BUFFER_SPACE);
+	if(hm_parser->buf == NULL) {
+		if(!hm_parser->pieces_inline) {
+			hm_array_free(allocator, hm_parser->pieces);
+		}
+		if(!hm_parser->headers_inline) {
+			hm_array_free(allocator, hm_parser->headers);
+		}
+		hm_alloc_free(allocator, hm_parser->alloc_base, hm_parser->alloc_size);
+		return NULL;
+	}
+	hm_parser->buf_high = MIN_BUFFER_SPACE;
+	hm_parser->bytes_moved = 0;
+	hm_parser->phase_hist = NULL;
+#ifdef HM_PARSER_STATS
+	memset(&(hm_parser->stats), 0, sizeof(HMParserStats));
+	memset(&(hm_parser->stats_flushed), 0, sizeof(HMParserStats));
+#endif
 
 	/* initialize parser state. */
 	hm_parser_reset(hm_parser);
@@ -104,68 +308,421 @@ static HMParser *hm_parser_new(int is_request) {
 }
 
 HMParser *hm_parser_new_response() {
-	return hm_parser_new(0);
+	return hm_parser_new(0, HM_PARSER_OPT_NONE, NULL);
 }
 
 HMParser *hm_parser_new_request() {
-	return hm_parser_new(1);
+	return hm_parser_new(1, HM_PARSER_OPT_NONE, NULL);
+}
+
+HMParser *hm_parser_new_response_opts(uint32_t opts) {
+	return hm_parser_new(0, opts, NULL);
+}
+
+HMParser *hm_parser_new_request_opts(uint32_t opts) {
+	return hm_parser_new(1, opts, NULL);
+}
+
+HMParser *hm_parser_new_response_alloc(uint32_t opts, HMAllocator *allocator) {
+	return hm_parser_new(0, opts, allocator);
+}
+
+HMParser *hm_parser_new_request_alloc(uint32_t opts, HMAllocator *allocator) {
+	return hm_parser_new(1, opts, allocator);
+}
+
+size_t hm_parser_get_memory_used(HMParser *hm_parser) {
+	size_t size = hm_parser->alloc_size;
+
+	if(!hm_parser->pieces_inline) {
+		size += hm_array_size(hm_parser->pieces);
+	}
+	if(!hm_parser->headers_inline) {
+		size += hm_array_size(hm_parser->headers);
+	}
+	if(hm_parser->batch != NULL) {
+		size += sizeof(HMBatchMessage) * hm_parser->batch_cap;
+		size += hm_array_size(hm_parser->batch_pieces);
+		size += hm_array_size(hm_parser->batch_headers);
+	}
+	size += sizeof(HMBuffer) + hm_buffer_capacity(hm_parser->buf);
+	return size;
+}
+
+void hm_parser_set_max_header_size(HMParser *hm_parser, uint32_t size) {
+	hm_parser->max_header_size = size;
+}
+
+void hm_parser_set_max_buffer_size(HMParser *hm_parser, size_t size) {
+	hm_parser->limits.max_buffer = size;
+}
+
+void hm_parser_set_limits(HMParser *hm_parser, const HMParserLimits *limits) {
+	hm_parser->limits = *limits;
+}
+
+void hm_parser_get_limits(HMParser *hm_parser, HMParserLimits *limits) {
+	*limits = hm_parser->limits;
+}
+
+int hm_parser_limit(HMParser *hm_parser) {
+	return hm_parser->limit;
+}
+
+/* a limit was reached in a http_parser callback, the callback's error stops the parser. */
+static int hm_parser_limit_reached(HMParser *hm_parser, int limit) {
+	hm_parser->limit = limit;
+	hm_parser->state |= HM_PARSER_STATE_LIMIT;
+	return -1;
+}
+
+/* size of the header block up to the end of `data`, counted from the url or first header. */
+static size_t hm_parser_header_bytes(HMParser *hm_parser, const char *data, size_t len) {
+	size_t end = (data + len) - (const char *)hm_parser->parser.data;
+	size_t start = end - len;
+
+	if(hm_parser->url_idx != HM_PIECE_INVALID) {
+		start = hm_parser->pieces[hm_parser->url_idx].start;
+	} else if(hm_array_count(hm_parser->headers) > 0) {
+		start = hm_parser->headers[0].name.start;
+	}
+	return end - start;
+}
+
+/* switch to a new buffer, copy `len` bytes starting at `offset` from the old buffer. */
+static bool hm_parser_move_buffer(HMParser *hm_parser, size_t cap, size_t offset, size_t len) {
+	HMBuffer *old_buf = hm_parser->buf;
+	HMBuffer *buf = hm_buffer_new_alloc(hm_parser->allocator, cap);
+
+	if(buf == NULL) {
+		return false;
+	}
+	if(len > 0) {
+		memcpy(hm_buffer_data(buf), hm_buffer_data(old_buf) + offset, len);
+		hm_parser->bytes_moved += len;
+		HM_STAT_ADD(hm_parser, bytes_copied, len);
+	}
+	/* slices/messages still holding a reference will keep the old buffer alive. */
+	hm_buffer_unref(old_buf);
+	hm_parser->buf = buf;
+	hm_parser->parser.data = (char *)hm_buffer_data(buf);
+	return true;
+}
+
+/* stop parsing from the caller's memory, switch back to the (empty) buffer. */
+static void hm_parser_end_external(HMParser *hm_parser) {
+	hm_parser->is_external = false;
+	hm_parser->parser.data = (char *)hm_buffer_data(hm_parser->buf);
+	hm_parser->msg_off = 0;
+	hm_parser->parsed_off = 0;
+	hm_parser->buf_len = 0;
 }
 
 static void hm_parser_compact_buffer(HMParser *hm_parser, size_t offset) {
 	size_t len = hm_parser->buf_len;
 
+	if(hm_parser->is_external) {
+		/* never move the caller's data. */
+		if(offset < len) {
+			hm_parser->msg_off = offset;
+		} else {
+			hm_parser_end_external(hm_parser);
+		}
+		return;
+	}
 	/* Trim some data from the start of the buffer. */
 	if(offset < len) {
-		/* Compact the buffer. */
-		char *data = (char *)hm_buffer_data(hm_parser->buf);
-		len -= offset;
-		memmove(data, data + offset, len);
-		hm_parser->parsed_off -= offset;
-		hm_parser->buf_len = len;
+		/*
+		 * Keep parsing in-place, the unparsed data is only moved when the free space
+		 * at the end of the buffer is too small (slices/messages can also still be
+		 * using a shared buffer).
+		 */
+		hm_parser->msg_off = offset;
+		return;
 	} else {
 		/* Trimmed the whole buffer. */
+		if(hm_buffer_is_shared(hm_parser->buf)) {
+			/* don't re-use a buffer that is still referenced by slices/messages. */
+			if(!hm_parser_move_buffer(hm_parser, MIN_BUFFER_SPACE, 0, 0)) {
+				hm_parser->msg_off = offset;
+				return;
+			}
+		}
 		hm_parser->parsed_off = 0;
 		hm_parser->buf_len = 0;
 	}
+	hm_parser->msg_off = 0;
+}
+
+/* pieces are offsets from the start of the buffer, move them `off` bytes down. */
+static void hm_parser_shift_pieces(HMParser *hm_parser, size_t off) {
+	HMPiece *piece = hm_parser->pieces;
+	HMPiece *end = piece + hm_array_count(hm_parser->pieces);
+	HMHeaderPiece *header = hm_parser->headers;
+	HMHeaderPiece *headers_end = header + hm_array_count(hm_parser->headers);
+
+	for(; piece < end; piece++) {
+		piece->start -= off;
+		piece->end -= off;
+	}
+	for(; header < headers_end; header++) {
+		header->name.start -= off;
+		header->name.end -= off;
+		header->value.start -= off;
+		header->value.end -= off;
+	}
+	if(hm_parser->body_off > 0) {
+		hm_parser->body_off -= off;
+	}
+}
+
+/* move the current message to the start of a buffer with room for `len` more bytes. */
+static bool hm_parser_rebase_buffer(HMParser *hm_parser, size_t len) {
+	size_t msg_off = hm_parser->msg_off;
+	size_t msg_len = hm_parser->buf_len - msg_off;
+
+	if(hm_buffer_is_shared(hm_parser->buf)) {
+		size_t cap = msg_len + len;
+		if(cap < MIN_BUFFER_SPACE) cap = MIN_BUFFER_SPACE;
+		if(!hm_parser_move_buffer(hm_parser, cap, msg_off, msg_len)) {
+			return false;
+		}
+	} else {
+		char *data = (char *)hm_buffer_data(hm_parser->buf);
+		memmove(data, data + msg_off, msg_len);
+		hm_parser->bytes_moved += msg_len;
+		HM_STAT_ADD(hm_parser, bytes_moved, msg_len);
+	}
+	hm_parser_shift_pieces(hm_parser, msg_off);
+	hm_parser->parsed_off -= msg_off;
+	hm_parser->buf_len = msg_len;
+	hm_parser->msg_off = 0;
+	return true;
+}
+
+/* release the memory of a large buffer that is mostly empty. */
+static void hm_parser_shrink_buffer(HMParser *hm_parser) {
+	HMBuffer *buf = hm_parser->buf;
+	size_t cap = hm_buffer_capacity(buf);
+	size_t len = hm_parser->buf_len;
+	size_t new_cap;
+
+	if(cap <= MAX_IDLE_BUFFER || len > (cap / 4) || hm_parser->is_external ||
+			hm_parser->msg_off > 0 || hm_buffer_is_shared(buf)) {
+		return;
+	}
+	new_cap = len * 2;
+	if(new_cap < MIN_BUFFER_SPACE) new_cap = MIN_BUFFER_SPACE;
+	buf = hm_buffer_resize(buf, new_cap);
+	if(buf) {
+		hm_parser->buf = buf;
+		hm_parser->parser.data = (char *)hm_buffer_data(buf);
+	}
 }
 
 void hm_parser_next_message(HMParser *hm_parser) {
 	/* remove previous message from buffer. */
 	hm_parser_compact_buffer(hm_parser, hm_parser->parsed_off);
+	hm_parser_shrink_buffer(hm_parser);
+
+	hm_parser_clear_message(hm_parser);
+}
+
+/* offset of the first piece of an incomplete message (or the end of the parsed data). */
+static size_t hm_parser_pending_off(HMParser *hm_parser) {
+	size_t offset = hm_parser->parsed_off;
+
+	if(hm_array_count(hm_parser->pieces) > 0 && hm_parser->pieces[0].start < offset) {
+		offset = hm_parser->pieces[0].start;
+	}
+	if(hm_array_count(hm_parser->headers) > 0 && hm_parser->headers[0].name.start < offset) {
+		offset = hm_parser->headers[0].name.start;
+	}
+	return offset;
+}
+
+/* drop the batched messages and compact the buffer up to the next message. */
+static void hm_parser_clear_batch(HMParser *hm_parser) {
+	if(hm_parser->batch_len == 0) {
+		return;
+	}
+	hm_parser->batch_len = 0;
+	hm_array_set_count(hm_parser->batch_pieces, 0);
+	hm_array_set_count(hm_parser->batch_headers, 0);
+	hm_parser_compact_buffer(hm_parser, hm_parser_pending_off(hm_parser));
+	hm_parser_shrink_buffer(hm_parser);
+}
+
+/* make room for `n` more elements in a batch array. */
+static void *hm_parser_batch_grow(HMAllocator *allocator, void *ary_p, size_t elem_size,
+		size_t n, size_t init) {
+	size_t count = 0;
+	size_t cap = 0;
+
+	if(ary_p != NULL) {
+		count = hm_array_count(ary_p);
+		cap = hm_array_capacity(ary_p);
+		if(count + n <= cap) {
+			return ary_p;
+		}
+	}
+	if(cap == 0) cap = init;
+	while(cap < count + n) cap *= 2;
+	if(cap > UINT16_MAX) cap = UINT16_MAX;
+	return hm_array_resize_internal(allocator, ary_p, elem_size, cap);
+}
+
+static bool hm_parser_batch_reserve(HMParser *hm_parser, size_t pieces, size_t headers) {
+	HMAllocator *allocator = hm_parser->allocator;
+	void *ary;
+
+	ary = hm_parser_batch_grow(allocator, hm_parser->batch_pieces, sizeof(HMPiece),
+		pieces, INIT_BATCH_PIECES);
+	if(ary == NULL) return false;
+	hm_parser->batch_pieces = (HMPiece *)ary;
+	ary = hm_parser_batch_grow(allocator, hm_parser->batch_headers, sizeof(HMHeaderPiece),
+		headers, INIT_BATCH_HEADERS);
+	if(ary == NULL) return false;
+	hm_parser->batch_headers = (HMHeaderPiece *)ary;
+	/* allocated last, a batch means the piece arrays exist. */
+	if(hm_parser->batch_len >= hm_parser->batch_cap) {
+		uint32_t cap = (hm_parser->batch_cap > 0) ? hm_parser->batch_cap * 2 : INIT_BATCH;
+		ary = hm_alloc_realloc(allocator, hm_parser->batch,
+			sizeof(HMBatchMessage) * hm_parser->batch_cap, sizeof(HMBatchMessage) * cap);
+		if(ary == NULL) return false;
+		hm_parser->batch = (HMBatchMessage *)ary;
+		hm_parser->batch_cap = cap;
+	}
+	return true;
+}
 
+#define HM_BATCH_OK     0
+#define HM_BATCH_FULL   1
+#define HM_BATCH_ERROR  2
+
+/* record the completed message in the batch and start the next one in-place. */
+static int hm_parser_push_batch(HMParser *hm_parser) {
+	http_parser* parser = &(hm_parser->parser);
+	uint32_t count = hm_parser->batch_len;
+	uint32_t pieces = hm_array_count(hm_parser->pieces);
+	uint32_t headers = hm_array_count(hm_parser->headers);
+	HMBatchMessage *msg;
+
+	if(count >= MAX_BATCH || (count > 0 &&
+			(hm_array_count(hm_parser->batch_pieces) + pieces > UINT16_MAX ||
+			hm_array_count(hm_parser->batch_headers) + headers > UINT16_MAX))) {
+		return HM_BATCH_FULL;
+	}
+	if(!hm_parser_batch_reserve(hm_parser, pieces, headers)) {
+		return HM_BATCH_ERROR;
+	}
+	msg = hm_parser->batch + count;
+	hm_parser->batch_data = hm_parser->parser.data;
+	msg->pieces = hm_array_count(hm_parser->batch_pieces);
+	msg->headers = hm_array_count(hm_parser->batch_headers);
+	msg->count_pieces = pieces;
+	msg->count_headers = headers;
+	memcpy(hm_parser->batch_pieces + msg->pieces, hm_parser->pieces, sizeof(HMPiece) * pieces);
+	memcpy(hm_parser->batch_headers + msg->headers, hm_parser->headers,
+		sizeof(HMHeaderPiece) * headers);
+	hm_array_set_count(hm_parser->batch_pieces, msg->pieces + pieces);
+	hm_array_set_count(hm_parser->batch_headers, msg->headers + headers);
+	/* HTTP Message fields, the body pieces are always last. */
+	msg->url_idx = hm_parser->url_idx;
+	msg->body_start = hm_parser->body_start;
+	msg->body_end = (msg->body_start != HM_PIECE_INVALID) ? pieces : HM_PIECE_INVALID;
+	/* copy info from http_parser. */
+	msg->http_major = parser->http_major;
+	msg->http_minor = parser->http_minor;
+	msg->status_code = parser->status_code;
+	msg->method = parser->method;
+	msg->keep_alive = hm_parser_should_keep_alive(hm_parser) ? 1 : 0;
+	msg->upgrade = parser->upgrade;
+	msg->taken = 0;
+	msg->timing = hm_parser->timing;
+	hm_parser->batch_len = count + 1;
+
+	/* the message stays in the buffer until the batch is cleared. */
 	hm_parser_clear_message(hm_parser);
+	return HM_BATCH_OK;
 }
 
-void hm_parser_reset(HMParser* hm_parser) {
+bool hm_parser_reset(HMParser* hm_parser) {
 	http_parser* parser = &(hm_parser->parser);
+	bool moved = true;
 
 	http_parser_init(parser, parser->type);
-	parser->data = (char *)hm_buffer_data(hm_parser->buf);
+	hm_parser_clear_batch(hm_parser);
+	hm_parser->is_external = false;
+	/* don't re-use a buffer that is still referenced by slices. */
+	if(hm_buffer_is_shared(hm_parser->buf)) {
+		moved = hm_parser_move_buffer(hm_parser, MIN_BUFFER_SPACE, 0, 0);
+	}
 	/* clear buffer state. */
-	hm_parser->parsed_off = 0;
-	hm_parser->buf_len = 0;
+	if(moved) {
+		hm_parser->buf_len = 0;
+	} else {
+		/* no new buffer: treat the old one as full, so the referenced bytes aren't overwritten. */
+		hm_parser->buf_len = hm_buffer_capacity(hm_parser->buf);
+	}
+	hm_parser->msg_off = hm_parser->buf_len;
+	hm_parser->parsed_off = hm_parser->buf_len;
+	hm_parser_shrink_buffer(hm_parser);
+	parser->data = (char *)hm_buffer_data(hm_parser->buf);
+	hm_parser->wait_off = 0;
 	hm_parser->is_eof = false;
+	hm_parser->is_closed = false;
+	hm_parser->ext_data = NULL;
+	hm_parser->ext_len = 0;
+	hm_parser->ext_off = 0;
+	memset(&(hm_parser->timing), 0, sizeof(HMTiming));
+	hm_parser->input_time = 0;
 
 	hm_parser_clear_message(hm_parser);
+	if(!moved) {
+		/* unusable until the next reset. */
+		parser->http_errno = HPE_UNKNOWN;
+		hm_parser->state = HM_PARSER_STATE_ERROR;
+	}
+	return moved;
 }
 
 void hm_parser_free(HMParser* hm_parser) {
-	hm_buffer_free(hm_parser->buf);
+	HMAllocator *allocator = hm_parser->allocator;
+
+	hm_parser_flush_stats(hm_parser);
+	hm_alloc_free(allocator, hm_parser->batch, sizeof(HMBatchMessage) * hm_parser->batch_cap);
+	hm_array_free(allocator, hm_parser->batch_pieces);
+	hm_array_free(allocator, hm_parser->batch_headers);
+	hm_buffer_unref(hm_parser->buf);
 	hm_parser->buf = NULL;
-	hm_array_free(hm_parser->pieces);
+	if(!hm_parser->pieces_inline) {
+		hm_array_free(allocator, hm_parser->pieces);
+	}
 	hm_parser->pieces = NULL;
-	free(hm_parser);
+	if(!hm_parser->headers_inline) {
+		hm_array_free(allocator, hm_parser->headers);
+	}
+	hm_parser->headers = NULL;
+	hm_alloc_free(allocator, hm_parser->alloc_base, hm_parser->alloc_size);
 }
 
-/* in-place string tolower, for HTTP headers. */
-static void hm_str_lower(char *p, size_t len) {
-	char *p_end = p + len;
-	for(; p < p_end; p++) {
-		char c = *p;
-		if(c >= 'A' && c <= 'Z') {
-			*p = c + 32;
-		}
+/* copy the elements of array `src` into array `dst`, which must be large enough. */
+static void *hm_parser_copy_array(void *dst, void *src, size_t elem_size) {
+	size_t count = hm_array_count(src);
+	memcpy(dst, src, elem_size * count);
+	hm_array_set_count(dst, count);
+	return dst;
+}
+
+/* move an inline array to the heap, so it can be resized. */
+static void *hm_parser_uninline_array(HMAllocator *allocator, void *ary_p, size_t elem_size,
+		size_t capacity) {
+	void *new_p = hm_array_resize_internal(allocator, NULL, elem_size, capacity);
+	if(new_p != NULL) {
+		hm_parser_copy_array(new_p, ary_p, elem_size);
 	}
+	return new_p;
 }
 
 #define HM_PARSER_ARY_GROW_CHECK(hm_parser, _ary, _idx, _grow, _max) do { \
@@ -180,8 +737,15 @@ static void hm_str_lower(char *p, size_t len) {
 		} else { \
 			cap += (_grow); \
 			if(cap > (_max)) cap = (_max); \
-			hm_array_resize(ary, cap); \
-			if(ary == NULL) return -1; \
+			HM_STAT_ADD(hm_parser, array_grows, 1); \
+			if((hm_parser)->_ary##_inline) { \
+				ary = hm_parser_uninline_array((hm_parser)->allocator, ary, sizeof(ary[0]), cap); \
+				if(ary == NULL) return -1; \
+				(hm_parser)->_ary##_inline = false; \
+			} else { \
+				hm_array_resize((hm_parser)->allocator, ary, cap); \
+				if(ary == NULL) return -1; \
+			} \
 			(hm_parser)->_ary = ary; \
 		} \
 	} \
@@ -191,6 +755,31 @@ static void hm_str_lower(char *p, size_t len) {
 #define HM_PARSER_PIECES_GROW_CHECK(hm_parser, _idx) \
 	HM_PARSER_ARY_GROW_CHECK(hm_parser, pieces, _idx, GROW_PIECES, MAX_PIECES)
 
+#define HM_PARSER_HEADERS_GROW_CHECK(hm_parser, _idx) \
+	HM_PARSER_ARY_GROW_CHECK(hm_parser, headers, _idx, GROW_HEADERS, MAX_HEADERS)
+
+/* append data to the end of a piece. */
+static void http_append_piece(http_parser* parser, HMPiece *piece, const char *data, size_t len) {
+	HMParser *hm_parser = (HMParser*)parser;
+	size_t start = data - (const char *)parser->data;
+	size_t end = piece->end;
+
+	/* check for buffer gaps. */
+	if(end != start) {
+		if(hm_parser->is_external) {
+			/* the caller's data is read-only, keep the gap (folded header value). */
+			piece->end = start + len;
+			return;
+		}
+		char *end_ptr = ((char *)parser->data) + end;
+		/* close gap for this piece. */
+		memmove(end_ptr, data, len);
+		hm_parser->bytes_moved += len;
+		HM_STAT_ADD(hm_parser, bytes_moved, len);
+	}
+	piece->end = end + len;
+}
+
 /* push piece. */
 static int http_push_piece(http_parser* parser, hm_piece_t piece_id, const char *data, size_t len) {
 	HMParser *hm_parser = (HMParser*)parser;
@@ -203,25 +792,17 @@ static int http_push_piece(http_parser* parser, hm_piece_t piece_id, const char
 	/* check if we need to append data to last piece. */
 	if(hm_parser->last_id == piece_id) {
 		append_to_last = true;
-		/* don't merge large body pieces. */
-		if(piece_id == hm_piece_body && len > 512) {
+		/* don't merge large body pieces, or body pieces with a gap in read-only data. */
+		if(piece_id == hm_piece_body && (len > 512 || (hm_parser->is_external &&
+				hm_parser->pieces[hm_array_count(hm_parser->pieces) - 1].end != start))) {
 			append_to_last = false;
 		}
 	}
 
 	if(append_to_last) {
-		size_t end;
 		/* append data to last piece. */
 		idx = hm_array_count(hm_parser->pieces) - 1;
-		piece = hm_parser->pieces + idx;
-		/* check for buffer gaps. */
-		end = piece->end;
-		if(end != start) {
-			char *end_ptr = ((char *)parser->data) + end;
-			/* close gap for this piece. */
-			memmove(end_ptr, data, len);
-		}
-		piece->end = end + len;
+		http_append_piece(parser, hm_parser->pieces + idx, data, len);
 		return 0;
 	}
 
@@ -244,6 +825,12 @@ static int hm_parser_message_begin_cb(http_parser* parser) {
 	}
 	hm_parser->state = HM_PARSER_STATE_MESSAGE_BEGIN;
 	hm_parser->last_id = hm_piece_none;
+	if(hm_parser->opts & HM_PARSER_OPT_TIMING) {
+		uint64_t now = hm_histogram_now();
+		memset(&(hm_parser->timing), 0, sizeof(HMTiming));
+		hm_parser->timing.first_byte = (hm_parser->input_time > 0) ? hm_parser->input_time : now;
+		hm_parser->timing.message_begin = now;
+	}
 	return 0;
 }
 
@@ -256,44 +843,162 @@ static int hm_parser_status_complete_cb(http_parser* parser) {
 
 static int hm_parser_url_cb(http_parser* parser, const char* data, size_t len) {
 	HMParser *hm_parser = (HMParser*)parser;
+	HMPiece *url;
 	hm_parser->state = HM_PARSER_STATE_URL;
 	if(hm_parser->url_idx == HM_PIECE_INVALID) {
 		hm_parser->url_idx = hm_array_count(hm_parser->pieces);
 	}
-	return http_push_piece(parser, hm_piece_url, data, len);
+	if(http_push_piece(parser, hm_piece_url, data, len) < 0) {
+		return -1;
+	}
+	url = hm_parser->pieces + hm_parser->url_idx;
+	if(hm_parser->limits.max_url > 0 && (url->end - url->start) > hm_parser->limits.max_url) {
+		return hm_parser_limit_reached(hm_parser, HM_PARSER_LIMIT_URL);
+	}
+	return 0;
+}
+
+/* in-place string tolower, for HTTP headers. */
+static void hm_str_lower(char *p, size_t len) {
+	char *p_end = p + len;
+	for(; p < p_end; p++) {
+		char c = *p;
+		if(c >= 'A' && c <= 'Z') {
+			*p = c + 32;
+		}
+	}
+}
+
+/* header name is complete, resolve it's id while the name is still in cache. */
+static void hm_parser_close_header_name(HMParser *hm_parser, hm_idx_t idx) {
+	HMHeaderPiece *header = hm_parser->headers + idx;
+	char *name = hm_parser->parser.data + header->name.start;
+	size_t name_len = header->name.end - header->name.start;
+	const hm_header_id *id;
+
+	/* lookup header in id map. */
+	id = hm_header_ids_lookup(name, name_len);
+	if(id && id->id > 0 && id->id < HM_MAX_HEADER_IDS) {
+		/* found common header, use id for faster processing. */
+		HM_STAT_ADD(hm_parser, header_id_hits, 1);
+		header->name_id = id->id;
+		/* add header to the end of the list of headers with this id. */
+		if(hm_parser->header_first[id->id] == HM_PIECE_INVALID) {
+			hm_parser->header_first[id->id] = idx;
+		} else {
+			hm_parser->headers[hm_parser->header_last[id->id]].next = idx;
+		}
+		hm_parser->header_last[id->id] = idx;
+	} else {
+		HM_STAT_ADD(hm_parser, header_id_misses, 1);
+		/*
+		 * Convert unknown HTTP headers to lower case (caller owned data is read-only).
+		 */
+		if(!hm_parser->is_external) {
+			hm_str_lower(name, name_len);
+		}
+		header->name_id = 0;
+	}
 }
 
 static int hm_parser_header_field_cb(http_parser* parser, const char* data, size_t len) {
 	HMParser *hm_parser = (HMParser*)parser;
+	HMHeaderPiece *header;
+	uint32_t idx;
+	hm_len_t start;
+
 	if(hm_parser->state >= HM_PARSER_STATE_HEADERS_COMPLETE) {
 		/* ignore Trailers for now. */
 		return 0;
 	}
 	hm_parser->state = HM_PARSER_STATE_HEADERS;
-	if(hm_parser->headers_start == HM_PIECE_INVALID) {
-		hm_parser->headers_start = hm_array_count(hm_parser->pieces);
-		hm_parser->headers_end = hm_parser->headers_start;
+	if(hm_parser->limits.max_header_size > 0 &&
+			hm_parser_header_bytes(hm_parser, data, len) > hm_parser->limits.max_header_size) {
+		return hm_parser_limit_reached(hm_parser, HM_PARSER_LIMIT_HEADER_SIZE);
+	}
+	if(hm_parser->last_id == hm_piece_header_field) {
+		/* append data to the header name. */
+		idx = hm_array_count(hm_parser->headers) - 1;
+		http_append_piece(parser, &(hm_parser->headers[idx].name), data, len);
+		return 0;
 	}
-	return http_push_piece(parser, hm_piece_header_field, data, len);
+
+	/* start new header. */
+	if(hm_parser->limits.max_headers > 0 &&
+			hm_array_count(hm_parser->headers) >= hm_parser->limits.max_headers) {
+		return hm_parser_limit_reached(hm_parser, HM_PARSER_LIMIT_HEADERS);
+	}
+	HM_PARSER_HEADERS_GROW_CHECK(hm_parser, idx);
+
+	hm_parser->last_id = hm_piece_header_field;
+
+	/* initialize new header, the value is empty until it is parsed. */
+	header = hm_parser->headers + idx;
+	start = data - (const char *)parser->data;
+	header->name.start = start;
+	header->name.end = start + len;
+	header->value.start = header->value.end = start + len;
+	header->name_id = 0;
+	header->next = HM_PIECE_INVALID;
+	return 0;
 }
 
 static int hm_parser_header_value_cb(http_parser* parser, const char* data, size_t len) {
 	HMParser *hm_parser = (HMParser*)parser;
+	HMHeaderPiece *header;
+	uint32_t count;
+	hm_len_t start;
+
 	if(hm_parser->state >= HM_PARSER_STATE_HEADERS_COMPLETE) {
 		/* ignore Trailers for now. */
 		return 0;
 	}
 	hm_parser->state = HM_PARSER_STATE_HEADERS;
-	return http_push_piece(parser, hm_piece_header_value, data, len);
+	if(hm_parser->limits.max_header_size > 0 &&
+			hm_parser_header_bytes(hm_parser, data, len) > hm_parser->limits.max_header_size) {
+		return hm_parser_limit_reached(hm_parser, HM_PARSER_LIMIT_HEADER_SIZE);
+	}
+	count = hm_array_count(hm_parser->headers);
+	if(count == 0) {
+		/* value without a header name. */
+		return 0;
+	}
+	header = hm_parser->headers + (count - 1);
+	if(hm_parser->last_id == hm_piece_header_value) {
+		/* append data to the header value. */
+		http_append_piece(parser, &(header->value), data, len);
+		return 0;
+	}
+	if(hm_parser->last_id == hm_piece_header_field) {
+		hm_parser_close_header_name(hm_parser, count - 1);
+	}
+	hm_parser->last_id = hm_piece_header_value;
+
+	start = data - (const char *)parser->data;
+	header->value.start = start;
+	header->value.end = start + len;
+	return 0;
 }
 
+static size_t hm_parser_body_left(HMParser *hm_parser);
+
 static int hm_parser_headers_complete_cb(http_parser* parser) {
 	HMParser *hm_parser = (HMParser*)parser;
+	uint32_t count;
+
+	/* header without a value. */
+	if(hm_parser->last_id == hm_piece_header_field) {
+		count = hm_array_count(hm_parser->headers);
+		hm_parser_close_header_name(hm_parser, count - 1);
+	}
 	hm_parser->state = HM_PARSER_STATE_HEADERS_COMPLETE;
 	hm_parser->last_id = hm_piece_none;
-	/* mark end of headers. */
-	if(hm_parser->headers_start != HM_PIECE_INVALID) {
-		hm_parser->headers_end = hm_array_count(hm_parser->pieces);
+	if(hm_parser->opts & HM_PARSER_OPT_TIMING) {
+		hm_parser->timing.headers_complete = hm_histogram_now();
+	}
+	/* reject a large Content-Length before any of the body is buffered. */
+	if(hm_parser->limits.max_body > 0 && hm_parser_body_left(hm_parser) > hm_parser->limits.max_body) {
+		return hm_parser_limit_reached(hm_parser, HM_PARSER_LIMIT_BODY);
 	}
 	if(parser->type == HTTP_RESPONSE) {
 		http_parser_pause(parser, 1);
@@ -305,6 +1010,17 @@ static int hm_parser_body_cb(http_parser* parser, const char* data, size_t len)
 	HMParser *hm_parser = (HMParser*)parser;
 	hm_parser->state = HM_PARSER_STATE_BODY;
 	if(len == 0) return 0;
+	hm_parser->body_len += len;
+	if(hm_parser->limits.max_body > 0 && hm_parser->body_len > hm_parser->limits.max_body) {
+		return hm_parser_limit_reached(hm_parser, HM_PARSER_LIMIT_BODY);
+	}
+	if(hm_parser->body_off == 0) {
+		hm_parser->body_off = data - (const char *)parser->data;
+	}
+	if(hm_parser->opts & HM_PARSER_OPT_DISCARD_BODY) {
+		/* don't keep body pieces, the bytes are dropped by hm_parser_reclaim_body(). */
+		return 0;
+	}
 	/* mark start of body pieces. */
 	if(hm_parser->body_start == HM_PIECE_INVALID) {
 		hm_parser->body_start = hm_array_count(hm_parser->pieces);
@@ -314,37 +1030,319 @@ static int hm_parser_body_cb(http_parser* parser, const char* data, size_t len)
 	return http_push_piece(parser, hm_piece_body, data, len);
 }
 
+/* stamp the end of a message and record it's phases. */
+static void hm_parser_timing_complete(HMParser *hm_parser) {
+	HMTiming *timing = &(hm_parser->timing);
+	HMHistogram *hist = hm_parser->phase_hist;
+
+	timing->message_complete = hm_histogram_now();
+	/* data after this message is timed from when the parser reaches it. */
+	hm_parser->input_time = 0;
+	if(hist != NULL) {
+		hm_histogram_record(&hist[HM_PARSER_PHASE_BEGIN], timing->message_begin - timing->first_byte);
+		hm_histogram_record(&hist[HM_PARSER_PHASE_HEADERS], timing->headers_complete - timing->first_byte);
+		hm_histogram_record(&hist[HM_PARSER_PHASE_COMPLETE], timing->message_complete - timing->first_byte);
+	}
+}
+
 static int hm_parser_message_complete_cb(http_parser* parser) {
 	HMParser *hm_parser = (HMParser*)parser;
+	if(hm_parser->opts & HM_PARSER_OPT_TIMING) {
+		hm_parser_timing_complete(hm_parser);
+	}
 	hm_parser->state = HM_PARSER_STATE_MESSAGE_COMPLETE;
+	hm_parser->is_closed = !http_should_keep_alive(parser);
 	hm_parser->last_id = hm_piece_none;
+	/* in batch mode keep parsing the next message, unless the batch is full. */
+	if((hm_parser->opts & HM_PARSER_OPT_BATCH) && !parser->upgrade &&
+			hm_parser_push_batch(hm_parser) == HM_BATCH_OK) {
+		return 0;
+	}
 	http_parser_pause(parser, 1);
 	return 0;
 }
 
-static int hm_parser_resume_parse(HMParser *hm_parser, char *data, size_t data_len) {
-	http_parser*  parser = &(hm_parser->parser);
+/*
+ * Fast scanner.
+ *
+ * Parses requests when the whole header block is already in the buffer, producing the
+ * same pieces and states as the http_parser callbacks.  Anything uncommon is left
+ * to http_parser.
+ */
+#define HM_SCAN_FALLBACK (-2)
+
+static int hm_parser_scan_method(const char *p, size_t len) {
+	switch(len) {
+	case 3:
+		if(memcmp(p, "GET", 3) == 0) return HTTP_GET;
+		if(memcmp(p, "PUT", 3) == 0) return HTTP_PUT;
+		break;
+	case 4:
+		if(memcmp(p, "POST", 4) == 0) return HTTP_POST;
+		if(memcmp(p, "HEAD", 4) == 0) return HTTP_HEAD;
+		break;
+	case 6:
+		if(memcmp(p, "DELETE", 6) == 0) return HTTP_DELETE;
+		break;
+	case 7:
+		if(memcmp(p, "OPTIONS", 7) == 0) return HTTP_OPTIONS;
+		break;
+	default:
+		break;
+	}
+	return -1;
+}
 
-	static const http_parser_settings settings = {
-		.on_message_begin    = hm_parser_message_begin_cb,
-		.on_url              = hm_parser_url_cb,
-		.on_status_complete  = hm_parser_status_complete_cb,
-		.on_header_field     = hm_parser_header_field_cb,
-		.on_header_value     = hm_parser_header_value_cb,
-		.on_headers_complete = hm_parser_headers_complete_cb,
-		.on_body             = hm_parser_body_cb,
-		.on_message_complete = hm_parser_message_complete_cb
-	};
+static bool hm_str_ieq(const char *p, size_t len, const char *lower, size_t lower_len) {
+	size_t i;
+	if(len != lower_len) return false;
+	for(i = 0; i < len; i++) {
+		char c = p[i];
+		if(c >= 'A' && c <= 'Z') c += 32;
+		if(c != lower[i]) return false;
+	}
+	return true;
+}
 
-	/* resume http parser. */
-	size_t nparsed = http_parser_execute(parser, &settings, data, data_len);
-	if(nparsed > 0) {
-		hm_parser->parsed_off += nparsed;
-		if(hm_parser->state == HM_PARSER_STATE_HEADERS) {
-			hm_parser->headers_end = hm_array_count(hm_parser->pieces);
+/* add a complete header. */
+static int hm_parser_scan_push_header(HMParser *hm_parser, const char *name, const char *name_end,
+		const char *value, const char *value_end) {
+	const char *data = (const char *)hm_parser->parser.data;
+	HMHeaderPiece *header;
+	uint32_t idx;
+
+	/* let http_parser report the limit. */
+	if(hm_parser->limits.max_headers > 0 &&
+			hm_array_count(hm_parser->headers) >= hm_parser->limits.max_headers) {
+		return -1;
+	}
+	HM_PARSER_HEADERS_GROW_CHECK(hm_parser, idx);
+
+	header = hm_parser->headers + idx;
+	header->name.start = name - data;
+	header->name.end = name_end - data;
+	header->value.start = value - data;
+	header->value.end = value_end - data;
+	header->next = HM_PIECE_INVALID;
+	hm_parser_close_header_name(hm_parser, idx);
+	return idx;
+}
+
+/* parse request line & headers, returns number of bytes parsed. */
+static int hm_parser_scan_headers(HMParser *hm_parser, char *data, size_t len) {
+	http_parser *parser = &(hm_parser->parser);
+	const char *p = data;
+	const char *end = data + len;
+	const char *tok;
+	const char *value;
+	int method;
+	int minor;
+	int idx;
+	int connection = 0; /* 1 = keep-alive, -1 = close */
+	int rc;
+	bool has_length = false;
+	uint32_t content_length = 0;
+#ifdef HM_PARSER_STATS
+	/* header ids are counted again by http_parser after a fallback. */
+	uint64_t id_hits = hm_parser->stats.header_id_hits;
+	uint64_t id_misses = hm_parser->stats.header_id_misses;
+#endif
+
+	/* method */
+	tok = hm_scan_token(p, end);
+	if(tok == end || *tok != ' ') return HM_SCAN_FALLBACK;
+	method = hm_parser_scan_method(p, tok - p);
+	if(method < 0) return HM_SCAN_FALLBACK;
+	p = tok + 1;
+	/* url */
+	tok = hm_scan_url(p, end);
+	if(tok == p || tok == end || *tok != ' ') return HM_SCAN_FALLBACK;
+	value = p;
+	p = tok + 1;
+	/* version */
+	if(end - p < 10 || memcmp(p, "HTTP/1.", 7) != 0 || (p[7] != '0' && p[7] != '1') ||
+			p[8] != '\r' || p[9] != '\n') {
+		return HM_SCAN_FALLBACK;
+	}
+	minor = p[7] - '0';
+	p += 10;
+
+	hm_parser_message_begin_cb(parser);
+	hm_parser->scan_msg = true;
+	if(hm_parser_url_cb(parser, value, tok - value) < 0) goto fallback;
+	hm_parser->state = HM_PARSER_STATE_HEADERS;
+
+	/* headers */
+	for(;;) {
+		const char *name = p;
+		if(p >= end) goto fallback;
+		if(*p == '\r') {
+			if(end - p < 2 || p[1] != '\n') goto fallback;
+			p += 2;
+			break;
 		}
-		if(hm_parser->state == HM_PARSER_STATE_BODY) {
-			hm_parser->body_end = hm_array_count(hm_parser->pieces);
+		/* obs-fold and bad header names are left to http_parser. */
+		tok = hm_scan_token(p, end);
+		if(tok == p || tok == end || *tok != ':') goto fallback;
+		p = tok + 1;
+		while(p < end && (*p == ' ' || *p == '\t')) p++;
+		value = p;
+		p = hm_scan_value(p, end);
+		if(end - p < 2 || p[0] != '\r' || p[1] != '\n') goto fallback;
+		if(hm_parser->limits.max_header_size > 0 &&
+				hm_parser_header_bytes(hm_parser, p, 2) > hm_parser->limits.max_header_size) {
+			goto fallback;
+		}
+		idx = hm_parser_scan_push_header(hm_parser, name, tok, value, p);
+		if(idx < 0) goto fallback;
+		switch(hm_parser->headers[idx].name_id) {
+		case HM_HEADER_CONTENT_LENGTH:
+			if(has_length || p == value || p - value > 9) goto fallback;
+			has_length = true;
+			for(tok = value; tok < p; tok++) {
+				if(*tok < '0' || *tok > '9') goto fallback;
+				content_length = (content_length * 10) + (*tok - '0');
+			}
+			break;
+		case HM_HEADER_CONNECTION:
+			if(hm_str_ieq(value, p - value, "keep-alive", 10)) {
+				connection = 1;
+			} else if(hm_str_ieq(value, p - value, "close", 5)) {
+				connection = -1;
+			} else {
+				goto fallback;
+			}
+			break;
+		case HM_HEADER_TRANSFER_ENCODING:
+		case HM_HEADER_UPGRADE:
+		case HM_HEADER_PROXY_CONNECTION:
+			goto fallback;
+		default:
+			break;
+		}
+		p += 2;
+	}
+
+	/* update http_parser fields used by the info methods. */
+	parser->method = method;
+	parser->http_major = 1;
+	parser->http_minor = minor;
+	parser->status_code = 0;
+	parser->upgrade = 0;
+	if(minor > 0) {
+		hm_parser->keep_alive = (connection >= 0);
+	} else {
+		hm_parser->keep_alive = (connection > 0);
+	}
+	hm_parser->body_left = content_length;
+	hm_parser->scan_body = true;
+	rc = hm_parser_headers_complete_cb(parser);
+	hm_parser->scan_body = false;
+	if(rc < 0) goto fallback;
+	return p - data;
+
+fallback:
+#ifdef HM_PARSER_STATS
+	hm_parser->stats.header_id_hits = id_hits;
+	hm_parser->stats.header_id_misses = id_misses;
+#endif
+	hm_parser_clear_message(hm_parser);
+	return HM_SCAN_FALLBACK;
+}
+
+static int hm_parser_scan_execute(HMParser *hm_parser, char *data, size_t data_len) {
+	http_parser*  parser = &(hm_parser->parser);
+	size_t nparsed = 0;
+	size_t len;
+	int rc;
+
+	if(!hm_parser->scan_body) {
+		uint32_t state = hm_parser->state;
+		/*
+		 * only start at a message boundary.  Data after a 'Connection: close' message
+		 * is left to http_parser.
+		 */
+		if(data_len == 0 || hm_parser->is_closed ||
+				(state != HM_PARSER_STATE_NONE && state != HM_PARSER_STATE_MESSAGE_COMPLETE)) {
+			return HM_SCAN_FALLBACK;
+		}
+		rc = hm_parser_scan_headers(hm_parser, data, data_len);
+		if(rc < 0) {
+			return rc;
+		}
+		HM_STAT_ADD(hm_parser, fast_scans, 1);
+		nparsed = rc;
+	} else if(data_len == 0) {
+		/* EOF before the end of the body. */
+		parser->http_errno = HPE_INVALID_EOF_STATE;
+		hm_parser->state |= HM_PARSER_STATE_ERROR;
+		return -1;
+	}
+	/* body */
+	len = data_len - nparsed;
+	if(len > hm_parser->body_left) {
+		len = hm_parser->body_left;
+	}
+	if(len > 0) {
+		if(hm_parser_body_cb(parser, data + nparsed, len) < 0) {
+			parser->http_errno = HPE_CB_body;
+			hm_parser->state |= HM_PARSER_STATE_ERROR;
+			return -1;
+		}
+		hm_parser->body_end = hm_array_count(hm_parser->pieces);
+		hm_parser->body_left -= len;
+		nparsed += len;
+	}
+	HM_STAT_ADD(hm_parser, bytes_parsed, nparsed);
+	hm_parser->parsed_off += nparsed;
+	if(hm_parser->body_left > 0) {
+		hm_parser->scan_body = true;
+		return nparsed;
+	}
+	/* message complete. */
+	if(hm_parser->opts & HM_PARSER_OPT_TIMING) {
+		hm_parser_timing_complete(hm_parser);
+	}
+	hm_parser->scan_body = false;
+	hm_parser->state = HM_PARSER_STATE_MESSAGE_COMPLETE;
+	hm_parser->last_id = hm_piece_none;
+	hm_parser->is_closed = !hm_parser->keep_alive;
+	/* same as a paused http_parser. */
+	if(hm_parser->parsed_off == hm_parser->buf_len) {
+		hm_parser->state |= HM_PARSER_STATE_NEEDS_INPUT;
+	}
+	return -1;
+}
+
+static int hm_parser_resume_parse(HMParser *hm_parser, char *data, size_t data_len) {
+	http_parser*  parser = &(hm_parser->parser);
+
+	if(hm_parser->opts & HM_PARSER_OPT_FAST_SCAN) {
+		int rc = hm_parser_scan_execute(hm_parser, data, data_len);
+		if(rc != HM_SCAN_FALLBACK) {
+			return rc;
+		}
+	}
+
+	static const http_parser_settings settings = {
+		.on_message_begin    = hm_parser_message_begin_cb,
+		.on_url              = hm_parser_url_cb,
+		.on_status_complete  = hm_parser_status_complete_cb,
+		.on_header_field     = hm_parser_header_field_cb,
+		.on_header_value     = hm_parser_header_value_cb,
+		.on_headers_complete = hm_parser_headers_complete_cb,
+		.on_body             = hm_parser_body_cb,
+		.on_message_complete = hm_parser_message_complete_cb
+	};
+
+	/* resume http parser. */
+	size_t nparsed = http_parser_execute(parser, &settings, data, data_len);
+	HM_STAT_ADD(hm_parser, execute_calls, 1);
+	HM_STAT_ADD(hm_parser, bytes_parsed, nparsed);
+	if(nparsed > 0) {
+		hm_parser->parsed_off += nparsed;
+		if(hm_parser->state == HM_PARSER_STATE_BODY) {
+			hm_parser->body_end = hm_array_count(hm_parser->pieces);
 		}
 	}
 	/* check for error. */
@@ -352,6 +1350,7 @@ static int hm_parser_resume_parse(HMParser *hm_parser, char *data, size_t data_l
 		/* check if parser was paused. */
 		if(parser->http_errno == HPE_PAUSED) {
 			/* resume parser. */
+			HM_STAT_ADD(hm_parser, pauses, 1);
 			http_parser_pause(parser, 0);
 			/* check if buffer is also empty. */
 			if(hm_parser->parsed_off == hm_parser->buf_len) {
@@ -367,14 +1366,152 @@ static int hm_parser_resume_parse(HMParser *hm_parser, char *data, size_t data_l
 	return nparsed;
 }
 
-size_t hm_parser_prepare_buffer(HMParser *hm_parser, size_t len) {
+/* drop body bytes that have already been parsed & consumed. */
+static void hm_parser_reclaim_body(HMParser *hm_parser) {
+	size_t body_off = hm_parser->body_off;
+	size_t parsed_off = hm_parser->parsed_off;
+	size_t tail = hm_parser->buf_len - parsed_off;
+	char *data = (char *)hm_buffer_data(hm_parser->buf);
+
+	/* only in the body of a message and after all body pieces have been consumed. */
+	if((hm_parser->state & ~HM_PARSER_STATE_NEEDS_INPUT) != HM_PARSER_STATE_BODY ||
+			body_off == 0 || parsed_off <= body_off || hm_parser->body_start != HM_PIECE_INVALID) {
+		return;
+	}
+	if(hm_buffer_is_shared(hm_parser->buf)) {
+		/* slices reference the body, copy the headers & unparsed data to a new buffer. */
+		size_t msg_off = hm_parser->msg_off;
+		size_t head = body_off - msg_off;
+		HMBuffer *buf = hm_buffer_new_alloc(hm_parser->allocator, hm_buffer_capacity(hm_parser->buf));
+		if(buf == NULL) {
+			return;
+		}
+		memcpy(hm_buffer_data(buf), data + msg_off, head);
+		memcpy(hm_buffer_data(buf) + head, data + parsed_off, tail);
+		hm_parser->bytes_moved += head + tail;
+		HM_STAT_ADD(hm_parser, bytes_copied, head + tail);
+		hm_buffer_unref(hm_parser->buf);
+		hm_parser->buf = buf;
+		hm_parser->parser.data = (char *)hm_buffer_data(buf);
+		hm_parser_shift_pieces(hm_parser, msg_off);
+		hm_parser->msg_off = 0;
+		body_off -= msg_off;
+	} else {
+		memmove(data + body_off, data + parsed_off, tail);
+		hm_parser->bytes_moved += tail;
+		HM_STAT_ADD(hm_parser, bytes_moved, tail);
+	}
+	/* the body pieces come after the url. */
+	hm_array_set_count(hm_parser->pieces,
+		(hm_parser->url_idx == HM_PIECE_INVALID) ? 0 : hm_parser->url_idx + 1);
+	hm_parser->body_end = HM_PIECE_INVALID;
+	hm_parser->last_id = hm_piece_none;
+	hm_parser->parsed_off = body_off;
+	hm_parser->buf_len = body_off + tail;
+}
+
+/* body bytes of the current message that haven't been parsed yet, if known. */
+static size_t hm_parser_body_left(HMParser *hm_parser) {
+	http_parser *parser = &(hm_parser->parser);
+	uint32_t state = hm_parser->state & ~HM_PARSER_STATE_NEEDS_INPUT;
+
+	if(hm_parser->scan_body) {
+		return hm_parser->body_left;
+	}
+	/* for chunked bodies this is the rest of the current chunk. */
+	if((state == HM_PARSER_STATE_HEADERS_COMPLETE || state == HM_PARSER_STATE_BODY) &&
+			parser->content_length != ULLONG_MAX) {
+		return parser->content_length;
+	}
+	return 0;
+}
+
+/* new buffer capacity, with room for at least `need` bytes. */
+static size_t hm_parser_grow_size(HMParser *hm_parser, size_t cap, size_t need) {
+	size_t new_cap;
+	size_t body_end;
+
+	/* double small buffers, grow large buffers in fixed steps. */
+	new_cap = cap + ((cap < MAX_BUFFER_GROW) ? cap : MAX_BUFFER_GROW);
+	if(new_cap < need) {
+		new_cap = need;
+	}
+	/* presize the buffer for the whole body, when the Content-Length is known. */
+	if(!(hm_parser->opts & (HM_PARSER_OPT_STREAM_BODY | HM_PARSER_OPT_DISCARD_BODY))) {
+		size_t body_left = hm_parser_body_left(hm_parser);
+		if(body_left > 0 && body_left <= MAX_BUFFER_PRESIZE) {
+			body_end = hm_parser->parsed_off + body_left;
+			if(new_cap < body_end) {
+				new_cap = body_end;
+			}
+		}
+	}
+	if(hm_parser->limits.max_buffer > 0 && new_cap > hm_parser->limits.max_buffer) {
+		new_cap = hm_parser->limits.max_buffer;
+	}
+	return new_cap;
+}
+
+/* copy the current message out of the caller's memory into the buffer. */
+static bool hm_parser_copy_external(HMParser *hm_parser) {
+	const char *data = hm_parser->parser.data;
+	size_t msg_off = hm_parser->msg_off;
+	size_t len = hm_parser->buf_len - msg_off;
 	HMBuffer *buf = hm_parser->buf;
-	size_t cap = hm_buffer_capacity(buf);
-	size_t buf_len = hm_parser->buf_len;
+
+	/* the buffer isn't shared while parsing external data. */
+	if(hm_buffer_capacity(buf) < len) {
+		buf = hm_buffer_resize(buf, len + MIN_BUFFER_SPACE);
+		if(buf == NULL) {
+			hm_parser->parser.http_errno = HPE_UNKNOWN;
+			hm_parser->state |= HM_PARSER_STATE_ERROR;
+			return false;
+		}
+		hm_parser->buf = buf;
+		if(hm_buffer_capacity(buf) > hm_parser->buf_high) {
+			hm_parser->buf_high = hm_buffer_capacity(buf);
+		}
+	}
+	memcpy(hm_buffer_data(buf), data + msg_off, len);
+	hm_parser->bytes_moved += len;
+	HM_STAT_ADD(hm_parser, bytes_copied, len);
+	hm_parser->is_external = false;
+	hm_parser->parser.data = (char *)hm_buffer_data(buf);
+	hm_parser_shift_pieces(hm_parser, msg_off);
+	hm_parser->parsed_off -= msg_off;
+	hm_parser->buf_len = len;
+	hm_parser->msg_off = 0;
+	return true;
+}
+
+size_t hm_parser_prepare_buffer(HMParser *hm_parser, size_t len) {
+	HMBuffer *buf;
+	size_t cap;
+	size_t buf_len;
 	size_t available;
+	/* batched messages point into the buffer, drop them before it can move. */
+	hm_parser_clear_batch(hm_parser);
+	if(hm_parser->is_external && !hm_parser_copy_external(hm_parser)) {
+		return 0;
+	}
+	if(hm_parser->opts & (HM_PARSER_OPT_STREAM_BODY | HM_PARSER_OPT_DISCARD_BODY)) {
+		hm_parser_reclaim_body(hm_parser);
+	}
+	buf = hm_parser->buf;
+	cap = hm_buffer_capacity(buf);
+	buf_len = hm_parser->buf_len;
 	/* buffer length should never be larger then the current capacity. */
 	assert(cap >= buf_len);
 	available = cap - buf_len;
+	/* drop old messages from the start of the buffer before growing it. */
+	if(available < len && hm_parser->msg_off > 0) {
+		if(hm_parser_rebase_buffer(hm_parser, len)) {
+			buf = hm_parser->buf;
+			cap = hm_buffer_capacity(buf);
+			buf_len = hm_parser->buf_len;
+			available = cap - buf_len;
+		}
+	}
 	/* check if we should try to grow the buffer. */
 	if(available < len) {
 		size_t new_cap = buf_len + len;
@@ -383,13 +1520,37 @@ size_t hm_parser_prepare_buffer(HMParser *hm_parser, size_t len) {
 			/* ignore bad request to grow buffer. */
 			return 0; /* return zero to signal bad value. */
 		}
-		buf = hm_buffer_resize(buf, new_cap);
+		new_cap = hm_parser_grow_size(hm_parser, cap, new_cap);
+		if(new_cap <= cap) {
+			/* buffer is already at it's max. size. */
+			return available;
+		}
+		if(hm_buffer_is_shared(buf)) {
+			/* slices reference the old buffer, copy data to a larger buffer. */
+			if(hm_parser_move_buffer(hm_parser, new_cap, 0, buf_len)) {
+				buf = hm_parser->buf;
+			} else {
+				buf = NULL;
+			}
+		} else {
+			uint8_t *old_data = hm_buffer_data(buf);
+			buf = hm_buffer_resize(buf, new_cap);
+			if(buf && hm_buffer_data(buf) != old_data) {
+				/* realloc had to copy the buffer. */
+				hm_parser->bytes_moved += buf_len;
+				HM_STAT_ADD(hm_parser, bytes_copied, buf_len);
+			}
+		}
 		if(buf) {
 			/* update parser's buffer. */
+			HM_STAT_ADD(hm_parser, buffer_grows, 1);
 			hm_parser->buf = buf;
 			hm_parser->parser.data = (char *)hm_buffer_data(buf);
 			cap = hm_buffer_capacity(buf);
 			available = cap - buf_len;
+			if(cap > hm_parser->buf_high) {
+				hm_parser->buf_high = cap;
+			}
 		} else {
 			/* failed to grow buffer. */
 			available = 0;
@@ -398,6 +1559,57 @@ size_t hm_parser_prepare_buffer(HMParser *hm_parser, size_t len) {
 	return available;
 }
 
+size_t hm_parser_get_buffer_high_water(HMParser *hm_parser) {
+	return hm_parser->buf_high;
+}
+
+uint64_t hm_parser_get_bytes_moved(HMParser *hm_parser) {
+	return hm_parser->bytes_moved;
+}
+
+void hm_parser_get_timing(HMParser *hm_parser, HMTiming *timing) {
+	*timing = hm_parser->timing;
+}
+
+void hm_parser_set_phase_histograms(HMParser *hm_parser, HMHistogram *hists) {
+	hm_parser->phase_hist = hists;
+}
+
+bool hm_parser_get_stats(HMParser *hm_parser, HMParserStats *stats) {
+#ifdef HM_PARSER_STATS
+	*stats = hm_parser->stats;
+	return true;
+#else
+	(void)hm_parser;
+	memset(stats, 0, sizeof(HMParserStats));
+	return false;
+#endif
+}
+
+void hm_parser_clear_stats(HMParser *hm_parser) {
+	hm_parser_flush_stats(hm_parser);
+#ifdef HM_PARSER_STATS
+	memset(&(hm_parser->stats), 0, sizeof(HMParserStats));
+	memset(&(hm_parser->stats_flushed), 0, sizeof(HMParserStats));
+#endif
+}
+
+bool hm_parser_get_global_stats(HMParserStats *stats) {
+#ifdef HM_PARSER_STATS
+	uint64_t *total = (uint64_t *)&hm_parser_global_stats;
+	uint64_t *out = (uint64_t *)stats;
+	size_t idx;
+
+	for(idx = 0; idx < HM_PARSER_STATS_COUNT; idx++) {
+		out[idx] = __sync_fetch_and_add(&(total[idx]), 0);
+	}
+	return true;
+#else
+	memset(stats, 0, sizeof(HMParserStats));
+	return false;
+#endif
+}
+
 uint8_t *hm_parser_get_buffer(HMParser *hm_parser) {
 	uint8_t *data = hm_buffer_data(hm_parser->buf);
 	data += hm_parser->buf_len;
@@ -406,10 +1618,21 @@ uint8_t *hm_parser_get_buffer(HMParser *hm_parser) {
 
 size_t hm_parser_get_buffer_capacity(HMParser *hm_parser) {
 	size_t cap = hm_buffer_capacity(hm_parser->buf);
+	if(hm_parser->is_external) {
+		/* call hm_parser_prepare_buffer() first. */
+		return 0;
+	}
 	cap -= hm_parser->buf_len;
 	return cap;
 }
 
+/* remember when the oldest unparsed input arrived, for HM_PARSER_OPT_TIMING. */
+static inline void hm_parser_input_added(HMParser *hm_parser) {
+	if((hm_parser->opts & HM_PARSER_OPT_TIMING) && hm_parser->input_time == 0) {
+		hm_parser->input_time = hm_histogram_now();
+	}
+}
+
 size_t hm_parser_append_data(HMParser *hm_parser, const char *data, size_t len) {
 	size_t space = hm_parser_prepare_buffer(hm_parser, len);
 	if(space < len) {
@@ -418,6 +1641,9 @@ size_t hm_parser_append_data(HMParser *hm_parser, const char *data, size_t len)
 	memcpy(hm_parser_get_buffer(hm_parser), data, len);
 	hm_parser->buf_len += len;
 	hm_parser->state &= ~HM_PARSER_STATE_NEEDS_INPUT;
+	if(len > 0) {
+		hm_parser_input_added(hm_parser);
+	}
 
 	return len;
 }
@@ -427,22 +1653,167 @@ bool hm_parser_append_buffer_bytes(HMParser *hm_parser, size_t len) {
 	size_t buf_len = hm_parser->buf_len;
 	size_t new_len = buf_len + len;
 	/* check for integer/capacity overflow. */
-	if(new_len < buf_len || new_len > cap) {
+	if(hm_parser->is_external || new_len < buf_len || new_len > cap) {
 		/* invalid `len` value. */
 		return false;
 	}
 	hm_parser->buf_len = new_len;
 	hm_parser->state &= ~HM_PARSER_STATE_NEEDS_INPUT;
+	hm_parser_input_added(hm_parser);
 	return true;
 }
 
+/* get buffer space for reading at most `max` bytes, returns 0 if the buffer is full. */
+static size_t hm_parser_read_space(HMParser *hm_parser, size_t max) {
+	size_t space;
+
+	if(max == 0) {
+		max = HM_PARSER_READ_SIZE;
+	}
+	space = hm_parser_prepare_buffer(hm_parser, max);
+	return (space > max) ? max : space;
+}
+
+/* finish a read of `rc` bytes into the buffer. */
+static ssize_t hm_parser_read_done(HMParser *hm_parser, ssize_t rc) {
+	if(rc < 0) {
+		return -errno;
+	}
+	if(rc == 0) {
+		hm_parser_eof(hm_parser);
+		return 0;
+	}
+	hm_parser_append_buffer_bytes(hm_parser, rc);
+	return rc;
+}
+
+ssize_t hm_parser_read_fd(HMParser *hm_parser, int fd, size_t max) {
+	size_t space = hm_parser_read_space(hm_parser, max);
+	ssize_t rc;
+
+	if(space == 0) {
+		return -ENOBUFS;
+	}
+	do {
+		rc = read(fd, hm_parser_get_buffer(hm_parser), space);
+	} while(rc < 0 && errno == EINTR);
+	return hm_parser_read_done(hm_parser, rc);
+}
+
+#ifndef __WINDOWS__
+ssize_t hm_parser_recv(HMParser *hm_parser, int fd, size_t max, int flags) {
+	size_t space = hm_parser_read_space(hm_parser, max);
+	ssize_t rc;
+
+	if(space == 0) {
+		return -ENOBUFS;
+	}
+	do {
+		rc = recv(fd, hm_parser_get_buffer(hm_parser), space, flags);
+	} while(rc < 0 && errno == EINTR);
+	return hm_parser_read_done(hm_parser, rc);
+}
+
+ssize_t hm_parser_readv_fd(HMParser *hm_parser, int fd, size_t max) {
+	char extra[HM_PARSER_READ_SIZE];
+	struct iovec iov[2];
+	size_t space;
+	size_t room;
+	ssize_t rc;
+
+	if(max == 0) {
+		max = HM_PARSER_READ_SIZE;
+	}
+	/* read into the free space of the buffer, without growing it. */
+	space = hm_parser_prepare_buffer(hm_parser, 1);
+	if(space == 0) {
+		return -ENOBUFS;
+	}
+	if(space > max) {
+		space = max;
+	}
+	/* the rest goes to `extra`, but only as much as can be appended later. */
+	room = max - space;
+	if(room > sizeof(extra)) {
+		room = sizeof(extra);
+	}
+	if(hm_parser->limits.max_buffer > 0) {
+		size_t used = hm_parser->buf_len - hm_parser->msg_off + space;
+		size_t left = (hm_parser->limits.max_buffer > used) ? hm_parser->limits.max_buffer - used : 0;
+		if(room > left) {
+			room = left;
+		}
+	}
+	iov[0].iov_base = hm_parser_get_buffer(hm_parser);
+	iov[0].iov_len = space;
+	iov[1].iov_base = extra;
+	iov[1].iov_len = room;
+	do {
+		rc = readv(fd, iov, (room > 0) ? 2 : 1);
+	} while(rc < 0 && errno == EINTR);
+	if(rc <= (ssize_t)space) {
+		return hm_parser_read_done(hm_parser, rc);
+	}
+	hm_parser_append_buffer_bytes(hm_parser, space);
+	if(hm_parser_append_data(hm_parser, extra, rc - space) < (size_t)(rc - space)) {
+		/* failed to grow the buffer, the rest of the data is lost. */
+		return -ENOMEM;
+	}
+	return rc;
+}
+#endif
+
 void hm_parser_eof(HMParser *hm_parser) {
 	hm_parser->is_eof = true;
 	/* remove the NEEDS_INPUT flag to allow parser to resume. */
 	hm_parser->state &= ~HM_PARSER_STATE_NEEDS_INPUT;
 }
 
-int hm_parser_execute(HMParser* hm_parser) {
+/* check if the header block of the next message is in the buffer. */
+static bool hm_parser_headers_ready(HMParser *hm_parser) {
+	uint32_t state = hm_parser->state;
+	const char *data;
+	size_t len;
+
+	/* don't wait in the middle of a message. */
+	if(hm_parser->scan_body || hm_parser->is_eof ||
+			(state != HM_PARSER_STATE_NONE && state != HM_PARSER_STATE_MESSAGE_COMPLETE)) {
+		return true;
+	}
+	data = hm_parser->parser.data + hm_parser->parsed_off;
+	len = hm_parser->buf_len - hm_parser->parsed_off;
+	if(len > hm_parser->max_header_size ||
+			(hm_parser->limits.max_header_size > 0 && len > hm_parser->limits.max_header_size) ||
+			hm_scan_header_end(data + hm_parser->wait_off, data + len) != NULL) {
+		hm_parser->wait_off = 0;
+		return true;
+	}
+	/* continue the scan from here, the empty line can start in the last two bytes. */
+	hm_parser->wait_off = (len > 2) ? len - 2 : 0;
+	return false;
+}
+
+/*
+ * the unparsed message fills a buffer that can't grow, more input can't be added.
+ * streamed/discarded bodies free their space, so they never hit this limit.
+ */
+static void hm_parser_check_buffer_limit(HMParser *hm_parser) {
+	uint32_t state = hm_parser->state & ~HM_PARSER_STATE_NEEDS_INPUT;
+
+	if(hm_parser->limits.max_buffer == 0 || hm_parser->is_external || hm_parser->is_eof ||
+			(hm_parser->buf_len - hm_parser->msg_off) < hm_parser->limits.max_buffer) {
+		return;
+	}
+	if((hm_parser->opts & (HM_PARSER_OPT_STREAM_BODY | HM_PARSER_OPT_DISCARD_BODY)) &&
+			(state == HM_PARSER_STATE_HEADERS_COMPLETE || state == HM_PARSER_STATE_BODY)) {
+		return;
+	}
+	hm_parser->parser.http_errno = HPE_UNKNOWN;
+	hm_parser->limit = HM_PARSER_LIMIT_BUFFER;
+	hm_parser->state = HM_PARSER_STATE_ERROR | HM_PARSER_STATE_LIMIT;
+}
+
+static int hm_parser_execute_buffer(HMParser* hm_parser) {
 	char *data = hm_parser->parser.data;
 	size_t data_len = hm_parser->buf_len;
 	size_t parsed_off = hm_parser->parsed_off;
@@ -452,6 +1823,11 @@ int hm_parser_execute(HMParser* hm_parser) {
 	if(hm_parser->state & (HM_PARSER_STATE_NEEDS_INPUT|HM_PARSER_STATE_ERROR)) {
 		return hm_parser->state;
 	}
+	/* don't start parsing a message until it's headers are complete. */
+	if((hm_parser->opts & HM_PARSER_OPT_WAIT_HEADERS) && !hm_parser_headers_ready(hm_parser)) {
+		hm_parser->state |= HM_PARSER_STATE_NEEDS_INPUT;
+		return hm_parser->state;
+	}
 
 	/* Calculate how much data is unparsed. */
 	data_len -= parsed_off;
@@ -479,12 +1855,321 @@ int hm_parser_execute(HMParser* hm_parser) {
 		} else {
 			/* need data. */
 			hm_parser->state |= HM_PARSER_STATE_NEEDS_INPUT;
+			hm_parser_check_buffer_limit(hm_parser);
 		}
 	}
 
 	return hm_parser->state;
 }
 
+/* give the parser more of the caller's data, returns false if no data was added. */
+static bool hm_parser_feed_external(HMParser *hm_parser) {
+	const char *data = hm_parser->ext_data + hm_parser->ext_off;
+	size_t len = hm_parser->ext_len - hm_parser->ext_off;
+	uint32_t state = hm_parser->state & ~HM_PARSER_STATE_NEEDS_INPUT;
+
+	if(hm_parser->is_external) {
+		/* the borrowed data has been parsed, keep the rest of the message. */
+		if(state != HM_PARSER_STATE_MESSAGE_COMPLETE && !hm_parser_copy_external(hm_parser)) {
+			return false;
+		}
+	}
+	if(len == 0 || hm_parser->is_external) {
+		return false;
+	}
+	if(state == HM_PARSER_STATE_NONE && hm_parser->parsed_off == hm_parser->buf_len &&
+			!hm_buffer_is_shared(hm_parser->buf)) {
+		/* at a message boundary, parse directly from the caller's data. */
+		hm_parser->is_external = true;
+		hm_parser->parser.data = (char *)data;
+		hm_parser->msg_off = 0;
+		hm_parser->parsed_off = 0;
+		hm_parser->buf_len = len;
+		hm_parser->wait_off = 0;
+		hm_parser_input_added(hm_parser);
+	} else {
+		/* copy the data after a partial message. */
+		len = hm_parser_append_data(hm_parser, data, len);
+		if(len == 0) {
+			return false;
+		}
+	}
+	hm_parser->ext_off += len;
+	hm_parser->state &= ~HM_PARSER_STATE_NEEDS_INPUT;
+	return true;
+}
+
+static int hm_parser_execute_step(HMParser* hm_parser) {
+	int state = hm_parser_execute_buffer(hm_parser);
+
+	if((state & HM_PARSER_STATE_NEEDS_INPUT) && !(state & HM_PARSER_STATE_ERROR) &&
+			hm_parser->ext_data != NULL && hm_parser_feed_external(hm_parser)) {
+		/* more data to parse, let the caller handle the current state first. */
+		state = hm_parser->state;
+	}
+	return state;
+}
+
+/* parse all complete messages in the buffer. */
+static int hm_parser_execute_batch(HMParser* hm_parser) {
+	int state = hm_parser->state;
+
+	hm_parser_clear_batch(hm_parser);
+	for(;;) {
+		if((state & ~HM_PARSER_STATE_NEEDS_INPUT) == HM_PARSER_STATE_MESSAGE_COMPLETE) {
+			/* message from the fast scanner, an upgrade or one that didn't fit in the last batch. */
+			int rc = hm_parser_push_batch(hm_parser);
+			if(rc == HM_BATCH_FULL) {
+				/* the caller needs to call execute again. */
+				return HM_PARSER_STATE_MESSAGE_COMPLETE;
+			} else if(rc == HM_BATCH_ERROR) {
+				hm_parser->parser.http_errno = HPE_UNKNOWN;
+				hm_parser->state |= HM_PARSER_STATE_ERROR;
+				state = hm_parser->state;
+				break;
+			}
+			if(hm_parser->batch[hm_parser->batch_len - 1].upgrade) {
+				/* the data after an upgrade isn't HTTP, it's left unparsed. */
+				return HM_PARSER_STATE_MESSAGE_COMPLETE;
+			}
+		}
+		state = hm_parser_execute_buffer(hm_parser);
+		if(state & HM_PARSER_STATE_ERROR) {
+			break;
+		}
+		if(state & HM_PARSER_STATE_NEEDS_INPUT) {
+			if((state & ~HM_PARSER_STATE_NEEDS_INPUT) == HM_PARSER_STATE_MESSAGE_COMPLETE) {
+				continue;
+			}
+			if(hm_parser->ext_data == NULL) {
+				break;
+			}
+			if(hm_parser->batch_len > 0) {
+				/* the buffer can't change while messages point into it. */
+				if(hm_parser->ext_off < hm_parser->ext_len) {
+					return HM_PARSER_STATE_MESSAGE_COMPLETE;
+				}
+				if(hm_parser->is_external) {
+					/* keep the incomplete message, the batch still points at the caller's data. */
+					hm_parser->msg_off = hm_parser_pending_off(hm_parser);
+					hm_parser_copy_external(hm_parser);
+				}
+				state = hm_parser->state;
+				break;
+			}
+			if(!hm_parser_feed_external(hm_parser)) {
+				state = hm_parser->state;
+				break;
+			}
+			state = hm_parser->state;
+		}
+	}
+	/* hide the state of an incomplete message. */
+	if(hm_parser->batch_len > 0) {
+		return HM_PARSER_STATE_MESSAGE_COMPLETE |
+			(state & (HM_PARSER_STATE_NEEDS_INPUT | HM_PARSER_STATE_ERROR));
+	}
+	if(state & HM_PARSER_STATE_ERROR) {
+		return state;
+	}
+	return HM_PARSER_STATE_NONE | HM_PARSER_STATE_NEEDS_INPUT;
+}
+
+int hm_parser_execute(HMParser* hm_parser) {
+	int state;
+
+	if(hm_parser->opts & HM_PARSER_OPT_BATCH) {
+		state = hm_parser_execute_batch(hm_parser);
+	} else {
+		state = hm_parser_execute_step(hm_parser);
+	}
+	/* update the global counters once per batch of input, not for each message. */
+	if(state & (HM_PARSER_STATE_NEEDS_INPUT | HM_PARSER_STATE_ERROR)) {
+		hm_parser_flush_stats(hm_parser);
+	}
+	return state;
+}
+
+uint32_t hm_parser_batch_count(HMParser *hm_parser) {
+	return hm_parser->batch_len;
+}
+
+const HMBatchMessage *hm_parser_batch_get(HMParser *hm_parser, uint32_t idx) {
+	if(idx >= hm_parser->batch_len) {
+		return NULL;
+	}
+	return hm_parser->batch + idx;
+}
+
+const char *hm_parser_batch_get_url(HMParser *hm_parser, uint32_t idx, size_t *len) {
+	const HMBatchMessage *msg = hm_parser_batch_get(hm_parser, idx);
+	HMPiece *url;
+
+	assert(len != NULL);
+	if(msg == NULL || msg->url_idx == HM_PIECE_INVALID) {
+		*len = 0;
+		return NULL;
+	}
+	url = hm_parser->batch_pieces + msg->pieces + msg->url_idx;
+	*len = url->end - url->start;
+	return hm_parser->batch_data + url->start;
+}
+
+uint32_t hm_parser_batch_get_headers(HMParser *hm_parser, uint32_t idx,
+		HMHeader *headers, uint32_t max) {
+	const HMBatchMessage *msg = hm_parser_batch_get(hm_parser, idx);
+	HMHeaderPiece *header;
+	uint32_t n;
+
+	if(msg == NULL) {
+		return 0;
+	}
+	header = hm_parser->batch_headers + msg->headers;
+	for(n = 0; n < msg->count_headers && n < max; n++) {
+		hm_message_decode_header(&(headers[n]), (char *)hm_parser->batch_data, header + n);
+	}
+	return msg->count_headers;
+}
+
+const char *hm_parser_batch_get_body(HMParser *hm_parser, uint32_t idx, uint32_t n,
+		size_t *len) {
+	const HMBatchMessage *msg = hm_parser_batch_get(hm_parser, idx);
+	HMPiece *piece;
+
+	assert(len != NULL);
+	if(msg == NULL || msg->body_start == HM_PIECE_INVALID || n >= (uint32_t)(msg->body_end - msg->body_start)) {
+		*len = 0;
+		return NULL;
+	}
+	piece = hm_parser->batch_pieces + msg->pieces + msg->body_start + n;
+	*len = piece->end - piece->start;
+	return hm_parser->batch_data + piece->start;
+}
+
+/* bytes of the buffer used by a batched message. */
+static void hm_parser_batch_range(HMParser *hm_parser, const HMBatchMessage *msg,
+		size_t *start, size_t *end) {
+	HMPiece *piece = hm_parser->batch_pieces + msg->pieces;
+	HMPiece *pieces_end = piece + msg->count_pieces;
+	HMHeaderPiece *header = hm_parser->batch_headers + msg->headers;
+	HMHeaderPiece *headers_end = header + msg->count_headers;
+
+	*start = SIZE_MAX;
+	*end = 0;
+	for(; piece < pieces_end; piece++) {
+		if(piece->start < *start) *start = piece->start;
+		if(piece->end > *end) *end = piece->end;
+	}
+	for(; header < headers_end; header++) {
+		if(header->name.start < *start) *start = header->name.start;
+		if(header->value.end > *end) *end = header->value.end;
+	}
+	if(*start > *end) *start = *end;
+}
+
+HMMessage *hm_parser_batch_take(HMParser *hm_parser, uint32_t idx) {
+	HMAllocator *allocator = hm_parser->allocator;
+	HMBatchMessage *msg;
+	HMMessage *detached;
+	HMPiece *piece;
+	HMHeaderPiece *header;
+	uint32_t n;
+
+	if(idx >= hm_parser->batch_len || hm_parser->batch[idx].taken) {
+		return NULL;
+	}
+	msg = hm_parser->batch + idx;
+	detached = (HMMessage *)hm_alloc_malloc(allocator, sizeof(HMMessage));
+	if(detached == NULL) {
+		return NULL;
+	}
+	detached->allocator = allocator;
+	hm_array_new(allocator, detached->pieces, msg->count_pieces > 0 ? msg->count_pieces : 1);
+	hm_array_new(allocator, detached->headers, msg->count_headers > 0 ? msg->count_headers : 1);
+	if(detached->pieces == NULL || detached->headers == NULL) {
+		hm_array_free(allocator, detached->pieces);
+		hm_array_free(allocator, detached->headers);
+		hm_alloc_free(allocator, detached, sizeof(HMMessage));
+		return NULL;
+	}
+	piece = detached->pieces;
+	header = detached->headers;
+	memcpy(piece, hm_parser->batch_pieces + msg->pieces, sizeof(HMPiece) * msg->count_pieces);
+	memcpy(header, hm_parser->batch_headers + msg->headers,
+		sizeof(HMHeaderPiece) * msg->count_headers);
+	hm_array_set_count(piece, msg->count_pieces);
+	hm_array_set_count(header, msg->count_headers);
+	if(hm_parser->batch_data != (const char *)hm_buffer_data(hm_parser->buf)) {
+		/* copy the message out of the caller's data. */
+		size_t start, end;
+		hm_parser_batch_range(hm_parser, msg, &start, &end);
+		detached->buf = hm_buffer_new_alloc(allocator, end > start ? end - start : 1);
+		if(detached->buf == NULL) {
+			hm_message_free(detached);
+			return NULL;
+		}
+		memcpy(hm_buffer_data(detached->buf), hm_parser->batch_data + start, end - start);
+		for(n = 0; n < msg->count_pieces; n++) {
+			piece[n].start -= start;
+			piece[n].end -= start;
+		}
+		for(n = 0; n < msg->count_headers; n++) {
+			header[n].name.start -= start;
+			header[n].name.end -= start;
+			header[n].value.start -= start;
+			header[n].value.end -= start;
+		}
+	} else {
+		detached->buf = hm_buffer_ref(hm_parser->buf);
+	}
+	detached->url_idx = msg->url_idx;
+	detached->body_start = msg->body_start;
+	detached->body_end = msg->body_end;
+	detached->http_major = msg->http_major;
+	detached->http_minor = msg->http_minor;
+	detached->status_code = msg->status_code;
+	detached->method = msg->method;
+	detached->keep_alive = msg->keep_alive;
+	detached->upgrade = msg->upgrade;
+	detached->timing = msg->timing;
+	msg->taken = 1;
+	return detached;
+}
+
+int hm_parser_execute_external(HMParser *hm_parser, const char *data, size_t len) {
+	hm_parser_clear_batch(hm_parser);
+	/* keep anything still borrowed from the previous data. */
+	if(hm_parser->is_external && !hm_parser_copy_external(hm_parser)) {
+		return hm_parser->state;
+	}
+	hm_parser->ext_data = data;
+	hm_parser->ext_len = len;
+	hm_parser->ext_off = 0;
+	if(!(hm_parser->state & HM_PARSER_STATE_ERROR)) {
+		hm_parser_feed_external(hm_parser);
+	}
+	return hm_parser_execute(hm_parser);
+}
+
+static HMSlice *hm_parser_piece_slice(HMParser *hm_parser, HMPiece *piece) {
+	size_t len = piece->end - piece->start;
+	HMBuffer *buf;
+	HMSlice *slice;
+
+	if(!hm_parser->is_external) {
+		return hm_slice_new(hm_parser->buf, piece->start, len);
+	}
+	/* slices can outlive the caller's data, give them a copy. */
+	buf = hm_buffer_new_alloc(hm_parser->allocator, len > 0 ? len : 1);
+	if(buf == NULL) {
+		return NULL;
+	}
+	memcpy(hm_buffer_data(buf), hm_parser->parser.data + piece->start, len);
+	slice = hm_slice_new(buf, 0, len);
+	hm_buffer_unref(buf);
+	return slice;
+}
+
 const char *hm_parser_get_url(HMParser *hm_parser, size_t *len) {
 	const char *str = NULL;
 	hm_idx_t idx = hm_parser->url_idx;
@@ -497,97 +2182,227 @@ const char *hm_parser_get_url(HMParser *hm_parser, size_t *len) {
 	return str;
 }
 
+int hm_parser_get_url_parts(HMParser *hm_parser, HMUrl *u) {
+	const char *url;
+	size_t len;
+
+	url = hm_parser_get_url(hm_parser, &len);
+	if(url == NULL) {
+		return -1;
+	}
+	return hm_url_parse(url, len, (hm_parser->parser.method == HTTP_CONNECT), u);
+}
+
+HMSlice *hm_parser_get_url_slice(HMParser *hm_parser) {
+	hm_idx_t idx = hm_parser->url_idx;
+	if(idx != HM_PIECE_INVALID) {
+		return hm_parser_piece_slice(hm_parser, hm_parser->pieces + idx);
+	}
+	return NULL;
+}
+
 uint32_t hm_parser_count_headers(HMParser *hm_parser) {
-	uint32_t headers_start = hm_parser->headers_start;
-	uint32_t headers_end = hm_parser->headers_end;
-	assert(headers_start <= headers_end);
-	if(headers_start == HM_PIECE_INVALID) {
-		return 0;
+	uint32_t count = hm_array_count(hm_parser->headers);
+	/* don't count the last header until it's name is complete. */
+	if(hm_parser->last_id == hm_piece_header_field) {
+		count--;
 	}
-	return (headers_end - headers_start) >> 1;
+	return count;
 }
 
 void hm_parser_clear_headers(HMParser *hm_parser) {
-	hm_parser->headers_start = HM_PIECE_INVALID;
-	hm_parser->headers_end = HM_PIECE_INVALID;
+	hm_parser_clear_header_index(hm_parser);
+	hm_array_set_count(hm_parser->headers, 0);
+	if(hm_parser->last_id == hm_piece_header_field || hm_parser->last_id == hm_piece_header_value) {
+		hm_parser->last_id = hm_piece_none;
+	}
 }
 
-#include "hm_header_ids.h"
-
 HMHeader *hm_parser_get_header(HMParser *hm_parser, uint32_t idx) {
 	HMHeader *head = NULL;
-	uint32_t headers_start = hm_parser->headers_start;
-	uint32_t headers_end = hm_parser->headers_end;
-	uint32_t count = headers_end - headers_start;
-	const hm_header_id *id;
-	HMPiece  *piece;
-	char *data;
-	char *name;
-	size_t name_len;
-
-	/* check for headers. */
-	if(headers_start == HM_PIECE_INVALID) {
-		/* no headers. */
-		return head;
-	}
+
 	/* validate 'idx'. */
-	idx *= 2; /* each header has two pieces. */
-	if(idx >= count) {
-		/* idx out of bounds. */
+	if(idx >= hm_parser_count_headers(hm_parser)) {
 		return head;
 	}
-	idx += headers_start;
-
-	/* get name & value pieces. */
-	data = hm_parser->parser.data;
-	piece = hm_parser->pieces + idx;
 
 	/* fill tmp. HMHeader. */
 	head = &(hm_parser->tmp_header);
-	name = data + piece->start;
-	name_len = piece->end - piece->start;
-	/* lookup header in id map. */
-	id = hm_header_ids_lookup(name, name_len);
-	if(id) {
-		/* found common header, use id for faster processing. */
-		head->name_id = id->id;
-		head->name = NULL;
-		head->name_len = 0;
-	} else {
-		/*
-		 * Convert unknown HTTP headers to lower case.
-		 */
-		hm_str_lower(name, name_len);
-		head->name = name;
-		head->name_len = name_len;
-	}
-	piece++;
-	head->value = data + piece->start;
-	head->value_len = piece->end - piece->start;
+	hm_message_decode_header(head, hm_parser->parser.data, hm_parser->headers + idx);
 
 	return head;
 }
 
+uint32_t hm_parser_get_headers(HMParser *hm_parser, HMHeader *headers, uint32_t max) {
+	uint32_t count = hm_parser_count_headers(hm_parser);
+	char *data = hm_parser->parser.data;
+	HMHeaderPiece *header = hm_parser->headers;
+	uint32_t idx;
+
+	if(count > max) {
+		count = max;
+	}
+	for(idx = 0; idx < count; idx++, header++) {
+		hm_message_decode_header(headers + idx, data, header);
+	}
+	return count;
+}
+
+HMSlice *hm_parser_get_header_slice(HMParser *hm_parser, uint32_t idx) {
+	if(idx >= hm_parser_count_headers(hm_parser)) {
+		return NULL;
+	}
+	/* slice of the header value. */
+	return hm_parser_piece_slice(hm_parser, &(hm_parser->headers[idx].value));
+}
+
+int hm_parser_find_header_idx(HMParser *hm_parser, int id) {
+	hm_idx_t idx;
+	if(id <= 0 || id >= HM_MAX_HEADER_IDS) {
+		return -1;
+	}
+	idx = hm_parser->header_first[id];
+	if(idx == HM_PIECE_INVALID) {
+		return -1;
+	}
+	return idx;
+}
+
+int hm_parser_next_header_idx(HMParser *hm_parser, uint32_t idx) {
+	hm_idx_t next;
+	if(idx >= hm_parser_count_headers(hm_parser)) {
+		return -1;
+	}
+	next = hm_parser->headers[idx].next;
+	if(next == HM_PIECE_INVALID) {
+		return -1;
+	}
+	return next;
+}
+
+const char *hm_parser_find_header(HMParser *hm_parser, int id, size_t *len) {
+	HMHeaderPiece *header;
+	int idx = hm_parser_find_header_idx(hm_parser, id);
+	assert(len != NULL);
+	if(idx < 0) {
+		return NULL;
+	}
+	header = hm_parser->headers + idx;
+	*len = header->value.end - header->value.start;
+	return hm_parser->parser.data + header->value.start;
+}
+
+/* consume next body piece. */
+static hm_idx_t hm_parser_next_body_idx(HMParser *hm_parser) {
+	hm_idx_t idx = hm_parser->body_start;
+	if(idx != HM_PIECE_INVALID) {
+		hm_idx_t next = idx + 1;
+		if(next >= hm_parser->body_end) {
+			next = HM_PIECE_INVALID; /* no more pieces. */
+			hm_parser->body_end = HM_PIECE_INVALID;
+		}
+		hm_parser->body_start = next;
+	}
+	return idx;
+}
+
 const char *hm_parser_next_body(HMParser *hm_parser, size_t *len) {
 	const char *str = NULL;
-	hm_idx_t idx = hm_parser->body_start;
+	hm_idx_t idx = hm_parser_next_body_idx(hm_parser);
 	assert(len != NULL);
 	if(idx != HM_PIECE_INVALID) {
 		HMPiece *piece = hm_parser->pieces + idx;
 		str = hm_parser->parser.data + piece->start;
 		*len = piece->end - piece->start;
-		/* consume piece. */
-		idx++;
-		if(idx >= hm_parser->body_end) {
-			idx = HM_PIECE_INVALID; /* no more pieces. */
-			hm_parser->body_end = HM_PIECE_INVALID;
-		}
-		hm_parser->body_start = idx;
 	}
 	return str;
 }
 
+HMSlice *hm_parser_next_body_slice(HMParser *hm_parser) {
+	hm_idx_t idx = hm_parser_next_body_idx(hm_parser);
+	if(idx != HM_PIECE_INVALID) {
+		return hm_parser_piece_slice(hm_parser, hm_parser->pieces + idx);
+	}
+	return NULL;
+}
+
+HMMessage *hm_parser_detach_message(HMParser *hm_parser) {
+	http_parser* parser = &(hm_parser->parser);
+	HMAllocator *allocator = hm_parser->allocator;
+	HMMessage *msg;
+	HMPiece *pieces = NULL;
+	HMHeaderPiece *headers = NULL;
+
+	/* only completed messages can be detached. */
+	if((hm_parser->state & ~HM_PARSER_STATE_NEEDS_INPUT) != HM_PARSER_STATE_MESSAGE_COMPLETE) {
+		return NULL;
+	}
+	/*
+	 * the message takes the piece arrays, allocate new ones for the parser.
+	 * Inline arrays are copied instead.
+	 */
+	hm_array_new(allocator, pieces, INIT_PIECES);
+	hm_array_new(allocator, headers, INIT_HEADERS);
+	msg = (HMMessage *)hm_alloc_malloc(allocator, sizeof(HMMessage));
+	if(pieces == NULL || headers == NULL || msg == NULL) {
+		hm_array_free(allocator, pieces);
+		hm_array_free(allocator, headers);
+		hm_alloc_free(allocator, msg, sizeof(HMMessage));
+		return NULL;
+	}
+	msg->allocator = allocator;
+	if(hm_parser->is_external) {
+		/* copy the message out of the caller's data. */
+		size_t msg_off = hm_parser->msg_off;
+		size_t len = hm_parser->parsed_off - msg_off;
+		msg->buf = hm_buffer_new_alloc(allocator, len > 0 ? len : 1);
+		if(msg->buf == NULL) {
+			hm_array_free(allocator, pieces);
+			hm_array_free(allocator, headers);
+			hm_alloc_free(allocator, msg, sizeof(HMMessage));
+			return NULL;
+		}
+		memcpy(hm_buffer_data(msg->buf), hm_parser->parser.data + msg_off, len);
+		hm_parser_shift_pieces(hm_parser, msg_off);
+	} else {
+		msg->buf = hm_buffer_ref(hm_parser->buf);
+	}
+	if(hm_parser->pieces_inline) {
+		msg->pieces = hm_parser_copy_array(pieces, hm_parser->pieces, sizeof(HMPiece));
+	} else {
+		msg->pieces = hm_parser->pieces;
+		hm_parser->pieces = pieces;
+	}
+	hm_parser_clear_header_index(hm_parser);
+	if(hm_parser->headers_inline) {
+		msg->headers = hm_parser_copy_array(headers, hm_parser->headers, sizeof(HMHeaderPiece));
+	} else {
+		msg->headers = hm_parser->headers;
+		hm_parser->headers = headers;
+	}
+	/* HTTP Message fields. */
+	msg->url_idx = hm_parser->url_idx;
+	msg->body_start = hm_parser->body_start;
+	msg->body_end = hm_parser->body_end;
+	/* copy info from http_parser. */
+	msg->http_major = parser->http_major;
+	msg->http_minor = parser->http_minor;
+	msg->status_code = parser->status_code;
+	msg->method = parser->method;
+	msg->keep_alive = hm_parser_should_keep_alive(hm_parser) ? 1 : 0;
+	msg->upgrade = parser->upgrade;
+	msg->timing = hm_parser->timing;
+
+	/* the buffer is now shared, so this will not move the message data. */
+	hm_parser_next_message(hm_parser);
+
+	return msg;
+}
+
 int hm_parser_should_keep_alive(HMParser *hm_parser) {
+	if(hm_parser->scan_msg) {
+		return hm_parser->keep_alive;
+	}
 	return http_should_keep_alive(&hm_parser->parser);
 }
 
@@ -595,6 +2410,16 @@ int hm_parser_is_upgrade(HMParser *hm_parser) {
 	return hm_parser->parser.upgrade;
 }
 
+HMAllocator *hm_parser_get_allocator(HMParser *hm_parser) {
+	return hm_parser->allocator;
+}
+
+const char *hm_parser_get_unparsed(HMParser *hm_parser, size_t *len) {
+	assert(len != NULL);
+	*len = hm_parser->buf_len - hm_parser->parsed_off;
+	return hm_parser->parser.data + hm_parser->parsed_off;
+}
+
 int hm_parser_method(HMParser *hm_parser) {
 	return hm_parser->parser.method;
 }
@@ -619,11 +2444,29 @@ int hm_parser_error(HMParser *hm_parser) {
 	return hm_parser->parser.http_errno;
 }
 
+static const struct {
+	const char *name;
+	const char *description;
+} hm_parser_limit_errors[] = {
+	{ "HM_LIMIT_NONE", "no limit reached" },
+	{ "HM_LIMIT_URL", "url too long" },
+	{ "HM_LIMIT_HEADER_SIZE", "header block too large" },
+	{ "HM_LIMIT_HEADERS", "too many headers" },
+	{ "HM_LIMIT_BUFFER", "message too large for the parse buffer" },
+	{ "HM_LIMIT_BODY", "body too large" },
+};
+
 const char *hm_parser_error_name(HMParser *hm_parser) {
+	if(hm_parser->limit != HM_PARSER_LIMIT_NONE) {
+		return hm_parser_limit_errors[hm_parser->limit].name;
+	}
 	return http_errno_name(hm_parser->parser.http_errno);
 }
 
 const char *hm_parser_error_description(HMParser *hm_parser) {
+	if(hm_parser->limit != HM_PARSER_LIMIT_NONE) {
+		return hm_parser_limit_errors[hm_parser->limit].description;
+	}
 	return http_errno_description(hm_parser->parser.http_errno);
 }
 
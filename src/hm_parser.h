@@ -7,8 +7,15 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <errno.h>
 
 #include "lcommon.h"
+#include "hm_buffer.h"
+#include "hm_histogram.h"
+#include "hm_url.h"
+/* HM_MAX_HEADER_IDS & HM_HEADER_* ids, generated from hm_header_ids.gperf. */
+#include "hm_header_names.h"
+
 #define L_LIB_API extern
 #define L_INLINE static inline
 
@@ -22,9 +29,90 @@
 #define HM_PARSER_STATE_MESSAGE_COMPLETE  7
 #define HM_PARSER_STATE_NEEDS_INPUT       (1<<3)
 #define HM_PARSER_STATE_ERROR             (1<<4)
+/* set with HM_PARSER_STATE_ERROR when one of the parser's limits was reached. */
+#define HM_PARSER_STATE_LIMIT             (1<<5)
+
+/* parser options. */
+#define HM_PARSER_OPT_NONE                0
+#define HM_PARSER_OPT_FAST_SCAN           (1<<0)
+#define HM_PARSER_OPT_WAIT_HEADERS        (1<<1)
+#define HM_PARSER_OPT_STREAM_BODY         (1<<2)
+#define HM_PARSER_OPT_DISCARD_BODY        (1<<3)
+#define HM_PARSER_OPT_BATCH               (1<<4)
+#define HM_PARSER_OPT_SINGLE_ALLOC        (1<<5)
+#define HM_PARSER_OPT_TIMING              (1<<6)
+
+/* HM_PARSER_OPT_BATCH keeps whole messages, it can't be used to stream/discard the body. */
+#define HM_PARSER_OPTS_VALID(opts) (!((opts) & HM_PARSER_OPT_BATCH) || \
+	!((opts) & (HM_PARSER_OPT_STREAM_BODY | HM_PARSER_OPT_DISCARD_BODY)))
+
+/* message phases timed with HM_PARSER_OPT_TIMING, each from the first byte of the message. */
+#define HM_PARSER_PHASE_BEGIN             0
+#define HM_PARSER_PHASE_HEADERS           1
+#define HM_PARSER_PHASE_COMPLETE          2
+#define HM_PARSER_PHASES                  3
+
+/* default limit for HM_PARSER_OPT_WAIT_HEADERS. */
+#define HM_PARSER_MAX_HEADER_SIZE         (80 * 1024)
+
+/* default read size for hm_parser_read_fd(). */
+#define HM_PARSER_READ_SIZE               (16 * 1024)
+
+/* limit that stopped the parser, see hm_parser_limit(). */
+#define HM_PARSER_LIMIT_NONE              0
+#define HM_PARSER_LIMIT_URL               1
+#define HM_PARSER_LIMIT_HEADER_SIZE       2
+#define HM_PARSER_LIMIT_HEADERS           3
+#define HM_PARSER_LIMIT_BUFFER            4
+#define HM_PARSER_LIMIT_BODY              5
+
+typedef struct HMParserLimits HMParserLimits;
+
+/**
+ * Per-parser limits, zero for no limit.
+ */
+struct HMParserLimits {
+	uint32_t    max_url;          /**< max. url bytes. */
+	uint32_t    max_header_size;  /**< max. bytes of the headers, counted from the url (or first header). */
+	uint32_t    max_headers;      /**< max. number of headers. */
+	size_t      max_buffer;       /**< max. buffer size. */
+	uint64_t    max_body;         /**< max. body bytes of one message. */
+};
+
+typedef struct HMParserStats HMParserStats;
+
+/**
+ * Parser performance counters, only counted when compiled with HM_PARSER_STATS.
+ */
+struct HMParserStats {
+	uint64_t    bytes_parsed;     /**< bytes parsed by http_parser & the fast scanner. */
+	uint64_t    execute_calls;    /**< calls to http_parser_execute(). */
+	uint64_t    fast_scans;       /**< messages parsed by the fast scanner. */
+	uint64_t    pauses;           /**< http_parser pause/resume cycles. */
+	uint64_t    array_grows;      /**< piece/header array reallocs. */
+	uint64_t    buffer_grows;     /**< parse buffer reallocs. */
+	uint64_t    bytes_copied;     /**< bytes copied into a new buffer. */
+	uint64_t    bytes_moved;      /**< bytes memmoved inside a buffer. */
+	uint64_t    header_id_hits;   /**< header names found in the header id map. */
+	uint64_t    header_id_misses; /**< unknown header names. */
+};
+
+typedef struct HMTiming HMTiming;
+
+/**
+ * Monotonic timestamps (nanoseconds) of a message, 0 when not reached or untimed.
+ */
+struct HMTiming {
+	uint64_t    first_byte;       /**< first byte of the message was added to the buffer. */
+	uint64_t    message_begin;
+	uint64_t    headers_complete;
+	uint64_t    message_complete;
+};
 
 typedef struct HMParser HMParser;
 
+typedef struct HMMessage HMMessage;
+
 typedef uint16_t hm_idx_t;
 typedef uint32_t hm_len_t;
 
@@ -38,6 +126,30 @@ typedef struct HMHeader {
 	int        name_id;
 } HMHeader;
 
+/**
+ * Descriptor of a completed message in the batch of a HM_PARSER_OPT_BATCH parser.
+ *
+ * The message's pieces are ranges of the parser's batch arrays, they point into the
+ * parser's buffer and are only valid until the batch is cleared.
+ */
+typedef struct HMBatchMessage {
+	uint32_t    pieces;         /**< index of the message's first url/body piece. */
+	uint32_t    headers;        /**< index of the message's first header. */
+	uint16_t    count_pieces;
+	uint16_t    count_headers;
+	uint16_t    url_idx;        /**< relative to `pieces`, UINT16_MAX when there is no url. */
+	uint16_t    body_start;     /**< relative to `pieces`, UINT16_MAX when there is no body. */
+	uint16_t    body_end;
+	uint16_t    http_major;
+	uint16_t    http_minor;
+	uint16_t    status_code;
+	uint8_t     method;
+	uint8_t     keep_alive: 1;
+	uint8_t     upgrade: 1;
+	uint8_t     taken: 1;       /**< detached by hm_parser_batch_take(). */
+	HMTiming    timing;
+} HMBatchMessage;
+
 /**
  * Create HTTP Response message.
  *
@@ -54,6 +166,135 @@ L_LIB_API HMParser *hm_parser_new_response();
  */
 L_LIB_API HMParser *hm_parser_new_request();
 
+/**
+ * Create HTTP Response message with options.
+ *
+ * HM_PARSER_OPT_FAST_SCAN is only used by request parsers.
+ *
+ * @param opts HM_PARSER_OPT_* flags.
+ * @return message pointer to new HMParser.
+ * @public @memberof HMParser
+ */
+L_LIB_API HMParser *hm_parser_new_response_opts(uint32_t opts);
+
+/**
+ * Create HTTP Request message with options.
+ *
+ * With HM_PARSER_OPT_FAST_SCAN requests with a complete header block in the buffer are
+ * parsed by a SIMD scanner instead of http_parser.  Chunked bodies, upgrades and other
+ * uncommon requests are still parsed by http_parser.
+ *
+ * With HM_PARSER_OPT_WAIT_HEADERS hm_parser_execute() only scans for the end of the
+ * header block and returns NEEDS_INPUT until the headers are complete (or the
+ * max. header size is reached), instead of parsing partial headers.
+ *
+ * With HM_PARSER_OPT_SINGLE_ALLOC the parser and it's initial url/header piece arrays
+ * are allocated as one cache aligned block.  The buffer is still allocated on it's own,
+ * since slices and detached messages can keep it alive after the parser is freed.
+ *
+ * With HM_PARSER_OPT_TIMING each message gets monotonic timestamps for when it's
+ * first byte was added and when it began, it's headers and itself were complete,
+ * see hm_parser_get_timing().
+ *
+ * HM_PARSER_OPT_BATCH can't be combined with HM_PARSER_OPT_STREAM_BODY or
+ * HM_PARSER_OPT_DISCARD_BODY, see HM_PARSER_OPTS_VALID().
+ *
+ * @param opts HM_PARSER_OPT_* flags.
+ * @return message pointer to new HMParser or NULL if the options are invalid.
+ * @public @memberof HMParser
+ */
+L_LIB_API HMParser *hm_parser_new_request_opts(uint32_t opts);
+
+/**
+ * Create HTTP Response message with options and an allocator.
+ *
+ * The parser, it's buffers, slices and detached messages are allocated with
+ * `allocator` (NULL for the default allocator), which must outlive all of them.
+ *
+ * @param opts HM_PARSER_OPT_* flags.
+ * @param allocator allocator to use.
+ * @return message pointer to new HMParser.
+ * @public @memberof HMParser
+ */
+L_LIB_API HMParser *hm_parser_new_response_alloc(uint32_t opts, HMAllocator *allocator);
+
+/**
+ * Create HTTP Request message with options and an allocator.
+ *
+ * @param opts HM_PARSER_OPT_* flags.
+ * @param allocator allocator to use (NULL for the default allocator).
+ * @return message pointer to new HMParser.
+ * @public @memberof HMParser
+ */
+L_LIB_API HMParser *hm_parser_new_request_alloc(uint32_t opts, HMAllocator *allocator);
+
+/**
+ * Returns the bytes allocated for the parser, it's piece arrays and buffer.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @public @memberof HMParser
+ */
+L_LIB_API size_t hm_parser_get_memory_used(HMParser *hm_parser);
+
+/**
+ * Set the parser's limits.
+ *
+ * Each limit is checked as soon as the parser sees the bytes that exceed it (a
+ * Content-Length larger then `max_body` is rejected when the headers are complete).
+ * The parser then stops with HM_PARSER_STATE_ERROR | HM_PARSER_STATE_LIMIT and
+ * hm_parser_limit() returns which limit was reached.
+ *
+ * `max_buffer` is the same as hm_parser_set_max_buffer_size().  Reaching it is only an
+ * error when the parser can't make progress: the headers (or the whole body, without
+ * HM_PARSER_OPT_STREAM_BODY/HM_PARSER_OPT_DISCARD_BODY) don't fit in the buffer.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param limits new limits.
+ * @public @memberof HMParser
+ */
+L_LIB_API void hm_parser_set_limits(HMParser *hm_parser, const HMParserLimits *limits);
+
+/**
+ * Get the parser's limits.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param limits returns the current limits.
+ * @public @memberof HMParser
+ */
+L_LIB_API void hm_parser_get_limits(HMParser *hm_parser, HMParserLimits *limits);
+
+/**
+ * Returns the limit (HM_PARSER_LIMIT_*) that stopped the parser.
+ *
+ * @public @memberof HMParser
+ */
+L_LIB_API int hm_parser_limit(HMParser *hm_parser);
+
+/**
+ * Set how many bytes HM_PARSER_OPT_WAIT_HEADERS will wait for before parsing
+ * incomplete headers.  It also stops waiting when `max_header_size` from
+ * hm_parser_set_limits() is smaller.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param size max. header size (default HM_PARSER_MAX_HEADER_SIZE).
+ * @public @memberof HMParser
+ */
+L_LIB_API void hm_parser_set_max_header_size(HMParser *hm_parser, uint32_t size);
+
+/**
+ * Limit how large the buffer can grow, hm_parser_prepare_buffer() will not grow the
+ * buffer past this size.
+ *
+ * Use with HM_PARSER_OPT_STREAM_BODY (body pieces are dropped from the buffer once they
+ * have been consumed with hm_parser_next_body()) or HM_PARSER_OPT_DISCARD_BODY (body
+ * bytes are not kept) to parse large bodies with a fixed amount of memory.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param size max. buffer size in bytes (0 for no limit, the default).
+ * @public @memberof HMParser
+ */
+L_LIB_API void hm_parser_set_max_buffer_size(HMParser *hm_parser, size_t size);
+
 /**
  * Free instance of HMParser.
  *
@@ -66,9 +307,12 @@ L_LIB_API void hm_parser_free(HMParser *hm_parser);
  * Reset the parser, clear message state, clear data buffer.
  *
  * @param hm_parser pointer to HMParser structure to be reset.
+ * @return false if a new buffer was needed (the old one is still referenced by slices
+ * or messages) and couldn't be allocated.  The parser then stays in an error state
+ * until the next successful reset.
  * @public @memberof HMParser
  */
-L_LIB_API void hm_parser_reset(HMParser *hm_parser);
+L_LIB_API bool hm_parser_reset(HMParser *hm_parser);
 
 /**
  * Begin parsing next http message in buffer.
@@ -78,6 +322,40 @@ L_LIB_API void hm_parser_reset(HMParser *hm_parser);
  */
 L_LIB_API void hm_parser_next_message(HMParser *hm_parser);
 
+/**
+ * Detach the completed message from the parser and begin parsing the next message.
+ *
+ * The message keeps a reference to the parser's buffer, so the parser can continue
+ * with the next pipelined message without copying or compacting the buffer.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @return new HMMessage or NULL if the current message is not complete.
+ * @public @memberof HMParser
+ */
+L_LIB_API HMMessage *hm_parser_detach_message(HMParser *hm_parser);
+
+/**
+ * Get the timestamps of the current message (HM_PARSER_OPT_TIMING).
+ *
+ * A pipelined message that was already in the buffer when the previous message
+ * completed starts when the parser reaches it.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param timing returns the timestamps, see hm_histogram_now().
+ * @public @memberof HMParser
+ */
+L_LIB_API void hm_parser_get_timing(HMParser *hm_parser, HMTiming *timing);
+
+/**
+ * Record the phases of each completed message (HM_PARSER_OPT_TIMING) into
+ * `hists[HM_PARSER_PHASE_*]`, NULL to stop recording.  Used by HMParserPool.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param hists array of HM_PARSER_PHASES histograms, must outlive the parser.
+ * @public @memberof HMParser
+ */
+L_LIB_API void hm_parser_set_phase_histograms(HMParser *hm_parser, HMHistogram *hists);
+
 /**
  * Append data to buffer.
  *
@@ -91,6 +369,11 @@ L_LIB_API size_t hm_parser_append_data(HMParser *hm_parser, const char *data, si
 /**
  * Prepare buffer for appending more data.
  *
+ * The buffer doubles in size when it needs to grow (in 1Mb steps once it is larger
+ * then 1Mb).  Once the Content-Length of the current message is known the buffer is
+ * grown to hold the whole body (unless streaming/discarding the body).  Large buffers
+ * are shrunk again by hm_parser_next_message() when they are mostly empty.
+ *
  * @param hm_parser pointer to HMParser structure.
  * @param len number of bytes we would like to append.
  * @return available space in buffer for more data.
@@ -114,6 +397,58 @@ L_LIB_API uint8_t *hm_parser_get_buffer(HMParser *hm_parser);
  */
 L_LIB_API size_t hm_parser_get_buffer_capacity(HMParser *hm_parser);
 
+/**
+ * Returns the largest capacity the buffer has grown to.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @public @memberof HMParser
+ */
+L_LIB_API size_t hm_parser_get_buffer_high_water(HMParser *hm_parser);
+
+/**
+ * Returns the total number of bytes the parser has moved or copied inside its
+ * buffers (compaction, growing, body reclaiming and copying external data).
+ *
+ * Consumed messages are not compacted away, unparsed data is only moved to the
+ * start of the buffer when there isn't enough free space at the end.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @public @memberof HMParser
+ */
+L_LIB_API uint64_t hm_parser_get_bytes_moved(HMParser *hm_parser);
+
+/**
+ * Get the parser's performance counters.
+ *
+ * Counters are kept from when the parser was created or last cleared with
+ * hm_parser_clear_stats().
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param stats returns the counters (all zero without HM_PARSER_STATS).
+ * @return false if the library was compiled without HM_PARSER_STATS.
+ * @public @memberof HMParser
+ */
+L_LIB_API bool hm_parser_get_stats(HMParser *hm_parser, HMParserStats *stats);
+
+/**
+ * Add the parser's counters to the global counters and clear them.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @public @memberof HMParser
+ */
+L_LIB_API void hm_parser_clear_stats(HMParser *hm_parser);
+
+/**
+ * Get the counters of all parsers.
+ *
+ * A parser's counters are added to the global counters each time hm_parser_execute()
+ * needs more input or stops with an error, and when the parser is freed.
+ *
+ * @param stats returns the counters (all zero without HM_PARSER_STATS).
+ * @return false if the library was compiled without HM_PARSER_STATS.
+ */
+L_LIB_API bool hm_parser_get_global_stats(HMParserStats *stats);
+
 /**
  * Mark how many bytes have been written into the parse buffer.
  *
@@ -123,6 +458,49 @@ L_LIB_API size_t hm_parser_get_buffer_capacity(HMParser *hm_parser);
  */
 L_LIB_API bool hm_parser_append_buffer_bytes(HMParser *hm_parser, size_t len);
 
+/**
+ * Read data from a file descriptor (file, pipe or socket) directly into the parse buffer.
+ *
+ * A zero-byte read (end of file) calls hm_parser_eof().
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param fd file descriptor to read from.
+ * @param max max. number of bytes to read (0 for HM_PARSER_READ_SIZE).
+ * @return number of bytes read, 0 on EOF or a negative errno (-EAGAIN for non-blocking
+ * file descriptors with no data, -ENOBUFS if the buffer is at it's max. size).
+ * @public @memberof HMParser
+ */
+L_LIB_API ssize_t hm_parser_read_fd(HMParser *hm_parser, int fd, size_t max);
+
+#ifndef __WINDOWS__
+/**
+ * Same as hm_parser_read_fd(), but uses recv() with `flags` (for example MSG_DONTWAIT)
+ * to read from a socket.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param fd socket to read from.
+ * @param max max. number of bytes to read (0 for HM_PARSER_READ_SIZE).
+ * @param flags recv() flags.
+ * @return same as hm_parser_read_fd().
+ * @public @memberof HMParser
+ */
+L_LIB_API ssize_t hm_parser_recv(HMParser *hm_parser, int fd, size_t max, int flags);
+
+/**
+ * Same as hm_parser_read_fd(), but the buffer is only grown when more data is read
+ * then fits in it's free space.  readv() reads into the free space and a stack buffer
+ * of HM_PARSER_READ_SIZE bytes, the data in the stack buffer is then appended.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param fd file descriptor to read from.
+ * @param max max. number of bytes to read (0 for HM_PARSER_READ_SIZE).
+ * @return same as hm_parser_read_fd(), or -ENOMEM if the buffer couldn't grow for
+ * the data in the stack buffer.
+ * @public @memberof HMParser
+ */
+L_LIB_API ssize_t hm_parser_readv_fd(HMParser *hm_parser, int fd, size_t max);
+#endif
+
 /**
  * Tell the parser that there is no more data.
  *
@@ -139,19 +517,172 @@ L_LIB_API void hm_parser_eof(HMParser *hm_parser);
  */
 L_LIB_API int hm_parser_execute(HMParser *hm_parser);
 
+/**
+ * Number of completed messages from the last hm_parser_execute() call in
+ * HM_PARSER_OPT_BATCH mode.
+ *
+ * With HM_PARSER_OPT_BATCH hm_parser_execute() parses all complete messages in the buffer
+ * in one pass.  The url/header/body pieces of each message are recorded in the parser's
+ * batch arrays (a HMBatchMessage descriptor for each message) and the buffer is only
+ * compacted once, when the batch is cleared.  The state of an incomplete message is not
+ * returned, the returned state is HM_PARSER_STATE_MESSAGE_COMPLETE when there are
+ * messages, HM_PARSER_STATE_NONE otherwise.  Without the HM_PARSER_STATE_NEEDS_INPUT flag
+ * the batch was full (or there is more external data), handle the messages and call
+ * hm_parser_execute() again.
+ *
+ * The batch is cleared by the next hm_parser_execute() or when data is added to the
+ * buffer.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @public @memberof HMParser
+ */
+L_LIB_API uint32_t hm_parser_batch_count(HMParser *hm_parser);
+
+/**
+ * Get the descriptor of a completed message in the batch.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param idx index of message in the batch.
+ * @return the descriptor or NULL if `idx` is out of range.
+ * @public @memberof HMParser
+ */
+L_LIB_API const HMBatchMessage *hm_parser_batch_get(HMParser *hm_parser, uint32_t idx);
+
+/**
+ * Get the url of a message in the batch.
+ *
+ * @public @memberof HMParser
+ */
+L_LIB_API const char *hm_parser_batch_get_url(HMParser *hm_parser, uint32_t idx, size_t *len);
+
+/**
+ * Fill `headers` with up to `max` headers of a message in the batch.
+ *
+ * @return number of headers in the message (can be more then `max`).
+ * @public @memberof HMParser
+ */
+L_LIB_API uint32_t hm_parser_batch_get_headers(HMParser *hm_parser, uint32_t idx,
+		HMHeader *headers, uint32_t max);
+
+/**
+ * Get body piece `n` of a message in the batch.
+ *
+ * @return the body piece or NULL after the last piece.
+ * @public @memberof HMParser
+ */
+L_LIB_API const char *hm_parser_batch_get_body(HMParser *hm_parser, uint32_t idx, uint32_t n,
+		size_t *len);
+
+/**
+ * Detach a completed message from the batch as a HMMessage.  The message is only
+ * allocated when it is taken, it shares the parser's buffer.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param idx index of message in the batch.
+ * @return the message (the caller must free it) or NULL if it was already taken.
+ * @public @memberof HMParser
+ */
+L_LIB_API HMMessage *hm_parser_batch_take(HMParser *hm_parser, uint32_t idx);
+
+/**
+ * Parse data from caller owned memory, without copying it into the parser's buffer.
+ *
+ * Url/header/body pieces point into `data`, so it must stay valid until the parser
+ * returns HM_PARSER_STATE_NEEDS_INPUT (or the last message is finished with
+ * hm_parser_next_message()).  Only a message that is still incomplete at the end of
+ * `data` is copied into the parser's buffer.  Slices and detached messages get their
+ * own copy of the data.
+ *
+ * `data` is never modified, so unknown header names keep their original case and
+ * folded header values keep the line break, unlike data parsed from the buffer.
+ *
+ * Keep calling hm_parser_execute() until it returns HM_PARSER_STATE_NEEDS_INPUT, the same
+ * as after hm_parser_append_data().  Data that doesn't fit in a full buffer (see
+ * hm_parser_set_max_buffer_size()) is copied by hm_parser_execute() once there is room.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param data caller owned data to parse.
+ * @param len length of `data`.
+ * @return parser state, same as hm_parser_execute().
+ * @public @memberof HMParser
+ */
+L_LIB_API int hm_parser_execute_external(HMParser *hm_parser, const char *data, size_t len);
+
 /**
  * methods to access HTTP headers.
  */
 L_LIB_API const char *hm_parser_get_url(HMParser *hm_parser, size_t *len);
 
+/**
+ * Split the url into it's components, see hm_url_parse().  The field offsets are
+ * relative to the url returned by hm_parser_get_url().
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param u fields to fill.
+ * @return 0 or -1 if there is no url or it is invalid.
+ * @public @memberof HMParser
+ */
+L_LIB_API int hm_parser_get_url_parts(HMParser *hm_parser, HMUrl *u);
+
 L_LIB_API uint32_t hm_parser_count_headers(HMParser *hm_parser);
 
 L_LIB_API void hm_parser_clear_headers(HMParser *hm_parser);
 
 L_LIB_API HMHeader *hm_parser_get_header(HMParser *hm_parser, uint32_t idx);
 
+/**
+ * Get all headers with one call.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param headers caller-provided array to fill.
+ * @param max size of the `headers` array.
+ * @return number of headers written to `headers`.
+ * @public @memberof HMParser
+ */
+L_LIB_API uint32_t hm_parser_get_headers(HMParser *hm_parser, HMHeader *headers, uint32_t max);
+
+/**
+ * Find the first header with id `id` (see hm_header_ids.gperf).
+ *
+ * Header ids are indexed while parsing, so this doesn't scan the headers.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param id header id.
+ * @param len set to the length of the header value.
+ * @return header value or NULL if there is no header with that id.
+ * @public @memberof HMParser
+ */
+L_LIB_API const char *hm_parser_find_header(HMParser *hm_parser, int id, size_t *len);
+
+/**
+ * Iterate over repeated headers with the same id.
+ *
+ * hm_parser_find_header_idx() returns the index of the first header with id `id`,
+ * hm_parser_next_header_idx() returns the index of the next header with the
+ * same id as header `idx`.  Both return -1 when there are no more headers.
+ * Use hm_parser_get_header() to get the header at the returned index.
+ *
+ * @public @memberof HMParser
+ */
+L_LIB_API int hm_parser_find_header_idx(HMParser *hm_parser, int id);
+
+L_LIB_API int hm_parser_next_header_idx(HMParser *hm_parser, uint32_t idx);
+
 L_LIB_API const char *hm_parser_next_body(HMParser *hm_parser, size_t *len);
 
+/**
+ * Zero-copy access to the url/header values/body chunks.
+ *
+ * Each slice holds a reference to the parser's buffer, the parser will switch to a
+ * new buffer instead of moving data that is still referenced.  Free slices
+ * with hm_slice_free().
+ */
+L_LIB_API HMSlice *hm_parser_get_url_slice(HMParser *hm_parser);
+
+L_LIB_API HMSlice *hm_parser_get_header_slice(HMParser *hm_parser, uint32_t idx);
+
+L_LIB_API HMSlice *hm_parser_next_body_slice(HMParser *hm_parser);
+
 /**
  * methods to access info from http_parser.
  */
@@ -160,6 +691,24 @@ L_LIB_API int hm_parser_should_keep_alive(HMParser *hm_parser);
 
 L_LIB_API int hm_parser_is_upgrade(HMParser *hm_parser);
 
+/**
+ * Data in the buffer after the last parsed message, like the first bytes of the new
+ * protocol after an upgrade message.
+ *
+ * @param hm_parser pointer to HMParser structure.
+ * @param len set to the number of unparsed bytes.
+ * @return pointer to the unparsed bytes, valid until the parser is changed.
+ * @public @memberof HMParser
+ */
+L_LIB_API const char *hm_parser_get_unparsed(HMParser *hm_parser, size_t *len);
+
+/**
+ * The allocator the parser was created with, the default allocator if it was NULL.
+ *
+ * @public @memberof HMParser
+ */
+L_LIB_API HMAllocator *hm_parser_get_allocator(HMParser *hm_parser);
+
 L_LIB_API int hm_parser_method(HMParser *hm_parser);
 
 L_LIB_API const char *hm_parser_method_str(HMParser *hm_parser);
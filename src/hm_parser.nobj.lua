@@ -22,6 +22,8 @@ basetype "HMHeader *" "nil" "NULL"
 
 object "HMParser" {
 	include"hm_parser.h",
+	include"hm_scan.h",
+	include"hm_header_value.h",
 	ffi_cdef[[
 typedef uint32_t hm_len_t;
 
@@ -33,6 +35,78 @@ typedef struct HMHeader {
 	int        name_id;
 } HMHeader;
 
+uint32_t hm_parser_get_headers(HMParser *hm_parser, HMHeader *headers, uint32_t max);
+
+typedef struct HMUrlField {
+	uint32_t    off;
+	uint32_t    len;
+} HMUrlField;
+
+typedef struct HMUrl {
+	uint16_t    fields;
+	uint16_t    port;
+	HMUrlField  field[7];
+} HMUrl;
+
+int hm_parser_get_url_parts(HMParser *hm_parser, HMUrl *u);
+
+typedef struct HMAllocator {
+	void        *alloc;
+	void        *ud;
+	size_t      bytes;
+} HMAllocator;
+
+HMAllocator *hm_parser_get_allocator(HMParser *hm_parser);
+
+]],
+	ffi_source "ffi_src" [[
+-- Lua values kept alive by an object.
+local hm_anchor_tables = setmetatable({}, { __mode = "k" })
+local function hm_anchors(obj)
+	local anchors = hm_anchor_tables[obj]
+	if not anchors then
+		anchors = {}
+		hm_anchor_tables[obj] = anchors
+	end
+	return anchors
+end
+
+-- parser memory isn't counted by Lua's GC, do a GC step for every 64KB allocated.
+-- Parsers are created with the Lua state's allocator, same as hm_lua_gc_check().
+local hm_gc_stepped = 0
+local function hm_gc_check(parser)
+	local bytes = tonumber(C.hm_parser_get_allocator(parser).bytes)
+	if bytes > hm_gc_stepped + 65536 then
+		collectgarbage("step", (bytes - hm_gc_stepped) / 1024)
+		hm_gc_stepped = bytes
+	elseif bytes < hm_gc_stepped then
+		hm_gc_stepped = bytes
+	end
+end
+
+-- tmp. array for get_headers().
+local hm_headers_max = 32
+local hm_headers_tmp = ffi.new("HMHeader[?]", hm_headers_max)
+
+-- tmp. values for get_url_parts().
+local hm_url_tmp = ffi.new("HMUrl")
+local hm_url_len_tmp = ffi.new("size_t[1]")
+
+-- fill `tbl` from hm_url_tmp, same as hm_lua_url_parts().
+local function hm_url_parts(tbl)
+	local u = hm_url_tmp
+	local fields = u.fields
+	for f=0,6 do
+		if fields % 2 == 1 then
+			tbl[(f * 2) + 1] = u.field[f].off
+			tbl[(f * 2) + 2] = u.field[f].len
+		else
+			tbl[(f * 2) + 1] = -1
+			tbl[(f * 2) + 2] = 0
+		end
+		fields = (fields - (fields % 2)) / 2
+	end
+end
 ]],
 	destructor {
 		c_method_call "void" "hm_parser_free" {},
@@ -40,8 +114,29 @@ typedef struct HMHeader {
 
 	-- buffer management.
 
+	-- append `data` starting after the first `off` bytes, returns the number of bytes
+	-- appended (less then the rest of `data` when the buffer is at it's max. size).
 	method "append" {
-		c_method_call "size_t" "hm_parser_append_data" { "const char *", "data", "size_t", "#data" },
+		var_in { "const char *", "data" },
+		var_in { "size_t", "off?" },
+		c_source [[
+	if(${off} > ${data_len}) ${off} = ${data_len};
+	${tail} = ${data} + ${off};
+	${tail_len} = ${data_len} - ${off};
+]],
+		ffi_source [[
+	if ${off} > ${data_len} then ${off} = ${data_len} end
+	${tail} = ffi.cast("const char *", ${data}) + ${off}
+	${tail_len} = ${data_len} - ${off}
+]],
+		c_method_call "size_t" "hm_parser_append_data"
+			{ "const char *", "(tail)", "size_t", "(tail_len)" },
+		c_source [[
+	hm_lua_gc_check(L);
+]],
+		ffi_source [[
+	hm_gc_check(${this})
+]],
 	},
 
 	method "append_buffer" {
@@ -56,6 +151,73 @@ typedef struct HMHeader {
 ]],
 		c_method_call "size_t" "hm_parser_append_data"
 			{ "const char *", "(data)", "size_t", "(data_len)" },
+		c_source [[
+	hm_lua_gc_check(L);
+]],
+		ffi_source [[
+	hm_gc_check(${this})
+]],
+	},
+
+	method "buffer_high_water" {
+		c_method_call "size_t" "hm_parser_get_buffer_high_water" {},
+	},
+
+	method "memory_used" {
+		c_method_call "size_t" "hm_parser_get_memory_used" {},
+	},
+
+	method "bytes_moved" {
+		c_method_call "uint64_t" "hm_parser_get_bytes_moved" {},
+	},
+
+	-- fill `tbl` with the parser's counters, returns false if they are compiled out.
+	method "stats" {
+		var_in { "<any>", "tbl" },
+		var_out { "bool", "enabled" },
+		c_source [[
+	HMParserStats stats;
+
+	luaL_checktype(L, ${tbl::idx}, LUA_TTABLE);
+	${enabled} = hm_parser_get_stats(${this}, &stats);
+	hm_lua_stats_table(L, ${tbl::idx}, &stats);
+]],
+	},
+
+	method "clear_stats" {
+		c_method_call "void" "hm_parser_clear_stats" {},
+	},
+
+	-- returns bytes read, 0 on EOF or negative errno.
+	method "read_fd" {
+		c_method_call "ssize_t" "hm_parser_read_fd" { "int", "fd", "size_t", "max?" },
+		c_source [[
+	hm_lua_gc_check(L);
+]],
+		ffi_source [[
+	hm_gc_check(${this})
+]],
+	},
+
+	-- `flags` from hm.recv_flags.
+	method "recv" {
+		c_method_call "ssize_t" "hm_parser_recv" { "int", "fd", "size_t", "max?", "int", "flags?" },
+		c_source [[
+	hm_lua_gc_check(L);
+]],
+		ffi_source [[
+	hm_gc_check(${this})
+]],
+	},
+
+	method "readv_fd" {
+		c_method_call "ssize_t" "hm_parser_readv_fd" { "int", "fd", "size_t", "max?" },
+		c_source [[
+	hm_lua_gc_check(L);
+]],
+		ffi_source [[
+	hm_gc_check(${this})
+]],
 	},
 
 	method "eof" {
@@ -65,15 +227,118 @@ typedef struct HMHeader {
 	-- control parser.
 
 	method "reset" {
-		c_method_call "void" "hm_parser_reset" {},
+		c_method_call "bool" "hm_parser_reset" {},
 	},
 
 	method "next_message" {
 		c_method_call "void" "hm_parser_next_message" {},
 	},
 
+	method "detach_message" {
+		c_method_call "!HMMessage *" "hm_parser_detach_message" {},
+	},
+
+	-- monotonic timestamps in nanoseconds, from a HM_PARSER_OPT_TIMING parser.
+	method "timing" {
+		var_out { "uint64_t", "first_byte" },
+		var_out { "uint64_t", "message_begin" },
+		var_out { "uint64_t", "headers_complete" },
+		var_out { "uint64_t", "message_complete" },
+		c_source [[
+	HMTiming timing;
+
+	hm_parser_get_timing(${this}, &timing);
+	${first_byte} = timing.first_byte;
+	${message_begin} = timing.message_begin;
+	${headers_complete} = timing.headers_complete;
+	${message_complete} = timing.message_complete;
+]],
+	},
+
+	method "set_max_header_size" {
+		c_method_call "void" "hm_parser_set_max_header_size" { "uint32_t", "size" },
+	},
+
+	method "set_max_buffer_size" {
+		c_method_call "void" "hm_parser_set_max_buffer_size" { "size_t", "size" },
+	},
+
+	-- zero or nil for no limit.
+	method "set_limits" {
+		var_in { "uint32_t", "max_url?" },
+		var_in { "uint32_t", "max_header_size?" },
+		var_in { "uint32_t", "max_headers?" },
+		var_in { "size_t", "max_buffer?" },
+		var_in { "uint64_t", "max_body?" },
+		c_source [[
+	HMParserLimits limits;
+
+	limits.max_url = ${max_url};
+	limits.max_header_size = ${max_header_size};
+	limits.max_headers = ${max_headers};
+	limits.max_buffer = ${max_buffer};
+	limits.max_body = ${max_body};
+	hm_parser_set_limits(${this}, &limits);
+]],
+	},
+
+	-- which limit stopped the parser, see hm.limits.
+	method "limit" {
+		c_method_call "int" "hm_parser_limit" {},
+	},
+
 	method "execute" {
 		c_method_call "int" "hm_parser_execute" {},
+		c_source [[
+	hm_lua_gc_check(L);
+]],
+		ffi_source [[
+	hm_gc_check(${this})
+]],
+	},
+
+	-- parse `data` without copying it into the buffer, see hm_parser_execute_external().
+	-- The parser keeps a reference to `data` until the next call.
+	method "execute_external" {
+		var_in { "const char *", "data" },
+		c_source [[
+	hm_lua_anchors(L, 1);
+	lua_pushvalue(L, ${data::idx});
+	lua_setfield(L, -2, "external");
+	lua_pop(L, 1);
+]],
+		ffi_source [[
+	hm_anchors(${this}).external = ${data}
+]],
+		c_method_call "int" "hm_parser_execute_external" { "const char *", "data", "size_t", "#data" },
+		c_source [[
+	hm_lua_gc_check(L);
+]],
+		ffi_source [[
+	hm_gc_check(${this})
+]],
+	},
+
+	-- fill `tbl` with the completed messages from a HM_PARSER_OPT_BATCH parser.
+	method "batch_messages" {
+		var_in { "<any>", "tbl" },
+		var_out { "uint32_t", "count" },
+		c_source [[
+	HMMessage *msg;
+	uint32_t idx;
+
+	luaL_checktype(L, ${tbl::idx}, LUA_TTABLE);
+	${count} = hm_parser_batch_count(${this});
+	for(idx = 0; idx < ${count}; idx++) {
+		msg = hm_parser_batch_take(${this}, idx);
+		if(msg != NULL) {
+			obj_type_HMMessage_push(L, msg, OBJ_UDATA_FLAG_OWN);
+		} else {
+			lua_pushboolean(L, 0);
+		}
+		lua_rawseti(L, ${tbl::idx}, idx + 1);
+	}
+]],
 	},
 
 	-- get url/headers/body chunks
@@ -91,6 +356,55 @@ typedef struct HMHeader {
 			{ "size_t", "&#url" },
 	},
 
+	-- data after the last parsed message, like the start of the new protocol after an upgrade.
+	method "get_unparsed" {
+		c_method_call { "const char *", "data", has_length = 1 } "hm_parser_get_unparsed"
+			{ "size_t", "&#data" },
+	},
+
+	-- one url component (see hm.url_fields), use get_url_parts() for more then one field.
+	method "get_url_field" {
+		var_in { "uint32_t", "field" },
+		var_out { "const char *", "value", has_length = 1 },
+		c_source [[
+	HMUrl u;
+	const char *url;
+	size_t len;
+
+	url = hm_parser_get_url(${this}, &len);
+	if(${field} < HM_URL_FIELDS && hm_parser_get_url_parts(${this}, &u) == 0 &&
+			hm_url_has_field(&u, ${field})) {
+		${value} = url + u.field[${field}].off;
+		${value_len} = u.field[${field}].len;
+	}
+]],
+	},
+
+	-- split the url once: fills `tbl` with the { offset, length } pairs of all url fields
+	-- (offsets start at 0, -1 for missing fields) in hm.url_fields order.
+	-- Returns the url and port number, nil if there is no url or it is invalid.
+	method "get_url_parts" {
+		var_in { "<any>", "tbl" },
+		var_out { "const char *", "url", has_length = 1 },
+		var_out { "uint32_t", "port" },
+		c_source [[
+	HMUrl u;
+
+	luaL_checktype(L, ${tbl::idx}, LUA_TTABLE);
+	if(hm_parser_get_url_parts(${this}, &u) == 0) {
+		${url} = hm_parser_get_url(${this}, &(${url_len}));
+		${port} = u.port;
+		hm_lua_url_parts(L, ${tbl::idx}, &u);
+	}
+]],
+		ffi_source [[
+	if C.hm_parser_get_url_parts(${this}, hm_url_tmp) ~= 0 then return nil end
+	local url = C.hm_parser_get_url(${this}, hm_url_len_tmp)
+	hm_url_parts(${tbl})
+	return ffi_string(url, hm_url_len_tmp[0]), hm_url_tmp.port
+]],
+	},
+
 	method "get_header" {
 		var_out { "uint32_t", "name_id" },
 		var_out { "const char *", "name", has_length = 1 },
@@ -120,11 +434,141 @@ typedef struct HMHeader {
 ]],
 	},
 
+	-- fill `tbl` with name/value pairs: { name1, value1, name2, value2, ... }
+	-- known header names are returned as header ids.  Old entries after the
+	-- last pair are cleared, so `tbl` can be reused.
+	method "get_headers" {
+		var_in { "<any>", "tbl" },
+		var_out { "uint32_t", "count" },
+		c_source [[
+	HMHeader tmp[HM_LUA_HEADERS_MAX];
+	HMHeader *headers = tmp;
+	HMHeader *header;
+	uint32_t idx;
+
+	luaL_checktype(L, ${tbl::idx}, LUA_TTABLE);
+	${count} = hm_parser_count_headers(${this});
+	if(${count} > HM_LUA_HEADERS_MAX) {
+		headers = (HMHeader *)lua_newuserdata(L, ${count} * sizeof(HMHeader));
+	}
+	${count} = hm_parser_get_headers(${this}, headers, ${count});
+	for(idx = 0; idx < ${count}; idx++) {
+		header = headers + idx;
+		if(header->name_id > 0) {
+			lua_pushinteger(L, header->name_id);
+		} else {
+			lua_pushlstring(L, header->name, header->name_len);
+		}
+		lua_rawseti(L, ${tbl::idx}, (idx * 2) + 1);
+		lua_pushlstring(L, header->value, header->value_len);
+		lua_rawseti(L, ${tbl::idx}, (idx * 2) + 2);
+	}
+	hm_lua_clear_table(L, ${tbl::idx}, (${count} * 2) + 1);
+]],
+		ffi_source [[
+	local count = C.hm_parser_count_headers(${this})
+	if count > hm_headers_max then
+		hm_headers_max = count
+		hm_headers_tmp = ffi.new("HMHeader[?]", hm_headers_max)
+	end
+	${count} = C.hm_parser_get_headers(${this}, hm_headers_tmp, count)
+	local headers = hm_headers_tmp
+	for i=0,${count}-1 do
+		local header = headers[i]
+		local id = header.name_id
+		if id > 0 then
+			${tbl}[(i * 2) + 1] = id
+		else
+			${tbl}[(i * 2) + 1] = ffi_string(header.name, header.name_len)
+		end
+		${tbl}[(i * 2) + 2] = ffi_string(header.value, header.value_len)
+	end
+	local i = (${count} * 2) + 1
+	while ${tbl}[i] ~= nil do
+		${tbl}[i] = nil
+		i = i + 1
+	end
+]],
+	},
+
+	-- lookup headers by id, without scanning all headers.
+	method "find_header" {
+		c_method_call { "const char *", "value", has_length = 1 } "hm_parser_find_header"
+			{ "int", "id", "size_t", "&#value" },
+	},
+
+	-- one item of a list or Cookie header, searched in all headers with id `id`:
+	-- returns the item's value ("" if it has no value, quoted values are unescaped),
+	-- q-value, ";" parameters and flags (see hm.header_item_flags) or nil.
+	method "find_header_item" {
+		var_in { "int", "id" },
+		var_in { "const char *", "key" },
+		c_source [[
+	HMHeaderItem item;
+	HMHeader *header;
+	int idx;
+
+	idx = hm_parser_find_header_idx(${this}, ${id});
+	for(; idx >= 0; idx = hm_parser_next_header_idx(${this}, idx)) {
+		header = hm_parser_get_header(${this}, idx);
+		if(hm_header_value_find(${id}, header->value, header->value_len,
+				${key}, ${key_len}, &item) == 0) {
+			return hm_lua_push_item(L, header->value, &item);
+		}
+	}
+	lua_pushnil(L);
+	return 1;
+]],
+	},
+
+	-- fill `tbl` with the items of all list or Cookie headers with id `id`:
+	-- { key1, value1, q1, params1, flags1, key2, ... }, returns the number of items.
+	method "get_header_items" {
+		var_in { "int", "id" },
+		var_in { "<any>", "tbl" },
+		var_out { "uint32_t", "count" },
+		c_source [[
+	HMHeader *header;
+	int idx;
+
+	luaL_checktype(L, ${tbl::idx}, LUA_TTABLE);
+	${count} = 0;
+	idx = hm_parser_find_header_idx(${this}, ${id});
+	for(; idx >= 0; idx = hm_parser_next_header_idx(${this}, idx)) {
+		header = hm_parser_get_header(${this}, idx);
+		${count} += hm_lua_header_items(L, ${tbl::idx}, ${count}, ${id}, header);
+	}
+	hm_lua_clear_table(L, ${tbl::idx}, (${count} * 5) + 1);
+]],
+	},
+
+	method "find_header_idx" {
+		c_method_call "int" "hm_parser_find_header_idx" { "int", "id" },
+	},
+
+	method "next_header_idx" {
+		c_method_call "int" "hm_parser_next_header_idx" { "uint32_t", "idx" },
+	},
+
 	method "next_body" {
 		c_method_call { "const char *", "body", has_length = 1 } "hm_parser_next_body"
 			{ "size_t", "&#body" },
 	},
 
+	-- zero-copy slices of url/header values/body chunks.
+
+	method "get_url_slice" {
+		c_method_call "!HMSlice *" "hm_parser_get_url_slice" {},
+	},
+
+	method "get_header_slice" {
+		c_method_call "!HMSlice *" "hm_parser_get_header_slice" { "uint32_t", "idx" },
+	},
+
+	method "next_body_slice" {
+		c_method_call "!HMSlice *" "hm_parser_next_body_slice" {},
+	},
+
 	-- standard http-parser methods
 	method "should_keep_alive" {
 		c_method_call "bool" "hm_parser_should_keep_alive" {},
@@ -0,0 +1,130 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hm_parser_pool.h"
+
+struct HMParserPool {
+	HMParser      **idle;       /**< reset parsers ready for re-use. */
+	uint32_t      count;        /**< number of idle parsers. */
+	uint32_t      max_idle;     /**< size of `idle`. */
+	uint32_t      opts;         /**< HM_PARSER_OPT_* flags for new parsers. */
+	int           is_request;
+	HMParserLimits limits;      /**< limits for new & released parsers. */
+	HMHistogram   *phase_hist;  /**< HM_PARSER_PHASES histograms, with HM_PARSER_OPT_TIMING. */
+	HMAllocator   *allocator;
+};
+
+static HMParserPool *hm_parser_pool_new(int is_request, uint32_t opts, uint32_t max_idle,
+		HMAllocator *allocator) {
+	HMParserPool *pool;
+
+	if(!HM_PARSER_OPTS_VALID(opts)) {
+		return NULL;
+	}
+	if(max_idle == 0) {
+		max_idle = HM_PARSER_POOL_MAX_IDLE;
+	}
+	if(allocator == NULL) {
+		allocator = hm_allocator_default();
+	}
+	pool = (HMParserPool *)hm_alloc_malloc(allocator, sizeof(HMParserPool));
+	if(pool == NULL) {
+		return NULL;
+	}
+	/* the idle list is allocated up-front, so releasing a parser never allocates. */
+	pool->idle = (HMParser **)hm_alloc_malloc(allocator, sizeof(HMParser *) * max_idle);
+	if(pool->idle == NULL) {
+		hm_alloc_free(allocator, pool, sizeof(HMParserPool));
+		return NULL;
+	}
+	pool->phase_hist = NULL;
+	if(opts & HM_PARSER_OPT_TIMING) {
+		uint32_t idx;
+		pool->phase_hist = (HMHistogram *)hm_alloc_malloc(allocator,
+			sizeof(HMHistogram) * HM_PARSER_PHASES);
+		if(pool->phase_hist == NULL) {
+			hm_alloc_free(allocator, pool->idle, sizeof(HMParser *) * max_idle);
+			hm_alloc_free(allocator, pool, sizeof(HMParserPool));
+			return NULL;
+		}
+		for(idx = 0; idx < HM_PARSER_PHASES; idx++) {
+			hm_histogram_init(&(pool->phase_hist[idx]));
+		}
+	}
+	pool->count = 0;
+	pool->allocator = allocator;
+	pool->max_idle = max_idle;
+	pool->is_request = is_request;
+	pool->opts = opts | HM_PARSER_OPT_SINGLE_ALLOC;
+	memset(&(pool->limits), 0, sizeof(HMParserLimits));
+	return pool;
+}
+
+HMParserPool *hm_parser_pool_new_request(uint32_t opts, uint32_t max_idle,
+		HMAllocator *allocator) {
+	return hm_parser_pool_new(1, opts, max_idle, allocator);
+}
+
+HMParserPool *hm_parser_pool_new_response(uint32_t opts, uint32_t max_idle,
+		HMAllocator *allocator) {
+	return hm_parser_pool_new(0, opts, max_idle, allocator);
+}
+
+void hm_parser_pool_free(HMParserPool *pool) {
+	uint32_t idx;
+
+	for(idx = 0; idx < pool->count; idx++) {
+		hm_parser_free(pool->idle[idx]);
+	}
+	hm_alloc_free(pool->allocator, pool->idle, sizeof(HMParser *) * pool->max_idle);
+	hm_alloc_free(pool->allocator, pool->phase_hist, sizeof(HMHistogram) * HM_PARSER_PHASES);
+	hm_alloc_free(pool->allocator, pool, sizeof(HMParserPool));
+}
+
+void hm_parser_pool_set_limits(HMParserPool *pool, const HMParserLimits *limits) {
+	pool->limits = *limits;
+}
+
+HMParser *hm_parser_pool_acquire(HMParserPool *pool) {
+	HMParser *hm_parser;
+
+	if(pool->count > 0) {
+		hm_parser = pool->idle[--pool->count];
+	} else if(pool->is_request) {
+		hm_parser = hm_parser_new_request_alloc(pool->opts, pool->allocator);
+	} else {
+		hm_parser = hm_parser_new_response_alloc(pool->opts, pool->allocator);
+	}
+	if(hm_parser != NULL) {
+		hm_parser_set_limits(hm_parser, &(pool->limits));
+		hm_parser_set_phase_histograms(hm_parser, pool->phase_hist);
+	}
+	return hm_parser;
+}
+
+HMHistogram *hm_parser_pool_get_phase_histogram(HMParserPool *pool, uint32_t phase) {
+	if(pool->phase_hist == NULL || phase >= HM_PARSER_PHASES) {
+		return NULL;
+	}
+	return &(pool->phase_hist[phase]);
+}
+
+void hm_parser_pool_release(HMParserPool *pool, HMParser *hm_parser) {
+	if(pool->count >= pool->max_idle || !hm_parser_reset(hm_parser)) {
+		hm_parser_free(hm_parser);
+		return;
+	}
+	hm_parser_clear_stats(hm_parser);
+	hm_parser_set_max_header_size(hm_parser, HM_PARSER_MAX_HEADER_SIZE);
+	pool->idle[pool->count++] = hm_parser;
+}
+
+uint32_t hm_parser_pool_count(HMParserPool *pool) {
+	return pool->count;
+}
+
@@ -0,0 +1,108 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+#if !defined(__HM_PARSER_POOL_H__)
+#define __HM_PARSER_POOL_H__
+
+#include "hm_parser.h"
+
+/* default number of idle parsers kept by a pool. */
+#define HM_PARSER_POOL_MAX_IDLE           256
+
+/**
+ * Pool of idle parsers.
+ *
+ * Released parsers are reset and kept (with their buffer) for the next connection,
+ * so accepting and closing connections doesn't allocate once the pool is warm.
+ * New parsers are created with HM_PARSER_OPT_SINGLE_ALLOC.
+ *
+ * @ingroup Objects
+ */
+typedef struct HMParserPool HMParserPool;
+
+/**
+ * Create a pool of HTTP Request parsers.
+ *
+ * @param opts HM_PARSER_OPT_* flags used for each parser.
+ * @param max_idle max. number of idle parsers to keep (0 = HM_PARSER_POOL_MAX_IDLE).
+ * @param allocator allocator for the pool and it's parsers (NULL for the default allocator).
+ * @return pointer to new HMParserPool.
+ * @public @memberof HMParserPool
+ */
+L_LIB_API HMParserPool *hm_parser_pool_new_request(uint32_t opts, uint32_t max_idle,
+	HMAllocator *allocator);
+
+/**
+ * Create a pool of HTTP Response parsers.
+ *
+ * @param opts HM_PARSER_OPT_* flags used for each parser.
+ * @param max_idle max. number of idle parsers to keep (0 = HM_PARSER_POOL_MAX_IDLE).
+ * @param allocator allocator for the pool and it's parsers (NULL for the default allocator).
+ * @return pointer to new HMParserPool.
+ * @public @memberof HMParserPool
+ */
+L_LIB_API HMParserPool *hm_parser_pool_new_response(uint32_t opts, uint32_t max_idle,
+	HMAllocator *allocator);
+
+/**
+ * Free instance of HMParserPool and it's idle parsers.  Parsers that are still
+ * acquired must be freed with hm_parser_free().
+ *
+ * @param pool pointer to HMParserPool instance to free
+ * @public @memberof HMParserPool
+ */
+L_LIB_API void hm_parser_pool_free(HMParserPool *pool);
+
+/**
+ * Get an idle parser from the pool, or create a new parser if the pool is empty.
+ *
+ * @param pool pointer to HMParserPool structure.
+ * @return parser in it's initial state or NULL if the allocation failed.
+ * @public @memberof HMParserPool
+ */
+L_LIB_API HMParser *hm_parser_pool_acquire(HMParserPool *pool);
+
+/**
+ * Reset a parser and return it to the pool.  The parser is freed if the pool is full.
+ *
+ * The parser's max. header size is set back to the default and it's counters are
+ * cleared, it's limits are set to the pool's limits by hm_parser_pool_acquire().
+ *
+ * @param pool pointer to HMParserPool structure.
+ * @param hm_parser parser from hm_parser_pool_acquire().
+ * @public @memberof HMParserPool
+ */
+L_LIB_API void hm_parser_pool_release(HMParserPool *pool, HMParser *hm_parser);
+
+/**
+ * Set the limits of parsers from this pool, see hm_parser_set_limits().
+ *
+ * Idle parsers get the new limits when they are acquired.
+ *
+ * @param pool pointer to HMParserPool structure.
+ * @param limits new limits.
+ * @public @memberof HMParserPool
+ */
+L_LIB_API void hm_parser_pool_set_limits(HMParserPool *pool, const HMParserLimits *limits);
+
+/**
+ * Histogram of a message phase (HM_PARSER_PHASE_*) in nanoseconds, recorded by all
+ * parsers from this pool.
+ *
+ * @param pool pointer to HMParserPool structure.
+ * @param phase HM_PARSER_PHASE_*.
+ * @return NULL if the pool wasn't created with HM_PARSER_OPT_TIMING.
+ * @public @memberof HMParserPool
+ */
+L_LIB_API HMHistogram *hm_parser_pool_get_phase_histogram(HMParserPool *pool, uint32_t phase);
+
+/**
+ * Number of idle parsers in the pool.
+ *
+ * @public @memberof HMParserPool
+ */
+L_LIB_API uint32_t hm_parser_pool_count(HMParserPool *pool);
+
+#endif /* __HM_PARSER_POOL_H__ */
+
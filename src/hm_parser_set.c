@@ -0,0 +1,272 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hm_parser_set.h"
+
+#include "hm_parser_pool.h"
+
+#define MIN_PARSERS 64
+#define MIN_EVENTS 64
+
+typedef struct HMParserSetEntry HMParserSetEntry;
+
+struct HMParserSetEntry {
+	HMParser      *parser;
+	bool          upgraded;     /**< the connection switched protocols, stop parsing. */
+};
+
+struct HMParserSet {
+	HMParserSetEntry *parsers;  /**< parsers indexed by file descriptor. */
+	uint32_t      max_fd;       /**< size of `parsers`. */
+	uint32_t      count;        /**< number of parsers. */
+	HMParserPool  *pool;        /**< re-use parsers from closed connections. */
+	HMAllocator   *allocator;
+	HMParserEvent *events;
+	uint32_t      events_len;
+	uint32_t      events_cap;
+};
+
+static HMParserSet *hm_parser_set_new(int is_request, uint32_t opts, HMAllocator *allocator) {
+	HMParserSet *set;
+
+	if(allocator == NULL) {
+		allocator = hm_allocator_default();
+	}
+	set = (HMParserSet *)hm_alloc_malloc(allocator, sizeof(HMParserSet));
+	if(set == NULL) {
+		return NULL;
+	}
+	memset(set, 0, sizeof(HMParserSet));
+	set->allocator = allocator;
+	if(is_request) {
+		set->pool = hm_parser_pool_new_request(opts, 0, allocator);
+	} else {
+		set->pool = hm_parser_pool_new_response(opts, 0, allocator);
+	}
+	if(set->pool == NULL) {
+		hm_alloc_free(allocator, set, sizeof(HMParserSet));
+		return NULL;
+	}
+	return set;
+}
+
+HMParserSet *hm_parser_set_new_request(uint32_t opts) {
+	return hm_parser_set_new(1, opts, NULL);
+}
+
+HMParserSet *hm_parser_set_new_response(uint32_t opts) {
+	return hm_parser_set_new(0, opts, NULL);
+}
+
+HMParserSet *hm_parser_set_new_request_alloc(uint32_t opts, HMAllocator *allocator) {
+	return hm_parser_set_new(1, opts, allocator);
+}
+
+HMParserSet *hm_parser_set_new_response_alloc(uint32_t opts, HMAllocator *allocator) {
+	return hm_parser_set_new(0, opts, allocator);
+}
+
+void hm_parser_set_free(HMParserSet *set) {
+	uint32_t fd;
+
+	hm_parser_set_clear_events(set);
+	for(fd = 0; fd < set->max_fd; fd++) {
+		if(set->parsers[fd].parser != NULL) {
+			hm_parser_free(set->parsers[fd].parser);
+		}
+	}
+	hm_parser_pool_free(set->pool);
+	hm_alloc_free(set->allocator, set->parsers, sizeof(HMParserSetEntry) * set->max_fd);
+	hm_alloc_free(set->allocator, set->events, sizeof(HMParserEvent) * set->events_cap);
+	hm_alloc_free(set->allocator, set, sizeof(HMParserSet));
+}
+
+void hm_parser_set_set_limits(HMParserSet *set, const HMParserLimits *limits) {
+	hm_parser_pool_set_limits(set->pool, limits);
+}
+
+HMHistogram *hm_parser_set_get_phase_histogram(HMParserSet *set, uint32_t phase) {
+	return hm_parser_pool_get_phase_histogram(set->pool, phase);
+}
+
+HMParser *hm_parser_set_add(HMParserSet *set, int fd) {
+	HMParser *hm_parser;
+
+	if(fd < 0) {
+		return NULL;
+	}
+	/* grow parser index. */
+	if((uint32_t)fd >= set->max_fd) {
+		uint32_t max_fd = (set->max_fd > 0) ? set->max_fd : MIN_PARSERS;
+		HMParserSetEntry *parsers;
+		while(max_fd <= (uint32_t)fd) max_fd *= 2;
+		parsers = (HMParserSetEntry *)hm_alloc_realloc(set->allocator, set->parsers,
+			sizeof(HMParserSetEntry) * set->max_fd, sizeof(HMParserSetEntry) * max_fd);
+		if(parsers == NULL) {
+			return NULL;
+		}
+		memset(parsers + set->max_fd, 0, sizeof(HMParserSetEntry) * (max_fd - set->max_fd));
+		set->parsers = parsers;
+		set->max_fd = max_fd;
+	}
+	if(set->parsers[fd].parser != NULL) {
+		return NULL;
+	}
+	hm_parser = hm_parser_pool_acquire(set->pool);
+	if(hm_parser != NULL) {
+		set->parsers[fd].parser = hm_parser;
+		set->parsers[fd].upgraded = false;
+		set->count++;
+	}
+	return hm_parser;
+}
+
+HMParser *hm_parser_set_get(HMParserSet *set, int fd) {
+	if(fd < 0 || (uint32_t)fd >= set->max_fd) {
+		return NULL;
+	}
+	return set->parsers[fd].parser;
+}
+
+void hm_parser_set_remove(HMParserSet *set, int fd) {
+	HMParser *hm_parser = hm_parser_set_get(set, fd);
+	if(hm_parser != NULL) {
+		hm_parser_pool_release(set->pool, hm_parser);
+		set->parsers[fd].parser = NULL;
+		set->parsers[fd].upgraded = false;
+		set->count--;
+	}
+}
+
+uint32_t hm_parser_set_count(HMParserSet *set) {
+	return set->count;
+}
+
+void hm_parser_set_clear_events(HMParserSet *set) {
+	HMParserEvent *event = set->events;
+	HMParserEvent *end = event + set->events_len;
+
+	for(; event < end; event++) {
+		if(event->msg != NULL) {
+			hm_message_free(event->msg);
+		}
+	}
+	set->events_len = 0;
+}
+
+static bool hm_parser_set_push_event(HMParserSet *set, int fd, int type, int err, HMMessage *msg) {
+	HMParserEvent *event;
+
+	if(set->events_len >= set->events_cap) {
+		uint32_t cap = (set->events_cap > 0) ? set->events_cap * 2 : MIN_EVENTS;
+		event = (HMParserEvent *)hm_alloc_realloc(set->allocator, set->events,
+			sizeof(HMParserEvent) * set->events_cap, sizeof(HMParserEvent) * cap);
+		if(event == NULL) {
+			if(msg != NULL) {
+				hm_message_free(msg);
+			}
+			return false;
+		}
+		set->events = event;
+		set->events_cap = cap;
+	}
+	event = set->events + set->events_len++;
+	event->fd = fd;
+	event->type = type;
+	event->err = err;
+	event->msg = msg;
+	return true;
+}
+
+/* MESSAGE or UPGRADE event for a detached message, an ENOMEM error if it's NULL. */
+static void hm_parser_set_push_message(HMParserSet *set, int fd, HMMessage *msg, bool upgrade) {
+	if(msg == NULL) {
+		hm_parser_set_push_event(set, fd, HM_PARSER_EVENT_ERROR, -ENOMEM, NULL);
+	} else {
+		hm_parser_set_push_event(set, fd,
+			upgrade ? HM_PARSER_EVENT_UPGRADE : HM_PARSER_EVENT_MESSAGE, 0, msg);
+	}
+}
+
+uint32_t hm_parser_set_process_fd(HMParserSet *set, int fd) {
+	HMParser *hm_parser = hm_parser_set_get(set, fd);
+	uint32_t len = set->events_len;
+	ssize_t rc;
+	int state;
+
+	if(hm_parser == NULL) {
+		hm_parser_set_push_event(set, fd, HM_PARSER_EVENT_ERROR, -EBADF, NULL);
+		return set->events_len - len;
+	}
+	if(set->parsers[fd].upgraded) {
+		/* the connection isn't HTTP anymore. */
+		return 0;
+	}
+	rc = hm_parser_read_fd(hm_parser, fd, 0);
+	if(rc < 0 && rc != -EAGAIN && rc != -EWOULDBLOCK) {
+		hm_parser_set_push_event(set, fd, HM_PARSER_EVENT_ERROR, rc, NULL);
+		return set->events_len - len;
+	}
+	/* parse everything in the buffer. */
+	do {
+		state = hm_parser_execute(hm_parser);
+		if(hm_parser_batch_count(hm_parser) > 0) {
+			/* HM_PARSER_OPT_BATCH, detach each message from the batch. */
+			uint32_t idx, count = hm_parser_batch_count(hm_parser);
+			for(idx = 0; idx < count; idx++) {
+				/* an upgrade is always the last message of a batch. */
+				if(hm_parser_batch_get(hm_parser, idx)->upgrade) {
+					set->parsers[fd].upgraded = true;
+				}
+				hm_parser_set_push_message(set, fd, hm_parser_batch_take(hm_parser, idx),
+					set->parsers[fd].upgraded);
+			}
+		} else if(state == HM_PARSER_STATE_MESSAGE_COMPLETE ||
+				state == (HM_PARSER_STATE_MESSAGE_COMPLETE | HM_PARSER_STATE_NEEDS_INPUT)) {
+			HMMessage *msg;
+			set->parsers[fd].upgraded = (hm_parser_is_upgrade(hm_parser) != 0);
+			msg = hm_parser_detach_message(hm_parser);
+			if(msg == NULL) {
+				hm_parser_next_message(hm_parser);
+			}
+			hm_parser_set_push_message(set, fd, msg, set->parsers[fd].upgraded);
+			/* continue with the next message. */
+			state = 0;
+		}
+		if(set->parsers[fd].upgraded) {
+			/* the rest of the data belongs to the new protocol, see hm_parser_get_unparsed(). */
+			break;
+		}
+		if(state & HM_PARSER_STATE_ERROR) {
+			hm_parser_set_push_event(set, fd, HM_PARSER_EVENT_ERROR, hm_parser_error(hm_parser), NULL);
+			return set->events_len - len;
+		}
+	} while(!(state & HM_PARSER_STATE_NEEDS_INPUT));
+	if(rc == 0) {
+		hm_parser_set_push_event(set, fd, HM_PARSER_EVENT_EOF, 0, NULL);
+	}
+	return set->events_len - len;
+}
+
+uint32_t hm_parser_set_process(HMParserSet *set, const int *fds, uint32_t count) {
+	uint32_t i;
+
+	hm_parser_set_clear_events(set);
+	for(i = 0; i < count; i++) {
+		hm_parser_set_process_fd(set, fds[i]);
+	}
+	return set->events_len;
+}
+
+HMParserEvent *hm_parser_set_get_events(HMParserSet *set, uint32_t *count) {
+	if(count != NULL) {
+		*count = set->events_len;
+	}
+	return set->events;
+}
+
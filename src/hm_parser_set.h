@@ -0,0 +1,178 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+#if !defined(__HM_PARSER_SET_H__)
+#define __HM_PARSER_SET_H__
+
+#include "hm_message.h"
+
+/* event types. */
+#define HM_PARSER_EVENT_MESSAGE           1
+#define HM_PARSER_EVENT_EOF               2
+#define HM_PARSER_EVENT_ERROR             3
+/* completed Upgrade/CONNECT request (or 101 response), the connection isn't HTTP anymore. */
+#define HM_PARSER_EVENT_UPGRADE           4
+
+typedef struct HMParserEvent HMParserEvent;
+
+struct HMParserEvent {
+	int         fd;
+	int         type;   /**< HM_PARSER_EVENT_* */
+	int         err;    /**< negative errno for read errors, http_parser errno for parse errors. */
+	HMMessage   *msg;   /**< completed/upgrade message, owned by the event until it is taken. */
+};
+
+/**
+ * Set of parsers, one for each connection (file descriptor).
+ *
+ * Reads from and parses many connections in one call, completed messages are
+ * detached from the parsers and returned as events.  Parsers of removed connections
+ * are kept in a HMParserPool for new connections.
+ *
+ * @ingroup Objects
+ */
+typedef struct HMParserSet HMParserSet;
+
+/**
+ * Create a set of HTTP Request parsers.
+ *
+ * @param opts HM_PARSER_OPT_* flags used for each parser.
+ * @return pointer to new HMParserSet.
+ * @public @memberof HMParserSet
+ */
+L_LIB_API HMParserSet *hm_parser_set_new_request(uint32_t opts);
+
+/**
+ * Create a set of HTTP Response parsers.
+ *
+ * @param opts HM_PARSER_OPT_* flags used for each parser.
+ * @return pointer to new HMParserSet.
+ * @public @memberof HMParserSet
+ */
+L_LIB_API HMParserSet *hm_parser_set_new_response(uint32_t opts);
+
+/**
+ * Create a set of HTTP Request parsers that use `allocator`.
+ *
+ * @param opts HM_PARSER_OPT_* flags used for each parser.
+ * @param allocator allocator for the set and it's parsers (NULL for the default allocator).
+ * @return pointer to new HMParserSet.
+ * @public @memberof HMParserSet
+ */
+L_LIB_API HMParserSet *hm_parser_set_new_request_alloc(uint32_t opts, HMAllocator *allocator);
+
+/**
+ * Create a set of HTTP Response parsers that use `allocator`.
+ *
+ * @param opts HM_PARSER_OPT_* flags used for each parser.
+ * @param allocator allocator for the set and it's parsers (NULL for the default allocator).
+ * @return pointer to new HMParserSet.
+ * @public @memberof HMParserSet
+ */
+L_LIB_API HMParserSet *hm_parser_set_new_response_alloc(uint32_t opts, HMAllocator *allocator);
+
+/**
+ * Free instance of HMParserSet, with all of it's parsers and pending events.
+ *
+ * @param set pointer to HMParserSet instance to free
+ * @public @memberof HMParserSet
+ */
+L_LIB_API void hm_parser_set_free(HMParserSet *set);
+
+/**
+ * Create a parser for file descriptor `fd`.
+ *
+ * @param set pointer to HMParserSet structure.
+ * @param fd file descriptor of the connection.
+ * @return the new parser (owned by the set) or NULL if `fd` is invalid or already
+ * has a parser.
+ * @public @memberof HMParserSet
+ */
+L_LIB_API HMParser *hm_parser_set_add(HMParserSet *set, int fd);
+
+/**
+ * Get the parser for file descriptor `fd`.
+ *
+ * @public @memberof HMParserSet
+ */
+L_LIB_API HMParser *hm_parser_set_get(HMParserSet *set, int fd);
+
+/**
+ * Set the limits of parsers added after this call, see hm_parser_set_limits().
+ *
+ * A connection that reaches a limit gets a HM_PARSER_EVENT_ERROR event.
+ *
+ * @public @memberof HMParserSet
+ */
+L_LIB_API void hm_parser_set_set_limits(HMParserSet *set, const HMParserLimits *limits);
+
+/**
+ * Histogram of a message phase (HM_PARSER_PHASE_*) in nanoseconds for all
+ * connections, NULL if the set wasn't created with HM_PARSER_OPT_TIMING.
+ *
+ * @public @memberof HMParserSet
+ */
+L_LIB_API HMHistogram *hm_parser_set_get_phase_histogram(HMParserSet *set, uint32_t phase);
+
+/**
+ * Remove the parser for file descriptor `fd`, it is reset and kept for re-use.
+ *
+ * @public @memberof HMParserSet
+ */
+L_LIB_API void hm_parser_set_remove(HMParserSet *set, int fd);
+
+/**
+ * Number of parsers in the set.
+ *
+ * @public @memberof HMParserSet
+ */
+L_LIB_API uint32_t hm_parser_set_count(HMParserSet *set);
+
+/**
+ * Free all pending events, including messages that where not taken.
+ *
+ * @public @memberof HMParserSet
+ */
+L_LIB_API void hm_parser_set_clear_events(HMParserSet *set);
+
+/**
+ * Read from file descriptor `fd` and parse everything that is in it's buffer.
+ *
+ * Adds an event for each completed message, for EOF and for read/parse errors.
+ * EAGAIN is not an error.  Events are added to the events from earlier calls.
+ *
+ * A message that upgrades the connection gets a HM_PARSER_EVENT_UPGRADE event instead
+ * of HM_PARSER_EVENT_MESSAGE.  After it the fd isn't read or parsed anymore, the bytes
+ * received after the message are left in the parser (see hm_parser_get_unparsed()).
+ *
+ * @param set pointer to HMParserSet structure.
+ * @param fd file descriptor with data to read (must have a parser).
+ * @return number of events added.
+ * @public @memberof HMParserSet
+ */
+L_LIB_API uint32_t hm_parser_set_process_fd(HMParserSet *set, int fd);
+
+/**
+ * Clear the old events, then read & parse each of the file descriptors in `fds`.
+ *
+ * @param set pointer to HMParserSet structure.
+ * @param fds file descriptors that are ready for reading.
+ * @param count number of file descriptors in `fds`.
+ * @return number of events.
+ * @public @memberof HMParserSet
+ */
+L_LIB_API uint32_t hm_parser_set_process(HMParserSet *set, const int *fds, uint32_t count);
+
+/**
+ * Get the pending events.  Set the event's `msg` to NULL to take ownership of the message.
+ *
+ * @param set pointer to HMParserSet structure.
+ * @param count returns the number of events.
+ * @return array of events.
+ * @public @memberof HMParserSet
+ */
+L_LIB_API HMParserEvent *hm_parser_set_get_events(HMParserSet *set, uint32_t *count);
+
+#endif /* __HM_PARSER_SET_H__ */
+
@@ -0,0 +1,166 @@
+-- Copyright (c) 2011 by Robert G. Jakabosky <bobby@sharedrealm.com>
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+
+object "HMParserSet" {
+	include"hm_parser_set.h",
+	destructor {
+		c_method_call "void" "hm_parser_set_free" {},
+	},
+
+	-- parsers are owned by the set, a parser can't be used after `remove(fd)` or
+	-- after the set is freed.
+	method "add" {
+		var_in { "int", "fd" },
+		var_out { "HMParser *", "parser" },
+		c_source [[
+	${parser} = hm_parser_set_add(${this}, ${fd});
+	if(${parser} != NULL) {
+		/* keep the parser's userdata, so remove() can invalidate it. */
+		hm_lua_anchors(L, 1);
+		obj_type_HMParser_push(L, ${parser}, 0);
+		lua_rawseti(L, -2, ${fd});
+		lua_pop(L, 1);
+	}
+]],
+	},
+
+	method "get" {
+		c_method_call "HMParser *" "hm_parser_set_get" { "int", "fd" },
+	},
+
+	-- limits for parsers added after this call, see HMParser:set_limits().
+	method "set_limits" {
+		var_in { "uint32_t", "max_url?" },
+		var_in { "uint32_t", "max_header_size?" },
+		var_in { "uint32_t", "max_headers?" },
+		var_in { "size_t", "max_buffer?" },
+		var_in { "uint64_t", "max_body?" },
+		c_source [[
+	HMParserLimits limits;
+
+	limits.max_url = ${max_url};
+	limits.max_header_size = ${max_header_size};
+	limits.max_headers = ${max_headers};
+	limits.max_buffer = ${max_buffer};
+	limits.max_body = ${max_body};
+	hm_parser_set_set_limits(${this}, &limits);
+]],
+	},
+
+	-- fill `tbl` with the count/min/max/mean/p50/p90/p99/p999 of a message phase in
+	-- nanoseconds (see hm.phases), returns false without HM_PARSER_OPT_TIMING.
+	method "phase_histogram" {
+		var_in { "uint32_t", "phase" },
+		var_in { "<any>", "tbl" },
+		var_out { "bool", "enabled" },
+		c_source [[
+	HMHistogram *hist;
+
+	luaL_checktype(L, ${tbl::idx}, LUA_TTABLE);
+	hist = hm_parser_set_get_phase_histogram(${this}, ${phase});
+	${enabled} = (hist != NULL);
+	if(hist != NULL) {
+		lua_pushnumber(L, (lua_Number)hist->count);
+		lua_setfield(L, ${tbl::idx}, "count");
+		lua_pushnumber(L, (lua_Number)(hist->count > 0 ? hist->min : 0));
+		lua_setfield(L, ${tbl::idx}, "min");
+		lua_pushnumber(L, (lua_Number)hist->max);
+		lua_setfield(L, ${tbl::idx}, "max");
+		lua_pushnumber(L, hm_histogram_mean(hist));
+		lua_setfield(L, ${tbl::idx}, "mean");
+		lua_pushnumber(L, (lua_Number)hm_histogram_percentile(hist, 50.0));
+		lua_setfield(L, ${tbl::idx}, "p50");
+		lua_pushnumber(L, (lua_Number)hm_histogram_percentile(hist, 90.0));
+		lua_setfield(L, ${tbl::idx}, "p90");
+		lua_pushnumber(L, (lua_Number)hm_histogram_percentile(hist, 99.0));
+		lua_setfield(L, ${tbl::idx}, "p99");
+		lua_pushnumber(L, (lua_Number)hm_histogram_percentile(hist, 99.9));
+		lua_setfield(L, ${tbl::idx}, "p999");
+	}
+]],
+	},
+
+	method "remove" {
+		var_in { "int", "fd" },
+		c_source [[
+	int flags = 0;
+
+	/* the parser is reset & re-used for another fd, invalidate it's userdata. */
+	hm_lua_anchors(L, 1);
+	lua_rawgeti(L, -1, ${fd});
+	if(!lua_isnil(L, -1)) {
+		obj_type_HMParser_delete(L, lua_gettop(L), &flags);
+		lua_pushnil(L);
+		lua_rawseti(L, -3, ${fd});
+	}
+	lua_pop(L, 2);
+	hm_parser_set_remove(${this}, ${fd});
+]],
+	},
+
+	method "count" {
+		c_method_call "uint32_t" "hm_parser_set_count" {},
+	},
+
+	-- read & parse each fd in the array `fds`, fill `events` with fd/type/value triples:
+	-- { fd1, type1, value1, fd2, type2, value2, ... }
+	-- value is a HMMessage for MESSAGE/UPGRADE events and an error code for ERROR events.
+	-- An upgraded fd isn't read again, see HMParser:get_unparsed() for the data after
+	-- the upgrade message.
+	-- Old entries after the last triple are cleared, returns the number of events.
+	method "process" {
+		var_in { "<any>", "fds" },
+		var_in { "<any>", "events" },
+		var_out { "uint32_t", "count" },
+		c_source [[
+	HMParserEvent *event;
+	uint32_t n;
+	uint32_t idx;
+
+	luaL_checktype(L, ${fds::idx}, LUA_TTABLE);
+	luaL_checktype(L, ${events::idx}, LUA_TTABLE);
+	hm_parser_set_clear_events(${this});
+	n = lua_objlen(L, ${fds::idx});
+	for(idx = 1; idx <= n; idx++) {
+		lua_rawgeti(L, ${fds::idx}, idx);
+		hm_parser_set_process_fd(${this}, lua_tointeger(L, -1));
+		lua_pop(L, 1);
+	}
+	event = hm_parser_set_get_events(${this}, &(${count}));
+	for(idx = 0; idx < ${count}; idx++, event++) {
+		lua_pushinteger(L, event->fd);
+		lua_rawseti(L, ${events::idx}, (idx * 3) + 1);
+		lua_pushinteger(L, event->type);
+		lua_rawseti(L, ${events::idx}, (idx * 3) + 2);
+		if(event->msg != NULL) {
+			obj_type_HMMessage_push(L, event->msg, OBJ_UDATA_FLAG_OWN);
+			event->msg = NULL;
+		} else {
+			lua_pushinteger(L, event->err);
+		}
+		lua_rawseti(L, ${events::idx}, (idx * 3) + 3);
+	}
+	hm_lua_clear_table(L, ${events::idx}, (${count} * 3) + 1);
+	hm_lua_gc_check(L);
+]],
+	},
+}
+
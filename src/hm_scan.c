@@ -0,0 +1,227 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hm_scan.h"
+
+/* tchar from RFC 7230 */
+static const uint8_t hm_token_chars[256] = {
+	['0' ... '9'] = 1,
+	['A' ... 'Z'] = 1,
+	['a' ... 'z'] = 1,
+	['!'] = 1, ['#'] = 1, ['$'] = 1, ['%'] = 1, ['&'] = 1, ['\''] = 1, ['*'] = 1,
+	['+'] = 1, ['-'] = 1, ['.'] = 1, ['^'] = 1, ['_'] = 1, ['`'] = 1, ['|'] = 1,
+	['~'] = 1,
+};
+
+#define HM_IS_URL_STOP(c) ((c) <= ' ' || (c) == 0x7f)
+#define HM_IS_VALUE_STOP(c) (((c) < ' ' && (c) != '\t') || (c) == 0x7f)
+
+#if defined(__AVX2__)
+#define HM_SCAN_IMPL "avx2"
+#elif defined(__SSE4_2__)
+#define HM_SCAN_IMPL "sse4.2"
+#elif defined(__SSE2__)
+#define HM_SCAN_IMPL "sse2"
+#else
+#define HM_SCAN_IMPL "scalar"
+#endif
+
+const char *hm_scan_impl() {
+	return HM_SCAN_IMPL;
+}
+
+const char *hm_scan_token(const char *p, const char *end) {
+#if defined(__SSE4_2__)
+	/*
+	 * byte ranges that are not tokens, except for '|' and '~' which are
+	 * in the last range and get re-checked by the scalar loop below.
+	 */
+	static const uint8_t ranges[16] = {
+		0x00, ' ', '"', '"', '(', ')', ',', ',', '/', '/', ':', '@', '[', ']', '{', 0xff,
+	};
+	__m128i r = _mm_loadu_si128((const __m128i *)ranges);
+	while(end - p >= 16) {
+		__m128i b = _mm_loadu_si128((const __m128i *)p);
+		int idx = _mm_cmpestri(r, 16, b, 16,
+			_SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+		if(idx != 16) {
+			p += idx;
+			break;
+		}
+		p += 16;
+	}
+#endif
+	while(p < end && hm_token_chars[(uint8_t)*p]) {
+		p++;
+	}
+	return p;
+}
+
+#if defined(__AVX2__)
+/* mask of bytes that are control characters (< ' ') or DEL. */
+static inline int hm_scan_ctl_mask32(__m256i b, int stop_space) {
+	__m256i max = _mm256_set1_epi8(stop_space ? ' ' : ' ' - 1);
+	__m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(b, max), b);
+	if(!stop_space) {
+		/* tab is allowed in header values. */
+		ctl = _mm256_andnot_si256(_mm256_cmpeq_epi8(b, _mm256_set1_epi8('\t')), ctl);
+	}
+	ctl = _mm256_or_si256(ctl, _mm256_cmpeq_epi8(b, _mm256_set1_epi8(0x7f)));
+	return _mm256_movemask_epi8(ctl);
+}
+#endif
+
+#if defined(__SSE2__)
+static inline int hm_scan_ctl_mask16(__m128i b, int stop_space) {
+	__m128i max = _mm_set1_epi8(stop_space ? ' ' : ' ' - 1);
+	__m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(b, max), b);
+	if(!stop_space) {
+		/* tab is allowed in header values. */
+		ctl = _mm_andnot_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8('\t')), ctl);
+	}
+	ctl = _mm_or_si128(ctl, _mm_cmpeq_epi8(b, _mm_set1_epi8(0x7f)));
+	return _mm_movemask_epi8(ctl);
+}
+#endif
+
+/* skip bytes until the first control character, `stop_space` also stops on space. */
+static inline const char *hm_scan_ctl(const char *p, const char *end, int stop_space) {
+#if defined(__AVX2__)
+	while(end - p >= 32) {
+		int mask = hm_scan_ctl_mask32(_mm256_loadu_si256((const __m256i *)p), stop_space);
+		if(mask != 0) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 32;
+	}
+#endif
+#if defined(__SSE2__)
+	while(end - p >= 16) {
+		int mask = hm_scan_ctl_mask16(_mm_loadu_si128((const __m128i *)p), stop_space);
+		if(mask != 0) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 16;
+	}
+#endif
+	if(stop_space) {
+		while(p < end && !HM_IS_URL_STOP((uint8_t)*p)) p++;
+	} else {
+		while(p < end && !HM_IS_VALUE_STOP((uint8_t)*p)) p++;
+	}
+	return p;
+}
+
+const char *hm_scan_url(const char *p, const char *end) {
+	return hm_scan_ctl(p, end, 1);
+}
+
+const char *hm_scan_value(const char *p, const char *end) {
+	return hm_scan_ctl(p, end, 0);
+}
+
+const char *hm_scan_escape(const char *p, const char *end, int plus) {
+	/* without `plus` only look for '%'. */
+	char plus_c = plus ? '+' : '%';
+#if defined(__AVX2__)
+	__m256i pct32 = _mm256_set1_epi8('%');
+	__m256i plus32 = _mm256_set1_epi8(plus_c);
+	while(end - p >= 32) {
+		__m256i b = _mm256_loadu_si256((const __m256i *)p);
+		int mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(b, pct32),
+			_mm256_cmpeq_epi8(b, plus32)));
+		if(mask != 0) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 32;
+	}
+#endif
+#if defined(__SSE2__)
+	{
+		__m128i pct16 = _mm_set1_epi8('%');
+		__m128i plus16 = _mm_set1_epi8(plus_c);
+		while(end - p >= 16) {
+			__m128i b = _mm_loadu_si128((const __m128i *)p);
+			int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(b, pct16),
+				_mm_cmpeq_epi8(b, plus16)));
+			if(mask != 0) {
+				return p + __builtin_ctz(mask);
+			}
+			p += 16;
+		}
+	}
+#endif
+	while(p < end && *p != '%' && *p != plus_c) p++;
+	return p;
+}
+
+/* check for "\n\n" or "\n\r\n" at `p`, returns the length of the match. */
+static inline int hm_scan_is_blank_line(const char *p, const char *end) {
+	if(end - p >= 2 && p[0] == '\n') {
+		if(p[1] == '\n') return 2;
+		if(p[1] == '\r' && end - p >= 3 && p[2] == '\n') return 3;
+	}
+	return 0;
+}
+
+const char *hm_scan_header_end(const char *p, const char *end) {
+	int len;
+#if defined(__AVX2__)
+	__m256i lf32 = _mm256_set1_epi8('\n');
+	__m256i cr32 = _mm256_set1_epi8('\r');
+	/* compare each byte with the next two bytes, to find the LF of an empty line. */
+	while(end - p >= 34) {
+		__m256i b0 = _mm256_loadu_si256((const __m256i *)p);
+		__m256i b1 = _mm256_loadu_si256((const __m256i *)(p + 1));
+		__m256i b2 = _mm256_loadu_si256((const __m256i *)(p + 2));
+		__m256i m = _mm256_and_si256(_mm256_cmpeq_epi8(b0, lf32),
+			_mm256_or_si256(_mm256_cmpeq_epi8(b1, lf32),
+				_mm256_and_si256(_mm256_cmpeq_epi8(b1, cr32), _mm256_cmpeq_epi8(b2, lf32))));
+		int mask = _mm256_movemask_epi8(m);
+		if(mask != 0) {
+			p += __builtin_ctz(mask);
+			return p + hm_scan_is_blank_line(p, end);
+		}
+		p += 32;
+	}
+#endif
+#if defined(__SSE2__)
+	{
+		__m128i lf16 = _mm_set1_epi8('\n');
+		__m128i cr16 = _mm_set1_epi8('\r');
+		while(end - p >= 18) {
+			__m128i b0 = _mm_loadu_si128((const __m128i *)p);
+			__m128i b1 = _mm_loadu_si128((const __m128i *)(p + 1));
+			__m128i b2 = _mm_loadu_si128((const __m128i *)(p + 2));
+			__m128i m = _mm_and_si128(_mm_cmpeq_epi8(b0, lf16),
+				_mm_or_si128(_mm_cmpeq_epi8(b1, lf16),
+					_mm_and_si128(_mm_cmpeq_epi8(b1, cr16), _mm_cmpeq_epi8(b2, lf16))));
+			int mask = _mm_movemask_epi8(m);
+			if(mask != 0) {
+				p += __builtin_ctz(mask);
+				return p + hm_scan_is_blank_line(p, end);
+			}
+			p += 16;
+		}
+	}
+#endif
+	for(; p < end; p++) {
+		if(*p == '\n' && (len = hm_scan_is_blank_line(p, end)) > 0) {
+			return p + len;
+		}
+	}
+	return NULL;
+}
+
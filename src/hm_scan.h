@@ -0,0 +1,54 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+#if !defined(__HM_SCAN_H__)
+#define __HM_SCAN_H__
+
+#include "lcommon.h"
+
+/*
+ * Byte scanners used by the fast header parser and the url decoder.
+ *
+ * Each scanner returns a pointer to the first byte in [p, end) that stops the scan,
+ * or `end` if all bytes are valid.  They never read past `end`.
+ *
+ * SSE4.2/AVX2 versions are used when the compiler targets them (-march=native in
+ * Release builds), otherwise a table driven scalar version is used.
+ */
+
+/**
+ * Skip token characters (RFC 7230), used for methods and header names.
+ */
+L_LIB_API const char *hm_scan_token(const char *p, const char *end);
+
+/**
+ * Skip url characters, stops at control characters and space.
+ */
+L_LIB_API const char *hm_scan_url(const char *p, const char *end);
+
+/**
+ * Skip header value characters, stops at control characters except tab.
+ */
+L_LIB_API const char *hm_scan_value(const char *p, const char *end);
+
+/**
+ * Find the end of a header block (an empty line, CRLF or bare LF line endings).
+ *
+ * @return pointer after the empty line or NULL if it wasn't found.  An empty line
+ * that starts in the last two bytes might not be found until more data is available.
+ */
+L_LIB_API const char *hm_scan_header_end(const char *p, const char *end);
+
+/**
+ * Find the first '%' (and '+' if `plus` is set), used by the url percent-decoder.
+ */
+L_LIB_API const char *hm_scan_escape(const char *p, const char *end, int plus);
+
+/**
+ * Name of the scanner implementation ("avx2", "sse4.2", "sse2" or "scalar").
+ */
+L_LIB_API const char *hm_scan_impl();
+
+#endif /* __HM_SCAN_H__ */
+
@@ -0,0 +1,186 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "hm_url.h"
+#include "hm_scan.h"
+
+static inline void hm_url_set(HMUrl *u, int f, const char *url, const char *start,
+		const char *end) {
+	u->fields |= (1 << f);
+	u->field[f].off = (uint32_t)(start - url);
+	u->field[f].len = (uint32_t)(end - start);
+}
+
+/* [userinfo "@"] host [":" [port]] */
+static int hm_url_authority(HMUrl *u, const char *url, const char *p, const char *end) {
+	const char *at;
+	const char *host;
+	uint32_t port;
+
+	at = (const char *)memchr(p, '@', end - p);
+	if(at != NULL) {
+		hm_url_set(u, HM_URL_USERINFO, url, p, at);
+		p = at + 1;
+	}
+	if(p < end && *p == '[') {
+		/* IPv6 literal. */
+		host = p + 1;
+		p = (const char *)memchr(host, ']', end - host);
+		if(p == NULL) {
+			return -1;
+		}
+		hm_url_set(u, HM_URL_HOST, url, host, p);
+		p++;
+	} else {
+		host = p;
+		p = (const char *)memchr(host, ':', end - host);
+		if(p == NULL) {
+			p = end;
+		}
+		hm_url_set(u, HM_URL_HOST, url, host, p);
+	}
+	if(u->field[HM_URL_HOST].len == 0) {
+		return -1;
+	}
+	if(p == end) {
+		return 0;
+	}
+	if(*p != ':') {
+		return -1;
+	}
+	if(++p == end) {
+		/* empty port is allowed (RFC 3986), same as no port. */
+		return 0;
+	}
+	if((end - p) > 5) {
+		return -1;
+	}
+	port = 0;
+	hm_url_set(u, HM_URL_PORT, url, p, end);
+	for(; p < end; p++) {
+		if(*p < '0' || *p > '9') {
+			return -1;
+		}
+		port = (port * 10) + (*p - '0');
+	}
+	if(port > 65535) {
+		return -1;
+	}
+	u->port = (uint16_t)port;
+	return 0;
+}
+
+int hm_url_parse(const char *url, size_t len, bool is_connect, HMUrl *u) {
+	const char *p = url;
+	const char *end = url + len;
+	const char *mark;
+
+	memset(u, 0, sizeof(HMUrl));
+	if(len == 0) {
+		return -1;
+	}
+	if(is_connect) {
+		/* authority-form must have a port. */
+		if(hm_url_authority(u, url, p, end) != 0 || !hm_url_has_field(u, HM_URL_PORT) ||
+				hm_url_has_field(u, HM_URL_USERINFO)) {
+			return -1;
+		}
+		return 0;
+	}
+	if(len == 1 && *p == '*') {
+		hm_url_set(u, HM_URL_PATH, url, p, end);
+		return 0;
+	}
+	if(*p != '/') {
+		/* absolute-form, scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." ) */
+		if(((*p | 0x20) < 'a' || (*p | 0x20) > 'z')) {
+			return -1;
+		}
+		for(p++; p < end && *p != ':'; p++) {
+			char c = *p;
+			if(!(((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || (c >= '0' && c <= '9') ||
+					c == '+' || c == '-' || c == '.')) {
+				return -1;
+			}
+		}
+		if((end - p) < 3 || p[1] != '/' || p[2] != '/') {
+			return -1;
+		}
+		hm_url_set(u, HM_URL_SCHEME, url, url, p);
+		p += 3;
+		/* authority ends at the path, query or fragment. */
+		for(mark = p; mark < end && *mark != '/' && *mark != '?' && *mark != '#'; mark++);
+		if(hm_url_authority(u, url, p, mark) != 0) {
+			return -1;
+		}
+		p = mark;
+	}
+	if(p == end) {
+		return 0;
+	}
+	/* path ["?" query] ["#" fragment] */
+	mark = (const char *)memchr(p, '#', end - p);
+	if(mark != NULL) {
+		hm_url_set(u, HM_URL_FRAGMENT, url, mark + 1, end);
+		end = mark;
+	}
+	mark = (const char *)memchr(p, '?', end - p);
+	if(mark != NULL) {
+		hm_url_set(u, HM_URL_QUERY, url, mark + 1, end);
+		end = mark;
+	}
+	if(end > p) {
+		hm_url_set(u, HM_URL_PATH, url, p, end);
+	}
+	return 0;
+}
+
+static inline int hm_hex_value(uint8_t c) {
+	if(c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	c |= 0x20;
+	if(c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	return -1;
+}
+
+size_t hm_url_decode(const char *src, size_t len, char *dst, bool plus_as_space) {
+	const char *p = src;
+	const char *end = src + len;
+	const char *esc;
+	char *out = dst;
+	int hi, lo;
+
+	while(p < end) {
+		/* copy the bytes before the next escape, nothing to move when decoding in place. */
+		esc = hm_scan_escape(p, end, plus_as_space);
+		if(esc > p) {
+			if(out != p) {
+				memmove(out, p, esc - p);
+			}
+			out += esc - p;
+			p = esc;
+		}
+		if(p == end) {
+			break;
+		}
+		if(*p == '+') {
+			*out++ = ' ';
+			p++;
+		} else if((end - p) >= 3 && (hi = hm_hex_value(p[1])) >= 0 &&
+				(lo = hm_hex_value(p[2])) >= 0) {
+			*out++ = (char)((hi << 4) | lo);
+			p += 3;
+		} else {
+			*out++ = *p++;
+		}
+	}
+	return out - dst;
+}
+
@@ -0,0 +1,72 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+#if !defined(__HM_URL_H__)
+#define __HM_URL_H__
+
+#include "lcommon.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* url fields, same order as http_parser's UF_* fields. */
+#define HM_URL_SCHEME                     0
+#define HM_URL_HOST                       1
+#define HM_URL_PORT                       2
+#define HM_URL_PATH                       3
+#define HM_URL_QUERY                      4
+#define HM_URL_FRAGMENT                   5
+#define HM_URL_USERINFO                   6
+#define HM_URL_FIELDS                     7
+
+typedef struct HMUrlField HMUrlField;
+
+struct HMUrlField {
+	uint32_t    off;      /**< offset of the field in the url. */
+	uint32_t    len;
+};
+
+typedef struct HMUrl HMUrl;
+
+/**
+ * Offsets of the url components, nothing is copied or decoded.
+ */
+struct HMUrl {
+	uint16_t    fields;   /**< bitmask of the present fields: (1 << HM_URL_*). */
+	uint16_t    port;     /**< port number, 0 if there is no port. */
+	HMUrlField  field[HM_URL_FIELDS];
+};
+
+#define hm_url_has_field(u, f) (((u)->fields & (1 << (f))) != 0)
+
+/**
+ * Split a request target into it's components.
+ *
+ * Handles origin-form ("/path?query#fragment"), absolute-form
+ * ("http://user@host:port/path?query#fragment", IPv6 hosts in brackets),
+ * asterisk-form ("*") and the authority-form of CONNECT requests ("host:port").
+ * The IPv6 brackets are not part of the host field.  An empty port ("http://host:/")
+ * is the same as no port.
+ *
+ * @param url request target, like the url from hm_parser_get_url().
+ * @param len length of `url`.
+ * @param is_connect parse `url` as the authority-form of a CONNECT request.
+ * @param u fields to fill.
+ * @return 0 or -1 if the url is invalid.
+ */
+L_LIB_API int hm_url_parse(const char *url, size_t len, bool is_connect, HMUrl *u);
+
+/**
+ * Percent-decode a url component.  Invalid escapes are copied as is.
+ *
+ * @param src encoded bytes.
+ * @param len length of `src`.
+ * @param dst output buffer of at least `len` bytes, can be `src` to decode in place.
+ * @param plus_as_space decode '+' as space (for form encoded query strings).
+ * @return length of the decoded bytes.
+ */
+L_LIB_API size_t hm_url_decode(const char *src, size_t len, char *dst, bool plus_as_space);
+
+#endif /* __HM_URL_H__ */
+
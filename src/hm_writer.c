@@ -0,0 +1,567 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef __WINDOWS__
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "hm_parser.h"
+#include "hm_writer.h"
+#include "hm_date.h"
+
+/* initial sizes, both grow by doubling. */
+#define HM_WRITER_HEAD_SIZE     512
+#define HM_WRITER_VECS          8
+
+typedef struct HMWriterVec HMWriterVec;
+
+struct HMWriterVec {
+	const char  *data;  /**< referenced bytes, NULL for bytes in the head buffer. */
+	HMBuffer    *buf;   /**< buffer of a referenced slice. */
+	size_t      off;    /**< offset in the head buffer. */
+	size_t      len;
+};
+
+struct HMWriter {
+	HMAllocator *allocator;
+	char        *head;      /**< formatted lines, headers & chunk framing. */
+	size_t      head_len;
+	size_t      head_cap;
+	HMWriterVec *vecs;      /**< output in order, head bytes & referenced bodies. */
+	uint32_t    count;
+	uint32_t    capacity;
+	uint32_t    first;      /**< first vec with unwritten bytes. */
+	size_t      first_off;  /**< bytes of the first vec that have been written. */
+	size_t      pending;    /**< bytes not written yet. */
+};
+
+#define HM_NAME(id, name) [id] = { name, sizeof(name) - 1 },
+
+/* canonical header names indexed by id. */
+static const struct {
+	const char  *name;
+	size_t      len;
+} hm_header_names[HM_MAX_HEADER_IDS] = {
+	HM_HEADER_NAMES(HM_NAME)
+};
+
+#undef HM_NAME
+
+const char *hm_header_id_name(int id, size_t *len) {
+	if(id <= 0 || id >= HM_MAX_HEADER_IDS) {
+		return NULL;
+	}
+	*len = hm_header_names[id].len;
+	return hm_header_names[id].name;
+}
+
+const char *hm_writer_reason(int status_code) {
+	switch(status_code) {
+	case 100: return "Continue";
+	case 101: return "Switching Protocols";
+	case 200: return "OK";
+	case 201: return "Created";
+	case 202: return "Accepted";
+	case 203: return "Non-Authoritative Information";
+	case 204: return "No Content";
+	case 205: return "Reset Content";
+	case 206: return "Partial Content";
+	case 300: return "Multiple Choices";
+	case 301: return "Moved Permanently";
+	case 302: return "Found";
+	case 303: return "See Other";
+	case 304: return "Not Modified";
+	case 305: return "Use Proxy";
+	case 307: return "Temporary Redirect";
+	case 308: return "Permanent Redirect";
+	case 400: return "Bad Request";
+	case 401: return "Unauthorized";
+	case 402: return "Payment Required";
+	case 403: return "Forbidden";
+	case 404: return "Not Found";
+	case 405: return "Method Not Allowed";
+	case 406: return "Not Acceptable";
+	case 407: return "Proxy Authentication Required";
+	case 408: return "Request Timeout";
+	case 409: return "Conflict";
+	case 410: return "Gone";
+	case 411: return "Length Required";
+	case 412: return "Precondition Failed";
+	case 413: return "Payload Too Large";
+	case 414: return "URI Too Long";
+	case 415: return "Unsupported Media Type";
+	case 416: return "Range Not Satisfiable";
+	case 417: return "Expectation Failed";
+	case 426: return "Upgrade Required";
+	case 428: return "Precondition Required";
+	case 429: return "Too Many Requests";
+	case 431: return "Request Header Fields Too Large";
+	case 500: return "Internal Server Error";
+	case 501: return "Not Implemented";
+	case 502: return "Bad Gateway";
+	case 503: return "Service Unavailable";
+	case 504: return "Gateway Timeout";
+	case 505: return "HTTP Version Not Supported";
+	default:
+		break;
+	}
+	return "Unknown";
+}
+
+HMWriter *hm_writer_new(HMAllocator *allocator) {
+	HMWriter *writer;
+
+	if(allocator == NULL) {
+		allocator = hm_allocator_default();
+	}
+	writer = (HMWriter *)hm_alloc_malloc(allocator, sizeof(HMWriter));
+	if(writer == NULL) {
+		return NULL;
+	}
+	memset(writer, 0, sizeof(HMWriter));
+	writer->allocator = allocator;
+	return writer;
+}
+
+void hm_writer_free(HMWriter *writer) {
+	hm_writer_reset(writer);
+	hm_alloc_free(writer->allocator, writer->head, writer->head_cap);
+	hm_alloc_free(writer->allocator, writer->vecs, sizeof(HMWriterVec) * writer->capacity);
+	hm_alloc_free(writer->allocator, writer, sizeof(HMWriter));
+}
+
+void hm_writer_reset(HMWriter *writer) {
+	uint32_t idx;
+
+	for(idx = 0; idx < writer->count; idx++) {
+		hm_buffer_unref(writer->vecs[idx].buf);
+	}
+	writer->count = 0;
+	writer->first = 0;
+	writer->first_off = 0;
+	writer->head_len = 0;
+	writer->pending = 0;
+}
+
+/* make room for `len` more bytes in the head buffer. */
+static char *hm_writer_reserve(HMWriter *writer, size_t len) {
+	size_t need = writer->head_len + len;
+
+	if(need > writer->head_cap) {
+		size_t cap = (writer->head_cap > 0) ? writer->head_cap : HM_WRITER_HEAD_SIZE;
+		char *head;
+		while(cap < need) {
+			cap *= 2;
+		}
+		head = (char *)hm_alloc_realloc(writer->allocator, writer->head, writer->head_cap, cap);
+		if(head == NULL) {
+			return NULL;
+		}
+		writer->head = head;
+		writer->head_cap = cap;
+	}
+	return writer->head + writer->head_len;
+}
+
+static HMWriterVec *hm_writer_push_vec(HMWriter *writer) {
+	if(writer->count >= writer->capacity) {
+		uint32_t capacity = (writer->capacity > 0) ? writer->capacity * 2 : HM_WRITER_VECS;
+		HMWriterVec *vecs;
+		vecs = (HMWriterVec *)hm_alloc_realloc(writer->allocator, writer->vecs,
+			sizeof(HMWriterVec) * writer->capacity, sizeof(HMWriterVec) * capacity);
+		if(vecs == NULL) {
+			return NULL;
+		}
+		writer->vecs = vecs;
+		writer->capacity = capacity;
+	}
+	return &(writer->vecs[writer->count++]);
+}
+
+/* add `len` bytes written to the reserved space of the head buffer to the output. */
+static int hm_writer_commit(HMWriter *writer, size_t len) {
+	HMWriterVec *vec;
+
+	if(writer->count > writer->first) {
+		/* extend the last vec if it ends at the same place in the head buffer. */
+		vec = &(writer->vecs[writer->count - 1]);
+		if(vec->data == NULL && (vec->off + vec->len) == writer->head_len) {
+			vec->len += len;
+			goto done;
+		}
+	}
+	vec = hm_writer_push_vec(writer);
+	if(vec == NULL) {
+		return -1;
+	}
+	vec->data = NULL;
+	vec->buf = NULL;
+	vec->off = writer->head_len;
+	vec->len = len;
+done:
+	writer->head_len += len;
+	writer->pending += len;
+	return 0;
+}
+
+static int hm_writer_copy(HMWriter *writer, const char *data, size_t len) {
+	char *p = hm_writer_reserve(writer, len);
+
+	if(p == NULL) {
+		return -1;
+	}
+	memcpy(p, data, len);
+	return hm_writer_commit(writer, len);
+}
+
+/* reference `len` bytes, `buf` (if not NULL) is referenced until they are written. */
+static int hm_writer_ref(HMWriter *writer, const char *data, size_t len, HMBuffer *buf) {
+	HMWriterVec *vec;
+
+	if(len < HM_WRITER_COPY_MAX) {
+		/* cheaper to copy then to write an extra iovec. */
+		return hm_writer_copy(writer, data, len);
+	}
+	vec = hm_writer_push_vec(writer);
+	if(vec == NULL) {
+		return -1;
+	}
+	vec->data = data;
+	vec->buf = (buf != NULL) ? hm_buffer_ref(buf) : NULL;
+	vec->off = 0;
+	vec->len = len;
+	writer->pending += len;
+	return 0;
+}
+
+/* format `val` at `p`, returns the number of digits. */
+static size_t hm_format_uint(char *p, uint64_t val, uint32_t base) {
+	static const char digits[] = "0123456789abcdef";
+	char tmp[24];
+	size_t len = 0;
+	size_t idx;
+
+	do {
+		tmp[len++] = digits[val % base];
+		val /= base;
+	} while(val > 0);
+	for(idx = 0; idx < len; idx++) {
+		p[idx] = tmp[len - idx - 1];
+	}
+	return len;
+}
+
+/* CR & LF can't be in header names/values or the start line (response splitting). */
+static bool hm_has_crlf(const char *data, size_t len) {
+	return (memchr(data, '\n', len) != NULL || memchr(data, '\r', len) != NULL);
+}
+
+/* only single digit versions can be written. */
+static bool hm_valid_version(int version) {
+	return (version >= 0 && (version >> 16) < 10 && (version & 0xffff) < 10);
+}
+
+int hm_writer_status_line(HMWriter *writer, int version, int status_code,
+		const char *reason, size_t reason_len) {
+	char *p;
+	size_t len;
+
+	if(status_code < 100 || status_code > 999 || !hm_valid_version(version)) {
+		return -1;
+	}
+	if(reason == NULL) {
+		reason = hm_writer_reason(status_code);
+		reason_len = strlen(reason);
+	} else if(hm_has_crlf(reason, reason_len)) {
+		return -1;
+	}
+	/* "HTTP/x.y 999 " + reason + "\r\n" */
+	p = hm_writer_reserve(writer, 13 + reason_len + 2);
+	if(p == NULL) {
+		return -1;
+	}
+	memcpy(p, "HTTP/", 5);
+	p[5] = '0' + (version >> 16);
+	p[6] = '.';
+	p[7] = '0' + (version & 0xffff);
+	p[8] = ' ';
+	hm_format_uint(p + 9, status_code, 10);
+	p[12] = ' ';
+	memcpy(p + 13, reason, reason_len);
+	len = 13 + reason_len;
+	p[len++] = '\r';
+	p[len++] = '\n';
+	return hm_writer_commit(writer, len);
+}
+
+int hm_writer_request_line(HMWriter *writer, const char *method, size_t method_len,
+		const char *url, size_t url_len, int version) {
+	char *p;
+	size_t len;
+
+	if(method_len == 0 || url_len == 0 || !hm_valid_version(version) ||
+			memchr(method, ' ', method_len) != NULL || memchr(url, ' ', url_len) != NULL ||
+			hm_has_crlf(method, method_len) || hm_has_crlf(url, url_len)) {
+		return -1;
+	}
+	/* method + " " + url + " HTTP/x.y\r\n" */
+	p = hm_writer_reserve(writer, method_len + url_len + 12);
+	if(p == NULL) {
+		return -1;
+	}
+	memcpy(p, method, method_len);
+	len = method_len;
+	p[len++] = ' ';
+	memcpy(p + len, url, url_len);
+	len += url_len;
+	memcpy(p + len, " HTTP/", 6);
+	len += 6;
+	p[len++] = '0' + (version >> 16);
+	p[len++] = '.';
+	p[len++] = '0' + (version & 0xffff);
+	p[len++] = '\r';
+	p[len++] = '\n';
+	return hm_writer_commit(writer, len);
+}
+
+static int hm_writer_header_line(HMWriter *writer, const char *name, size_t name_len,
+		const char *value, size_t value_len) {
+	char *p = hm_writer_reserve(writer, name_len + 2 + value_len + 2);
+	size_t len;
+
+	if(p == NULL) {
+		return -1;
+	}
+	memcpy(p, name, name_len);
+	len = name_len;
+	p[len++] = ':';
+	p[len++] = ' ';
+	memcpy(p + len, value, value_len);
+	len += value_len;
+	p[len++] = '\r';
+	p[len++] = '\n';
+	return hm_writer_commit(writer, len);
+}
+
+int hm_writer_header(HMWriter *writer, const char *name, size_t name_len,
+		const char *value, size_t value_len) {
+	if(name_len == 0 || memchr(name, ':', name_len) != NULL || hm_has_crlf(name, name_len) ||
+			hm_has_crlf(value, value_len)) {
+		return -1;
+	}
+	return hm_writer_header_line(writer, name, name_len, value, value_len);
+}
+
+int hm_writer_header_id(HMWriter *writer, int id, const char *value, size_t value_len) {
+	const char *name;
+	size_t name_len;
+
+	name = hm_header_id_name(id, &name_len);
+	if(name == NULL || hm_has_crlf(value, value_len)) {
+		return -1;
+	}
+	return hm_writer_header_line(writer, name, name_len, value, value_len);
+}
+
+int hm_writer_content_length(HMWriter *writer, uint64_t len) {
+	char tmp[24];
+
+	return hm_writer_header_line(writer, "Content-Length", 14, tmp,
+		hm_format_uint(tmp, len, 10));
+}
+
+int hm_writer_date(HMWriter *writer) {
+	const char *date;
+	size_t len;
+
+	date = hm_date_now(&len);
+	return hm_writer_header_line(writer, "Date", 4, date, len);
+}
+
+int hm_writer_end_headers(HMWriter *writer) {
+	return hm_writer_copy(writer, "\r\n", 2);
+}
+
+int hm_writer_body(HMWriter *writer, const char *data, size_t len) {
+	if(len == 0) {
+		return 0;
+	}
+	return hm_writer_ref(writer, data, len, NULL);
+}
+
+int hm_writer_body_copy(HMWriter *writer, const char *data, size_t len) {
+	if(len == 0) {
+		return 0;
+	}
+	return hm_writer_copy(writer, data, len);
+}
+
+int hm_writer_body_slice(HMWriter *writer, HMSlice *slice) {
+	const char *data;
+	size_t len;
+
+	data = hm_slice_data(slice, &len);
+	if(len == 0) {
+		return 0;
+	}
+	return hm_writer_ref(writer, data, len, slice->buf);
+}
+
+/* chunk size line: hex size + "\r\n". */
+static int hm_writer_chunk_size(HMWriter *writer, size_t size) {
+	char *p = hm_writer_reserve(writer, 16 + 2);
+	size_t len;
+
+	if(p == NULL) {
+		return -1;
+	}
+	len = hm_format_uint(p, size, 16);
+	p[len++] = '\r';
+	p[len++] = '\n';
+	return hm_writer_commit(writer, len);
+}
+
+int hm_writer_chunk(HMWriter *writer, const char *data, size_t len) {
+	if(len == 0) {
+		return 0;
+	}
+	if(hm_writer_chunk_size(writer, len) || hm_writer_ref(writer, data, len, NULL)) {
+		return -1;
+	}
+	return hm_writer_copy(writer, "\r\n", 2);
+}
+
+int hm_writer_chunk_copy(HMWriter *writer, const char *data, size_t len) {
+	if(len == 0) {
+		return 0;
+	}
+	if(hm_writer_chunk_size(writer, len) || hm_writer_copy(writer, data, len)) {
+		return -1;
+	}
+	return hm_writer_copy(writer, "\r\n", 2);
+}
+
+int hm_writer_chunk_slice(HMWriter *writer, HMSlice *slice) {
+	const char *data;
+	size_t len;
+
+	data = hm_slice_data(slice, &len);
+	if(len == 0) {
+		return 0;
+	}
+	if(hm_writer_chunk_size(writer, len) || hm_writer_ref(writer, data, len, slice->buf)) {
+		return -1;
+	}
+	return hm_writer_copy(writer, "\r\n", 2);
+}
+
+int hm_writer_last_chunk(HMWriter *writer) {
+	return hm_writer_copy(writer, "0\r\n\r\n", 5);
+}
+
+size_t hm_writer_pending(HMWriter *writer) {
+	return writer->pending;
+}
+
+uint32_t hm_writer_count_iovec(HMWriter *writer) {
+	return writer->count - writer->first;
+}
+
+uint32_t hm_writer_get_iovec(HMWriter *writer, struct iovec *iov, uint32_t max) {
+	HMWriterVec *vec = writer->vecs + writer->first;
+	size_t off = writer->first_off;
+	uint32_t count = writer->count - writer->first;
+	uint32_t idx;
+
+	if(count > max) {
+		count = max;
+	}
+	for(idx = 0; idx < count; idx++, vec++) {
+		const char *data = (vec->data != NULL) ? vec->data : (writer->head + vec->off);
+		iov[idx].iov_base = (void *)(data + off);
+		iov[idx].iov_len = vec->len - off;
+		off = 0;
+	}
+	return count;
+}
+
+void hm_writer_consume(HMWriter *writer, size_t len) {
+	HMWriterVec *vec;
+
+	assert(len <= writer->pending);
+	writer->pending -= len;
+	if(writer->pending == 0) {
+		hm_writer_reset(writer);
+		return;
+	}
+	len += writer->first_off;
+	vec = writer->vecs + writer->first;
+	while(len >= vec->len) {
+		len -= vec->len;
+		/* written slices can be released now. */
+		hm_buffer_unref(vec->buf);
+		vec->buf = NULL;
+		vec++;
+		writer->first++;
+	}
+	writer->first_off = len;
+}
+
+#ifdef __WINDOWS__
+static ssize_t writev(int fd, const struct iovec *iov, int count) {
+	ssize_t total = 0;
+	ssize_t rc;
+	int idx;
+
+	for(idx = 0; idx < count; idx++) {
+		rc = write(fd, iov[idx].iov_base, iov[idx].iov_len);
+		if(rc < 0) {
+			return (total > 0) ? total : rc;
+		}
+		total += rc;
+		if((size_t)rc < iov[idx].iov_len) break;
+	}
+	return total;
+}
+#endif
+
+ssize_t hm_writer_write_fd(HMWriter *writer, int fd) {
+	struct iovec iov[HM_WRITER_IOV_MAX];
+	ssize_t total = 0;
+	ssize_t rc;
+	size_t len;
+	uint32_t count;
+	uint32_t idx;
+
+	while(writer->pending > 0) {
+		count = hm_writer_get_iovec(writer, iov, HM_WRITER_IOV_MAX);
+		for(len = 0, idx = 0; idx < count; idx++) {
+			len += iov[idx].iov_len;
+		}
+		do {
+			rc = writev(fd, iov, count);
+		} while(rc < 0 && errno == EINTR);
+		if(rc < 0) {
+			if(total > 0) {
+				/* report the error on the next call. */
+				break;
+			}
+			return -errno;
+		}
+		hm_writer_consume(writer, rc);
+		total += rc;
+		if((size_t)rc < len) {
+			/* socket buffer is full. */
+			break;
+		}
+	}
+	return total;
+}
+
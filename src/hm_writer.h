@@ -0,0 +1,247 @@
+/***************************************************************************
+ * Copyright (C) 2007-2010 by Robert G. Jakabosky <bobby@neoawareness.com> *
+ *                                                                         *
+ ***************************************************************************/
+#if !defined(__HM_WRITER_H__)
+#define __HM_WRITER_H__
+
+#include "lcommon.h"
+
+#include "hm_alloc.h"
+#include "hm_buffer.h"
+
+#include <sys/types.h>
+#ifdef __WINDOWS__
+struct iovec {
+	void    *iov_base;
+	size_t  iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
+/* bodies smaller then this are copied into the head buffer instead of being referenced. */
+#define HM_WRITER_COPY_MAX                128
+
+/* encoded HTTP version, same as hm_parser_version(). */
+#define HM_HTTP_VERSION(major, minor)     (((major) << 16) + (minor))
+
+/* max. number of iovecs passed to one writev() call. */
+#define HM_WRITER_IOV_MAX                 64
+
+/**
+ * HTTP/1.x message serializer.
+ *
+ * Status/request lines, headers and chunk framing are formatted into one head
+ * buffer, bodies are referenced (not copied) and the message is output as an
+ * iovec array ready for writev().  Consecutive formatted bytes share one iovec, so
+ * a message with a referenced body is usually 2 iovecs.
+ *
+ * Referenced memory must stay valid until the message has been written, slices
+ * are kept alive by the writer.  After all bytes have been written with
+ * hm_writer_write_fd() the writer is reset for the next message.
+ *
+ * @ingroup Objects
+ */
+typedef struct HMWriter HMWriter;
+
+/**
+ * Create a new HMWriter.
+ *
+ * @param allocator allocator for the writer (NULL for the default allocator).
+ * @return pointer to new HMWriter.
+ * @public @memberof HMWriter
+ */
+L_LIB_API HMWriter *hm_writer_new(HMAllocator *allocator);
+
+/**
+ * Free instance of HMWriter, releasing all referenced slices.
+ *
+ * @param writer pointer to HMWriter instance to free
+ * @public @memberof HMWriter
+ */
+L_LIB_API void hm_writer_free(HMWriter *writer);
+
+/**
+ * Drop all pending output and release referenced slices.  The head buffer is kept.
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API void hm_writer_reset(HMWriter *writer);
+
+/**
+ * Canonical name of a header id from hm_header_ids.gperf.
+ *
+ * @param id header id.
+ * @param len returns the length of the name.
+ * @return NULL for unknown ids.
+ */
+L_LIB_API const char *hm_header_id_name(int id, size_t *len);
+
+/**
+ * Default reason phrase of a status code ("Unknown" for unknown codes).
+ */
+L_LIB_API const char *hm_writer_reason(int status_code);
+
+/**
+ * Format a status line: "HTTP/<major>.<minor> <status_code> <reason>\r\n".
+ *
+ * @param writer pointer to HMWriter structure.
+ * @param version HM_HTTP_VERSION(major, minor), same as hm_parser_version().
+ * @param status_code 100-999.
+ * @param reason reason phrase, NULL for the default phrase.
+ * @param reason_len length of `reason`.
+ * @return 0 on success, -1 on allocation failure or invalid arguments.
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_status_line(HMWriter *writer, int version, int status_code,
+	const char *reason, size_t reason_len);
+
+/**
+ * Format a request line: "<method> <url> HTTP/<major>.<minor>\r\n".
+ *
+ * @return 0 on success, -1 on allocation failure or invalid arguments.
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_request_line(HMWriter *writer, const char *method, size_t method_len,
+	const char *url, size_t url_len, int version);
+
+/**
+ * Add a header, the name & value are copied.
+ *
+ * @return 0 on success, -1 on allocation failure or if the name or value contains
+ * CR or LF.
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_header(HMWriter *writer, const char *name, size_t name_len,
+	const char *value, size_t value_len);
+
+/**
+ * Add a header by id (see hm_header_ids.gperf), the canonical name is used.
+ *
+ * @return 0 on success, -1 on allocation failure, unknown id or invalid value.
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_header_id(HMWriter *writer, int id, const char *value, size_t value_len);
+
+/**
+ * Add a "Content-Length" header.
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_content_length(HMWriter *writer, uint64_t len);
+
+/**
+ * Add a "Date" header with the current time, see hm_date_now().
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_date(HMWriter *writer);
+
+/**
+ * End the header block.
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_end_headers(HMWriter *writer);
+
+/**
+ * Add body bytes, referenced until the message has been written.
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_body(HMWriter *writer, const char *data, size_t len);
+
+/**
+ * Add body bytes, copied into the head buffer.
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_body_copy(HMWriter *writer, const char *data, size_t len);
+
+/**
+ * Add the bytes of a slice as body, the slice's buffer is referenced by the writer
+ * so the slice can be freed.
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_body_slice(HMWriter *writer, HMSlice *slice);
+
+/**
+ * Add one chunk of a "Transfer-Encoding: chunked" body, the data is referenced.
+ * Zero length chunks are ignored, use hm_writer_last_chunk() to end the body.
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_chunk(HMWriter *writer, const char *data, size_t len);
+
+/**
+ * Same as hm_writer_chunk(), the data is copied.
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_chunk_copy(HMWriter *writer, const char *data, size_t len);
+
+/**
+ * Add one chunk from a slice, see hm_writer_body_slice().
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_chunk_slice(HMWriter *writer, HMSlice *slice);
+
+/**
+ * End a chunked body: "0\r\n\r\n".
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API int hm_writer_last_chunk(HMWriter *writer);
+
+/**
+ * Number of bytes not written yet.
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API size_t hm_writer_pending(HMWriter *writer);
+
+/**
+ * Number of iovecs needed for the pending bytes.
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API uint32_t hm_writer_count_iovec(HMWriter *writer);
+
+/**
+ * Fill `iov` with the pending bytes.  The iovecs are valid until the next call
+ * that changes the writer.
+ *
+ * @param writer pointer to HMWriter structure.
+ * @param iov array of `max` iovecs.
+ * @param max size of the `iov` array.
+ * @return number of iovecs filled.
+ * @public @memberof HMWriter
+ */
+L_LIB_API uint32_t hm_writer_get_iovec(HMWriter *writer, struct iovec *iov, uint32_t max);
+
+/**
+ * Mark `len` pending bytes as written (for callers that write the iovecs themselves).
+ * The writer is reset when all bytes have been written.
+ *
+ * @public @memberof HMWriter
+ */
+L_LIB_API void hm_writer_consume(HMWriter *writer, size_t len);
+
+/**
+ * Write the pending bytes to a file descriptor with writev(), until everything was
+ * written or the fd would block.  Partial writes are remembered, call again when the
+ * fd is writable.
+ *
+ * @param writer pointer to HMWriter structure.
+ * @param fd file descriptor to write to.
+ * @return number of bytes written or a negative errno (-EAGAIN if nothing could be
+ * written to a non-blocking fd).
+ * @public @memberof HMWriter
+ */
+L_LIB_API ssize_t hm_writer_write_fd(HMWriter *writer, int fd);
+
+#endif /* __HM_WRITER_H__ */
+
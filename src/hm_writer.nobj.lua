@@ -0,0 +1,233 @@
+-- Copyright (c) 2011 by Robert G. Jakabosky <bobby@sharedrealm.com>
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+
+object "HMWriter" {
+	include"hm_writer.h",
+	ffi_cdef[[
+int hm_writer_body(HMWriter *writer, const char *data, size_t len);
+
+int hm_writer_chunk(HMWriter *writer, const char *data, size_t len);
+
+size_t hm_writer_pending(HMWriter *writer);
+
+]],
+	c_source "src" [[
+/* keep the Lua string at `idx` alive until the writer at `this_idx` has written it. */
+static void hm_lua_writer_anchor(lua_State *L, int this_idx, int idx) {
+	hm_lua_anchors(L, this_idx);
+	lua_pushvalue(L, idx);
+	lua_rawseti(L, -2, lua_objlen(L, -2) + 1);
+	lua_pop(L, 1);
+}
+
+/* drop the anchored strings once everything has been written. */
+static void hm_lua_writer_release(lua_State *L, HMWriter *writer, int this_idx) {
+	if(hm_writer_pending(writer) > 0) return;
+	hm_lua_anchors(L, this_idx);
+	hm_lua_clear_table(L, lua_gettop(L), 1);
+	lua_pop(L, 1);
+}
+]],
+	ffi_source "ffi_src" [[
+local function hm_writer_release(writer)
+	if C.hm_writer_pending(writer) == 0 then
+		local anchors = hm_anchors(writer)
+		for i=#anchors,1,-1 do anchors[i] = nil end
+	end
+end
+]],
+	destructor {
+		c_method_call "void" "hm_writer_free" {},
+	},
+
+	method "reset" {
+		c_method_call "void" "hm_writer_reset" {},
+		c_source [[
+	hm_lua_writer_release(L, ${this}, 1);
+]],
+		ffi_source [[
+	hm_writer_release(${this})
+]],
+	},
+
+	-- version is encoded like HMParser:version(), defaults to HTTP/1.1.
+	method "status_line" {
+		var_in { "int", "status_code" },
+		var_in { "const char *", "reason?" },
+		var_in { "int", "version?" },
+		var_out { "bool", "ok" },
+		c_source [[
+	if(${version} == 0) ${version} = HM_HTTP_VERSION(1, 1);
+	${ok} = (hm_writer_status_line(${this}, ${version}, ${status_code},
+		${reason}, ${reason_len}) == 0);
+]],
+	},
+
+	method "request_line" {
+		var_in { "const char *", "method" },
+		var_in { "const char *", "url" },
+		var_in { "int", "version?" },
+		var_out { "bool", "ok" },
+		c_source [[
+	if(${version} == 0) ${version} = HM_HTTP_VERSION(1, 1);
+	${ok} = (hm_writer_request_line(${this}, ${method}, ${method_len},
+		${url}, ${url_len}, ${version}) == 0);
+]],
+	},
+
+	-- `name` is a header name or id (see hm.header_ids).
+	method "header" {
+		var_in { "<any>", "name" },
+		var_in { "const char *", "value" },
+		var_out { "bool", "ok" },
+		c_source [[
+	const char *name;
+	size_t name_len;
+
+	if(lua_type(L, ${name::idx}) == LUA_TNUMBER) {
+		${ok} = (hm_writer_header_id(${this}, lua_tointeger(L, ${name::idx}),
+			${value}, ${value_len}) == 0);
+	} else {
+		name = luaL_checklstring(L, ${name::idx}, &name_len);
+		${ok} = (hm_writer_header(${this}, name, name_len, ${value}, ${value_len}) == 0);
+	}
+]],
+	},
+
+	method "content_length" {
+		var_in { "uint64_t", "len" },
+		var_out { "bool", "ok" },
+		c_source [[
+	${ok} = (hm_writer_content_length(${this}, ${len}) == 0);
+]],
+	},
+
+	-- "Date" header with the current time.
+	method "date" {
+		var_out { "bool", "ok" },
+		c_source [[
+	${ok} = (hm_writer_date(${this}) == 0);
+]],
+	},
+
+	method "end_headers" {
+		var_out { "bool", "ok" },
+		c_source [[
+	${ok} = (hm_writer_end_headers(${this}) == 0);
+]],
+	},
+
+	-- Lua strings & slices are referenced (not copied) until they have been written.
+	method "body" {
+		var_in { "const char *", "data" },
+		var_out { "bool", "ok" },
+		c_source [[
+	${ok} = (hm_writer_body(${this}, ${data}, ${data_len}) == 0);
+	if(${ok}) hm_lua_writer_anchor(L, 1, ${data::idx});
+]],
+		ffi_source [[
+	${ok} = (C.hm_writer_body(${this}, ${data}, ${data_len}) == 0)
+	if ${ok} then
+		local anchors = hm_anchors(${this})
+		anchors[#anchors + 1] = ${data}
+	end
+]],
+	},
+
+	method "body_slice" {
+		var_in { "HMSlice *", "slice" },
+		var_out { "bool", "ok" },
+		c_source [[
+	${ok} = (hm_writer_body_slice(${this}, ${slice}) == 0);
+]],
+	},
+
+	method "chunk" {
+		var_in { "const char *", "data" },
+		var_out { "bool", "ok" },
+		c_source [[
+	${ok} = (hm_writer_chunk(${this}, ${data}, ${data_len}) == 0);
+	if(${ok}) hm_lua_writer_anchor(L, 1, ${data::idx});
+]],
+		ffi_source [[
+	${ok} = (C.hm_writer_chunk(${this}, ${data}, ${data_len}) == 0)
+	if ${ok} then
+		local anchors = hm_anchors(${this})
+		anchors[#anchors + 1] = ${data}
+	end
+]],
+	},
+
+	method "chunk_slice" {
+		var_in { "HMSlice *", "slice" },
+		var_out { "bool", "ok" },
+		c_source [[
+	${ok} = (hm_writer_chunk_slice(${this}, ${slice}) == 0);
+]],
+	},
+
+	method "last_chunk" {
+		var_out { "bool", "ok" },
+		c_source [[
+	${ok} = (hm_writer_last_chunk(${this}) == 0);
+]],
+	},
+
+	method "pending" {
+		c_method_call "size_t" "hm_writer_pending" {},
+	},
+
+	-- returns bytes written or negative errno.
+	method "write_fd" {
+		c_method_call "ssize_t" "hm_writer_write_fd" { "int", "fd" },
+		c_source [[
+	hm_lua_writer_release(L, ${this}, 1);
+]],
+		ffi_source [[
+	hm_writer_release(${this})
+]],
+	},
+
+	-- pending bytes as one string (for transports without a fd), the writer is reset.
+	method "data" {
+		c_source [[
+	struct iovec iov[HM_WRITER_IOV_MAX];
+	luaL_Buffer buf;
+	uint32_t count;
+	uint32_t idx;
+
+	luaL_buffinit(L, &buf);
+	while(hm_writer_pending(${this}) > 0) {
+		size_t len = 0;
+		count = hm_writer_get_iovec(${this}, iov, HM_WRITER_IOV_MAX);
+		for(idx = 0; idx < count; idx++) {
+			luaL_addlstring(&buf, (const char *)iov[idx].iov_base, iov[idx].iov_len);
+			len += iov[idx].iov_len;
+		}
+		hm_writer_consume(${this}, len);
+	}
+	luaL_pushresult(&buf);
+	hm_lua_writer_release(L, ${this}, 1);
+	return 1;
+]],
+	},
+}
+
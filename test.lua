@@ -139,6 +139,791 @@ function connection_close_test()
     ok(#body == 10)
 end
 
+function slice_test()
+    local hm = require"http_message"
+    local parser = hm.request()
+    parser:append("POST /upload HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello")
+    parser:append("GET / HTTP/1.1\r\n\r\n")
+    ok(parser:execute() == hm.states.MESSAGE_COMPLETE)
+    local url = parser:get_url_slice()
+    local body = parser:next_body_slice()
+    ok(parser:next_body_slice() == nil)
+    -- slices must stay valid after the parser moves on to the next message.
+    parser:next_message()
+    parser:append(string.rep("x", 4096))
+    ok(url:data() == "/upload")
+    ok(body:len() == 5 and body:data() == "hello")
+end
+
+function detach_message_test()
+    local hm = require"http_message"
+    local parser = hm.request()
+    parser:append(pipeline)
+    ok(parser:execute() == hm.states.MESSAGE_COMPLETE)
+    local msg1 = parser:detach_message()
+    ok(parser:execute() % hm.states.NEEDS_INPUT == hm.states.MESSAGE_COMPLETE)
+    local msg2 = parser:detach_message()
+    parser:reset()
+    ok(msg1:get_url() == "/")
+    ok(msg2:get_url() == "/header.jpg")
+    ok(msg2:count_headers() == 3)
+    ok(msg2:method_str() == "GET")
+    ok(msg2:should_keep_alive() == true)
+end
+
+function message_detach_test()
+    local hmsg = require"http.message"
+    local parser = hmsg.request(true)
+    local reqs = {}
+    local seen = {}
+    local chunks = 0
+    function parser:on_message_begin()
+        local req = { headers = {} }
+        reqs[#reqs + 1] = req
+        return req
+    end
+    function parser:on_headers_complete()
+        local req = self.req
+        seen[#seen + 1] = req.url .. " " .. tostring(req.headers["Content-Length"])
+    end
+    function parser:on_body(data)
+        if data then chunks = chunks + 1 end
+    end
+    function parser:on_message_complete()
+    end
+    ok(parser:execute("POST /upload HTTP/1.1\r\nContent-Length: 5\r\n\r\nhel"))
+    ok(parser:execute("lo" .. pipeline))
+    ok(#reqs == 3)
+    ok(seen[1] == "/upload 5" and seen[2] == "/ nil" and seen[3] == "/header.jpg nil")
+    -- the body is kept in the detached message.
+    ok(chunks == 0)
+    local msg = reqs[1].message
+    local body = {}
+    repeat
+        local data = msg:next_body()
+        body[#body + 1] = data
+    until not data
+    ok(table.concat(body) == "hello")
+    ok(reqs[3].message:get_url() == "/header.jpg")
+end
+
+function get_headers_test()
+    local hm = require"http_message"
+    local ids = hm.header_ids
+    local parser = hm.request()
+    local many = {}
+    for i=1,40 do
+        many[#many + 1] = "X-H" .. i .. ": " .. i .. "\r\n"
+    end
+    parser:append("GET /a HTTP/1.1\r\n" .. table.concat(many) .. "\r\n" ..
+        "GET /b HTTP/1.1\r\nHost: localhost\r\nX-Test: 1\r\n\r\n")
+    local tbl = {}
+    ok(parser:execute() == hm.states.MESSAGE_COMPLETE)
+    ok(parser:get_headers(tbl) == 40)
+    ok(#tbl == 80 and tbl[79] == "x-h40" and tbl[80] == "40")
+    parser:next_message()
+    ok(parser:execute() % hm.states.NEEDS_INPUT == hm.states.MESSAGE_COMPLETE)
+    -- entries from the last message are cleared.
+    ok(parser:get_headers(tbl) == 2)
+    is_deeply(tbl, { ids["Host"], "localhost", "x-test", "1" })
+end
+
+function header_ids_test()
+    local hm = require"http_message"
+    local ids = hm.header_ids
+    local data = "GET / HTTP/1.1\r\nHost: localhost\r\nX-Custom-Name: one\r\n" ..
+        "Cookie: a=1\r\ncontent-length: 0\r\nCookie: b=2\r\n\r\n"
+    local expect = {
+        ids["Host"], false, "localhost",
+        0, "x-custom-name", "one",
+        ids["Cookie"], false, "a=1",
+        ids["Content-Length"], false, "0",
+        ids["Cookie"], false, "b=2",
+    }
+    -- split the input at every offset, names & values are resolved across appends.
+    for split=1,#data-1 do
+        local parser = hm.request()
+        parser:append(data:sub(1, split))
+        local rc = parser:execute()
+        if rc % hm.states.NEEDS_INPUT ~= hm.states.MESSAGE_COMPLETE then
+            parser:append(data:sub(split + 1))
+            rc = parser:execute()
+        end
+        local got = {}
+        for i=0,parser:count_headers()-1 do
+            local id, name, value = parser:get_header(i)
+            got[#got + 1] = id
+            got[#got + 1] = name or false
+            got[#got + 1] = value
+        end
+        is_deeply(got, expect, "split at " .. split)
+    end
+end
+
+function execute_external_test()
+    local hm = require"http_message"
+    local parser = hm.request()
+    local data = table.concat({ "GET /a HTTP/1.1\r\nX-Name: 1\r\n\r\n",
+        "POST /b HTTP/1.1\r\nContent-Length: 5\r\n\r\nhe" })
+    -- the first message is parsed from `data`, unknown header names keep their case.
+    ok(parser:execute_external(data) == hm.states.MESSAGE_COMPLETE)
+    -- the parser keeps `data` alive.
+    data = nil
+    collectgarbage()
+    ok(parser:get_url() == "/a" and select(2, parser:get_header(0)) == "X-Name")
+    parser:next_message()
+    -- the incomplete message is copied into the buffer.
+    local rc
+    repeat rc = parser:execute() until rc >= hm.states.NEEDS_INPUT
+    ok(rc == hm.states.BODY + hm.states.NEEDS_INPUT)
+    ok(parser:execute_external("llo") % hm.states.NEEDS_INPUT == hm.states.MESSAGE_COMPLETE)
+    ok(parser:get_url() == "/b" and parser:next_body() == "hello")
+end
+
+function find_header_test()
+    local hm = require"http_message"
+    local ids = hm.header_ids
+    local parser = hm.request()
+    parser:append("GET / HTTP/1.1\r\nHost: localhost\r\nCookie: a=1\r\n" ..
+        "X-Test: 1\r\nCookie: b=2\r\n\r\n")
+    ok(parser:execute() % hm.states.NEEDS_INPUT == hm.states.MESSAGE_COMPLETE)
+    ok(parser:find_header(ids["Host"]) == "localhost")
+    ok(parser:find_header(ids["Content-Length"]) == nil)
+    local idx = parser:find_header_idx(ids["Cookie"])
+    ok(idx == 1)
+    idx = parser:next_header_idx(idx)
+    ok(idx == 3)
+    ok(select(3, parser:get_header(idx)) == "b=2")
+    ok(parser:next_header_idx(idx) == -1)
+end
+
+function fast_scan_test()
+    local hm = require"http_message"
+    local data = "POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\n\r\nhello" ..
+        "GET /x HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"
+    local function parse(opts)
+        local parser = hm.request(opts)
+        local out = {}
+        parser:append(data)
+        while parser:execute() % hm.states.NEEDS_INPUT == hm.states.MESSAGE_COMPLETE do
+            out[#out + 1] = parser:method_str() .. " " .. parser:get_url()
+            for i=0,parser:count_headers()-1 do
+                local id, name, value = parser:get_header(i)
+                out[#out + 1] = tostring(id) .. ":" .. (name or "") .. ":" .. value
+            end
+            out[#out + 1] = tostring(parser:next_body())
+            out[#out + 1] = tostring(parser:should_keep_alive())
+            parser:next_message()
+        end
+        return table.concat(out, "\n")
+    end
+    local expect = parse()
+    ok(#expect > 0)
+    ok(parse(hm.options.FAST_SCAN) == expect)
+end
+
+function wait_headers_test()
+    local hm = require"http_message"
+    local begin_count = 0
+    local complete_count = 0
+    local cbs = {}
+    function cbs.on_message_begin()
+        begin_count = begin_count + 1
+    end
+    function cbs.on_message_complete()
+        complete_count = complete_count + 1
+    end
+    local parser = lhp.request(cbs, hm.options.WAIT_HEADERS)
+    -- feed the first message one byte at a time, without the final LF.
+    local first = pipeline:find("\r\n\r\n", 1, true) + 2
+    for i=1,first do
+        ok(parser:execute(pipeline:sub(i,i)) == 1)
+    end
+    ok(begin_count == 0)
+    ok(parser:execute(pipeline:sub(first + 1)) == #pipeline - first)
+    ok(begin_count == 2)
+    ok(complete_count == 2)
+end
+
+function stream_body_test()
+    local hm = require"http_message"
+    local body_len = 0
+    local complete_count = 0
+    local cbs = {}
+    function cbs.on_body(chunk)
+        if chunk then body_len = body_len + #chunk end
+    end
+    function cbs.on_message_complete()
+        complete_count = complete_count + 1
+    end
+    local parser = lhp.request(cbs, hm.options.STREAM_BODY)
+    parser.hm_parser:set_max_buffer_size(4096)
+    local chunk = string.rep("x", 1000)
+    local size = 1000 * 1000
+    parser:execute("POST / HTTP/1.1\r\nContent-Length: " .. size .. "\r\n\r\n")
+    -- each 10Kb write is larger then the max. buffer size.
+    local data = string.rep(chunk, 10)
+    local parsed = 0
+    for i=1,size/#data do
+        parsed = parsed + parser:execute(data)
+    end
+    ok(parsed == size)
+    ok(body_len == size, "streamed " .. body_len .. " body bytes")
+    ok(complete_count == 1)
+end
+
+function max_buffer_test()
+    local hm = require"http_message"
+    local hmsg = require"http.message"
+    local size = 100 * 1000
+    local parser = hmsg.request(false, hm.options.STREAM_BODY)
+    local body_len = 0
+    local errors = 0
+    function parser:on_message_begin() return { headers = {} } end
+    function parser:on_headers_complete() end
+    function parser:on_body(chunk)
+        if chunk then body_len = body_len + #chunk end
+    end
+    function parser:on_message_complete() end
+    function parser:on_error() errors = errors + 1 end
+    parser.hm_parser:set_max_buffer_size(4096)
+    -- the 10Kb write is appended in pieces, parsing between them.
+    ok(parser:execute("POST / HTTP/1.1\r\nContent-Length: " .. size .. "\r\n\r\n"))
+    local data = string.rep("x", 10000)
+    for i=1,size/#data do
+        ok(parser:execute(data))
+    end
+    ok(body_len == size)
+    -- headers that don't fit in the buffer are an error for both wrappers.
+    data = "GET / HTTP/1.1\r\nX-Big: " .. string.rep("x", 10000) .. "\r\n\r\n"
+    parser:execute(data)
+    ok(errors == 1 and parser.hm_parser:limit() == hm.limits.BUFFER)
+    parser = lhp.request({})
+    parser.hm_parser:set_max_buffer_size(4096)
+    ok(parser:execute(data) == 0 and parser:is_error())
+    ok(parser.hm_parser:limit() == hm.limits.BUFFER)
+end
+
+function buffer_growth_test()
+    local body_len = 0
+    local cbs = {}
+    function cbs.on_body(chunk)
+        if chunk then body_len = body_len + #chunk end
+    end
+    local parser = lhp.request(cbs)
+    local hm_parser = parser.hm_parser
+    local size = 100 * 1000
+    parser:execute("POST / HTTP/1.1\r\nContent-Length: " .. size .. "\r\n\r\n")
+    local data = string.rep("x", 1000)
+    for i=1,size/#data do
+        parser:execute(data)
+    end
+    ok(body_len == size)
+    -- the buffer was presized for the whole body.
+    local high = hm_parser:buffer_high_water()
+    ok(high >= size and high < size * 2, "buffer high water: " .. high)
+end
+
+function pipeline_no_move_test()
+    local count = 0
+    local cbs = {}
+    function cbs.on_message_complete()
+        count = count + 1
+    end
+    local parser = lhp.request(cbs)
+    -- pipelined messages are parsed in-place, without compacting the buffer.
+    parser:execute(string.rep("GET / HTTP/1.1\r\nHost: a\r\n\r\n", 8))
+    ok(count == 8)
+    ok(parser.hm_parser:bytes_moved() == 0)
+end
+
+function single_alloc_test()
+    local hm = require"http_message"
+    local headers = {}
+    local cbs = {}
+    function cbs.on_header(k, v)
+        headers[k] = v
+    end
+    local parser = lhp.request(cbs, hm.options.SINGLE_ALLOC)
+    -- more headers then fit in the parser's inline header array.
+    local req = { "GET / HTTP/1.1\r\n" }
+    for i=1,20 do
+        req[#req+1] = "X-Header-" .. i .. ": " .. i .. "\r\n"
+    end
+    req[#req+1] = "\r\n"
+    parser:execute(table.concat(req))
+    ok(headers["x-header-1"] == "1")
+    ok(headers["x-header-20"] == "20")
+end
+
+function memory_used_test()
+    local hm = require"http_message"
+    local parser = lhp.request({})
+    -- free earlier parsers now, so the GC steps done while parsing don't free them.
+    collectgarbage()
+    local before = hm.memory_used()
+    local used = parser.hm_parser:memory_used()
+    -- grow the parser's buffer.
+    parser:execute("POST / HTTP/1.1\r\nContent-Length: 100000\r\n\r\n" .. string.rep("x", 50000))
+    ok(parser.hm_parser:memory_used() >= 50000)
+    ok(hm.memory_used() - before >= parser.hm_parser:memory_used() - used)
+end
+
+function stats_test()
+    local hm = require"http_message"
+    local parser = lhp.request({})
+    parser:execute("GET / HTTP/1.1\r\nHost: a\r\nX-Custom: b\r\n\r\n")
+    local stats = {}
+    if not parser.hm_parser:stats(stats) then
+        -- compiled without ENABLE_PARSER_STATS.
+        ok(stats.bytes_parsed == 0)
+        return
+    end
+    ok(stats.bytes_parsed > 0)
+    ok(stats.header_id_hits == 1 and stats.header_id_misses == 1)
+    local total = {}
+    ok(hm.stats(total))
+    ok(total.bytes_parsed >= stats.bytes_parsed)
+end
+
+function timing_test()
+    local hm = require"http_message"
+    local parser = lhp.request({}, hm.options.TIMING)
+    parser:execute("POST / HTTP/1.1\r\nContent-Length: 4\r\n\r\n")
+    parser:execute("body")
+    local first, begin, headers, complete = parser.hm_parser:timing()
+    ok(first > 0 and first <= begin)
+    ok(begin <= headers and headers <= complete)
+    -- untimed parsers have no timestamps.
+    parser = lhp.request({})
+    parser:execute("GET / HTTP/1.1\r\n\r\n")
+    ok(parser.hm_parser:timing() == 0)
+end
+
+-- connected socket pair from luasocket, nil if it isn't installed.
+local function socket_pair()
+    local has_socket, socket = pcall(require, "socket")
+    if not has_socket then return nil end
+    local server = assert(socket.bind("127.0.0.1", 0))
+    local client = assert(socket.connect(server:getsockname()))
+    local conn = assert(server:accept())
+    server:close()
+    return client, conn
+end
+
+function read_fd_test()
+    local hm = require"http_message"
+    local hmsg = require"http.message"
+    local client, conn = socket_pair()
+    if not client then
+        print("# skip read_fd_test: needs luasocket")
+        return
+    end
+    local fd = conn:getfd()
+    -- http.parser and http.message both return the number of bytes read.
+    local urls = {}
+    local cbs = {}
+    function cbs.on_url(url) urls[#urls + 1] = url end
+    local parser = lhp.request(cbs)
+    local rc, err = parser:recv(fd, 0, hm.recv_flags.DONTWAIT)
+    ok(rc == nil and err == "EAGAIN")
+    client:send(pipeline)
+    local n = 0
+    while n < #pipeline do
+        n = n + assert(parser:read_fd(fd))
+    end
+    is_deeply(urls, { "/", "/header.jpg" })
+    local req
+    local msg = hmsg.request()
+    function msg:on_message_begin() req = { headers = {} } return req end
+    function msg:on_headers_complete() end
+    function msg:on_body() end
+    function msg:on_message_complete() urls[#urls + 1] = req.url end
+    -- readv_fd() reads more then the free space of the buffer in one call.
+    local data = "POST /big HTTP/1.1\r\nContent-Length: 20000\r\n\r\n" .. string.rep("x", 20000)
+    client:send(data)
+    n = 0
+    while n < #data do
+        n = n + assert(msg:readv_fd(fd, 64 * 1024))
+    end
+    ok(urls[3] == "/big")
+    client:close()
+    rc, err = msg:read_fd(fd)
+    ok(rc == nil and err == "EOF")
+    conn:close()
+end
+
+function parser_set_test()
+    local hm = require"http_message"
+    local events_t = hm.events
+    local client, conn = socket_pair()
+    if not client then
+        print("# skip parser_set_test: needs luasocket")
+        return
+    end
+    local fd = conn:getfd()
+    local set = hm.request_set()
+    local parser = set:add(fd)
+    ok(parser ~= nil and set:get(fd) == parser and set:count() == 1)
+    local events = { 1, 2, 3, 4, 5, 6, 7, 8, 9 }
+    client:send(pipeline)
+    -- stale entries after the last event are cleared.
+    local count = set:process({ fd }, events)
+    ok(count == 2 and #events == 6)
+    ok(events[1] == fd and events[2] == events_t.MESSAGE and events[3]:get_url() == "/")
+    ok(events[6]:get_url() == "/header.jpg")
+    client:close()
+    ok(set:process({ fd }, events) == 1 and events[2] == events_t.EOF and #events == 3)
+    -- the removed parser is reset for re-use, it's old handle is invalid.
+    set:remove(fd)
+    ok(set:count() == 0 and set:get(fd) == nil)
+    ok(not pcall(function() return parser:count_headers() end))
+    parser = set:add(fd)
+    ok(parser:count_headers() == 0)
+    set:remove(fd)
+    conn:close()
+end
+
+function upgrade_set_test()
+    local hm = require"http_message"
+    local events_t = hm.events
+    local upgrade = "GET /chat HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n\r\n"
+    for _, opts in ipairs({ 0, hm.options.BATCH }) do
+        local client, conn = socket_pair()
+        if not client then
+            print("# skip upgrade_set_test: needs luasocket")
+            return
+        end
+        local fd = conn:getfd()
+        local set = hm.request_set(opts)
+        set:add(fd)
+        local events = {}
+        -- the bytes after the upgrade request aren't parsed.
+        client:send("GET / HTTP/1.1\r\n\r\n" .. upgrade .. "rawbytes")
+        ok(set:process({ fd }, events) == 2)
+        ok(events[2] == events_t.MESSAGE and events[3]:get_url() == "/")
+        ok(events[5] == events_t.UPGRADE and events[6]:get_url() == "/chat")
+        ok(set:get(fd):get_unparsed() == "rawbytes")
+        -- the fd isn't read after the upgrade.
+        client:send("more")
+        ok(set:process({ fd }, events) == 0 and #events == 0)
+        ok(set:get(fd):get_unparsed() == "rawbytes")
+        set:remove(fd)
+        client:close()
+        conn:close()
+    end
+end
+
+function limits_test()
+    local hm = require"http_message"
+    local limits = hm.limits
+    local function parse(data, ...)
+        local parser = lhp.request({})
+        parser.hm_parser:set_limits(...)
+        parser:execute(data)
+        return parser
+    end
+    -- url
+    local parser = parse("GET /" .. string.rep("x", 100) .. " HTTP/1.1\r\n\r\n", 64)
+    ok(parser:is_error())
+    ok(parser:limit() == limits.URL)
+    ok(select(2, parser:error()) == "HM_LIMIT_URL")
+    -- too many headers
+    local headers = {}
+    for i=1,10 do headers[i] = "X-Header-" .. i .. ": " .. i .. "\r\n" end
+    parser = parse("GET / HTTP/1.1\r\n" .. table.concat(headers) .. "\r\n", 0, 0, 5)
+    ok(parser:limit() == limits.HEADERS)
+    -- header block size, found before the end of the headers.
+    parser = parse("GET / HTTP/1.1\r\nX-Big: " .. string.rep("x", 1000), 0, 512)
+    ok(parser:limit() == limits.HEADER_SIZE)
+    -- Content-Length is checked before the body arrives.
+    parser = parse("POST / HTTP/1.1\r\nContent-Length: 100000\r\n\r\n", 0, 0, 0, 0, 1000)
+    ok(parser:limit() == limits.BODY)
+    -- messages within the limits.
+    parser = parse("POST /ok HTTP/1.1\r\nContent-Length: 4\r\n\r\nbody", 64, 512, 5, 0, 1000)
+    ok(not parser:is_error())
+    ok(parser:limit() == limits.NONE)
+end
+
+function batch_test()
+    local hm = require"http_message"
+    local urls = {}
+    local hosts = {}
+    local bodies = {}
+    local cbs = {}
+    function cbs.on_url(url)
+        urls[#urls+1] = url
+    end
+    function cbs.on_header(k, v)
+        if k == "Host" then hosts[#hosts+1] = v end
+    end
+    function cbs.on_body(chunk)
+        if chunk then bodies[#bodies+1] = chunk end
+    end
+    local parser = lhp.request(cbs, hm.options.BATCH)
+    -- last message is incomplete.
+    ok(parser:execute("GET /1 HTTP/1.1\r\nHost: a\r\n\r\n" ..
+        "POST /2 HTTP/1.1\r\nHost: b\r\nContent-Length: 4\r\n\r\nbody" ..
+        "GET /3 HTTP/1.1\r\nHo") > 0)
+    is_deeply(urls, {"/1", "/2"})
+    is_deeply(hosts, {"a", "b"})
+    is_deeply(bodies, {"body"})
+    parser:execute("st: c\r\n\r\n")
+    is_deeply(urls, {"/1", "/2", "/3"})
+    is_deeply(hosts, {"a", "b", "c"})
+
+    -- pipelined messages split at every offset.
+    local data = "GET /1 HTTP/1.1\r\nHost: a\r\n\r\n" ..
+        "POST /2 HTTP/1.1\r\nHost: b\r\nContent-Length: 4\r\n\r\nbody" ..
+        "GET /3 HTTP/1.1\r\nHost: c\r\n\r\n"
+    for _, opts in ipairs{hm.options.BATCH, hm.options.BATCH + hm.options.FAST_SCAN} do
+        for off = 1, #data - 1 do
+            urls, hosts, bodies = {}, {}, {}
+            parser = lhp.request(cbs, opts)
+            parser:execute(data:sub(1, off))
+            parser:execute(data:sub(off + 1))
+            is_deeply(urls, {"/1", "/2", "/3"})
+            is_deeply(hosts, {"a", "b", "c"})
+            ok(table.concat(bodies) == "body")
+        end
+    end
+
+    -- the whole body is kept in batch mode, it can't be streamed/discarded.
+    ok(hm.request(hm.options.BATCH + hm.options.STREAM_BODY) == nil)
+    ok(hm.response(hm.options.BATCH + hm.options.DISCARD_BODY) == nil)
+    ok(hm.request_set(hm.options.BATCH + hm.options.STREAM_BODY) == nil)
+    ok(lhp.request(cbs, hm.options.BATCH + hm.options.DISCARD_BODY) == nil)
+end
+
+function writer_test()
+    local hm = require"http_message"
+    local writer = hm.writer()
+    ok(writer:status_line(200))
+    ok(writer:header(hm.header_ids["Content-Type"], "text/plain"))
+    ok(writer:header("X-Foo", "bar"))
+    -- no response splitting.
+    ok(not writer:header("X-Bad", "a\r\nSet-Cookie: x=1"))
+    ok(writer:content_length(5))
+    ok(writer:end_headers())
+    ok(writer:body("hello"))
+    ok(writer:data() == "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nX-Foo: bar\r\n" ..
+        "Content-Length: 5\r\n\r\nhello")
+    ok(writer:pending() == 0)
+    -- chunked request with a body slice, parsed back.
+    local parser = hm.request()
+    parser:append("POST /up HTTP/1.1\r\nContent-Length: 200\r\n\r\n" .. string.rep("z", 200))
+    parser:execute()
+    local body = parser:next_body_slice()
+    ok(body:len() == 200)
+    writer:request_line("PUT", "/dst")
+    writer:header("Transfer-Encoding", "chunked")
+    writer:end_headers()
+    ok(writer:chunk_slice(body))
+    ok(writer:chunk("end"))
+    ok(writer:last_chunk())
+    parser = lhp.request({})
+    local data = writer:data()
+    ok(parser:execute(data) == #data)
+    ok(parser:method() == "PUT")
+end
+
+function writer_names_test()
+    local hm = require"http_message"
+    local header_ids = hm.header_ids
+    local writer = hm.writer()
+    local id = 1
+    -- the writer's names, hm.header_ids and hm_header_ids.gperf must agree.
+    while header_ids[id] do
+        local name = header_ids[id]
+        ok(header_ids[name] == id)
+        ok(writer:header(id, "x"))
+        ok(writer:data() == name .. ": x\r\n", name)
+        local parser = hm.request()
+        parser:execute_external("GET / HTTP/1.1\r\n" .. name .. ": 1\r\n\r\n")
+        ok(parser:get_header(0) == id)
+        id = id + 1
+    end
+    ok(id > 100 and not writer:header(id, "x"))
+end
+
+function writer_fd_test()
+    local hm = require"http_message"
+    local client, conn = socket_pair()
+    if not client then
+        print("# skip writer_fd_test: needs luasocket")
+        return
+    end
+    local fd = conn:getfd()
+    local writer = hm.writer()
+    -- more then the socket buffers can take, so the writes are partial.
+    local size = 4 * 1024 * 1024
+    writer:status_line(200)
+    writer:content_length(size)
+    writer:end_headers()
+    -- the strings aren't copied, the writer keeps them alive until they are written.
+    ok(writer:body(string.rep("b", size)))
+    writer:status_line(200)
+    writer:header("Transfer-Encoding", "chunked")
+    writer:end_headers()
+    ok(writer:chunk(string.rep("c", size)))
+    ok(writer:last_chunk())
+    collectgarbage()
+    local expect = "HTTP/1.1 200 OK\r\nContent-Length: " .. size .. "\r\n\r\n" ..
+        string.rep("b", size) ..
+        "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n" ..
+        string.format("%x", size) .. "\r\n" .. string.rep("c", size) .. "\r\n0\r\n\r\n"
+    local total = writer:pending()
+    ok(total == #expect)
+    local written = writer:write_fd(fd)
+    ok(written > 0 and written < total and writer:pending() == total - written)
+    -- the socket buffer is full.
+    ok(writer:write_fd(fd) < 0)
+    local parts = { client:receive(written) }
+    while writer:pending() > 0 do
+        collectgarbage()
+        local rc = writer:write_fd(fd)
+        ok(rc > 0)
+        parts[#parts + 1] = client:receive(rc)
+        written = written + rc
+    end
+    ok(written == total and table.concat(parts) == expect)
+    -- the writer is reset and can be re-used.
+    ok(writer:status_line(204) and writer:end_headers())
+    local rc = writer:write_fd(fd)
+    ok(rc == #"HTTP/1.1 204 No Content\r\n\r\n" and writer:pending() == 0)
+    ok(client:receive(rc) == "HTTP/1.1 204 No Content\r\n\r\n")
+    client:close()
+    conn:close()
+end
+
+function date_test()
+    local hm = require"http_message"
+    ok(hm.date_parse("Sun, 06 Nov 1994 08:49:37 GMT") == 784111777)
+    ok(hm.date_parse("Sunday, 06-Nov-94 08:49:37 GMT") == 784111777)
+    ok(hm.date_parse("Sun Nov  6 08:49:37 1994") == 784111777)
+    ok(hm.date_parse("Sun, 06 Nov 1994 08:49:37") == nil)
+    ok(hm.date_format(784111777) == "Sun, 06 Nov 1994 08:49:37 GMT")
+    local now = hm.date_now()
+    ok(#now == 29 and hm.date_parse(now) >= os.time() - 1)
+end
+
+function url_test()
+    local hm = require"http_message"
+    local fields = hm.url_fields
+    local parser = hm.request()
+    parser:append("GET http://user@example.com:8080/a%20b?x=1+2#frag HTTP/1.1\r\n\r\n")
+    parser:execute()
+    ok(parser:get_url_field(fields.SCHEME) == "http")
+    ok(parser:get_url_field(fields.USERINFO) == "user")
+    ok(parser:get_url_field(fields.HOST) == "example.com")
+    ok(parser:get_url_field(fields.PORT) == "8080")
+    ok(parser:get_url_field(fields.PATH) == "/a%20b")
+    ok(parser:get_url_field(fields.QUERY) == "x=1+2")
+    ok(parser:get_url_field(fields.FRAGMENT) == "frag")
+    ok(hm.url_decode(parser:get_url_field(fields.PATH)) == "/a b")
+    ok(hm.url_decode(parser:get_url_field(fields.QUERY), true) == "x=1 2")
+    -- origin-form has no host.
+    parser = hm.request()
+    parser:append("GET /index.html HTTP/1.1\r\n\r\n")
+    parser:execute()
+    ok(parser:get_url_field(fields.HOST) == nil)
+    ok(parser:get_url_field(fields.PATH) == "/index.html")
+    -- all fields with one call, an empty port is allowed.
+    parser = hm.request()
+    parser:append("GET http://h:/p?q HTTP/1.1\r\n\r\n")
+    parser:execute()
+    local parts = {}
+    local url, port = parser:get_url_parts(parts)
+    ok(url == "http://h:/p?q" and port == 0)
+    is_deeply(parts, { 0, 4, 7, 1, -1, 0, 9, 2, 12, 1, -1, 0, -1, 0 })
+    local path = parts[fields.PATH * 2 + 1]
+    ok(url:sub(path + 1, path + parts[fields.PATH * 2 + 2]) == "/p")
+    -- same for messages.
+    parser = hm.request()
+    parser:append("GET https://[::1]:8443/ HTTP/1.1\r\n\r\n")
+    parser:execute()
+    local msg = parser:detach_message()
+    url, port = msg:get_url_parts(parts)
+    ok(url == "https://[::1]:8443/" and port == 8443)
+    ok(parts[fields.HOST * 2 + 1] == 9 and parts[fields.HOST * 2 + 2] == 3)
+    ok(parts[fields.QUERY * 2 + 1] == -1)
+end
+
+function form_test()
+    local hm = require"http_message"
+    local form = hm.form()
+    local parser = hm.request()
+    parser:append("GET /s?q=a+b&lang=en&x%3D=1%262&&flag HTTP/1.1\r\n\r\n")
+    parser:execute()
+    local tbl = {}
+    ok(form:feed_query(parser, tbl) == 4)
+    is_deeply(tbl, { "q", "a b", "lang", "en", "x=", "1&2", "flag", "" })
+    -- body split in the middle of tbl.
+    form:reset()
+    tbl = {}
+    ok(form:feed("name=bo", false, tbl) == 0)
+    ok(form:feed("b&age=4", false, tbl) == 1)
+    is_deeply(tbl, { "name", "bob" })
+    tbl = {}
+    ok(form:feed("2&city=New%20York", true, tbl) == 2)
+    is_deeply(tbl, { "age", "42", "city", "New York" })
+end
+
+function header_items_test()
+    local hm = require"http_message"
+    local ids = hm.header_ids
+    local flags = hm.header_item_flags
+    local parser = hm.request()
+    parser:append("GET / HTTP/1.1\r\n" ..
+        "Cookie: sid=abc123; theme=\"dark\"; flag\r\n" ..
+        "Accept-Encoding: gzip;q=0.5, br, x;q=1.5\r\n" ..
+        "Cache-Control: no-cache, max-age=0, private=\"a\\\"b\"\r\n" ..
+        "Accept: text/html\r\n" ..
+        "Accept: */*;level=1;q=0.1\r\n\r\n")
+    parser:execute()
+    ok(parser:find_header_item(ids["Cookie"], "sid") == "abc123")
+    local value, q, params, item_flags = parser:find_header_item(ids["Cookie"], "theme")
+    ok(value == "dark" and item_flags == flags.QUOTED)
+    ok(parser:find_header_item(ids["Cookie"], "flag") == "")
+    ok(parser:find_header_item(ids["Cookie"], "none") == nil)
+    -- Accept items: the value is empty, the parameters are returned separately.
+    value, q, params, item_flags = parser:find_header_item(ids["Accept-Encoding"], "GZIP")
+    ok(value == "" and q == 0.5 and params == "q=0.5" and item_flags == flags.PARAMS)
+    -- q-values above 1 are invalid.
+    value, q = parser:find_header_item(ids["Accept-Encoding"], "x")
+    ok(q == 1)
+    ok(parser:find_header_item(ids["Cache-Control"], "max-age") == "0")
+    -- quoted values are unescaped.
+    value, q, params, item_flags = parser:find_header_item(ids["Cache-Control"], "private")
+    ok(value == 'a"b' and item_flags == flags.QUOTED + flags.ESCAPED)
+    -- repeated headers are combined.
+    local tbl = { "stale", "stale", "stale", "stale", "stale",
+        "stale", "stale", "stale", "stale", "stale", "stale" }
+    ok(parser:get_header_items(ids["Accept"], tbl) == 2)
+    is_deeply(tbl, { "text/html", "", 1, "", 0, "*/*", "", 0.1, "level=1;q=0.1", flags.PARAMS })
+    ok(#tbl == 10)
+    -- same for detached messages.
+    local msg = parser:detach_message()
+    ok(msg:find_header_item(ids["Accept"], "*/*") == "")
+    ok(select(3, msg:find_header_item(ids["Accept"], "*/*")) == "level=1;q=0.1")
+    ok(msg:find_header_item(ids["Cookie"], "none") == nil)
+    tbl = {}
+    ok(msg:get_header_items(ids["Cookie"], tbl) == 3)
+    is_deeply(tbl, { "sid", "abc123", 1, "", 0, "theme", "dark", 1, "", flags.QUOTED,
+        "flag", "", 1, "", 0 })
+    ok(msg:find_header_idx(ids["Accept"]) == 3 and msg:next_header_idx(3) == 4)
+    ok(msg:next_header_idx(4) == -1)
+    -- the chain of repeated headers is kept in batched messages.
+    parser = hm.request(hm.options.BATCH)
+    parser:append("GET /1 HTTP/1.1\r\nAccept: a\r\n\r\n" ..
+        "GET /2 HTTP/1.1\r\nCookie: x=1\r\nX-Other: 1\r\nHost: h\r\nCookie: y=2\r\n\r\n")
+    parser:execute()
+    local msgs = {}
+    ok(parser:batch_messages(msgs) == 2)
+    ok(msgs[2]:find_header_idx(ids["Cookie"]) == 0 and msgs[2]:next_header_idx(0) == 3)
+    ok(msgs[2]:next_header_idx(3) == -1 and msgs[2]:next_header_idx(1) == -1)
+end
+
 function nil_body_test()
     local cbs = {}
     local body_count = 0
@@ -396,5 +1181,34 @@ nil_body_test()
 pipeline_test()
 please_continue_test()
 connection_close_test()
+slice_test()
+detach_message_test()
+message_detach_test()
+get_headers_test()
+header_ids_test()
+execute_external_test()
+find_header_test()
+fast_scan_test()
+wait_headers_test()
+stream_body_test()
+max_buffer_test()
+buffer_growth_test()
+pipeline_no_move_test()
+single_alloc_test()
+memory_used_test()
+read_fd_test()
+parser_set_test()
+upgrade_set_test()
+limits_test()
+stats_test()
+timing_test()
+batch_test()
+writer_test()
+writer_names_test()
+writer_fd_test()
+date_test()
+url_test()
+form_test()
+header_items_test()
 
 print("1.." .. counter)